@@ -51,9 +51,9 @@ static int arduino_read_sig_bytes(const PROGRAMMER *pgm, const AVRPART *p, const
   buf[0] = Cmnd_STK_READ_SIGN;
   buf[1] = Sync_CRC_EOP;
 
-  serial_send(&pgm->fd, buf, 2);
+  serial_send(pgm, &pgm->fd, buf, 2);
 
-  if (serial_recv(&pgm->fd, buf, 5) < 0)
+  if (serial_recv(pgm, &pgm->fd, buf, 5) < 0)
     return -1;
   if (buf[0] == Resp_STK_NOSYNC) {
     avrdude_message(MSG_INFO, "%s: stk500_cmd(): programmer is out of sync\n",
@@ -84,16 +84,16 @@ static int arduino_open(PROGRAMMER *pgm, const char *port) {
   strcpy(pgm->port, port);
   pinfo.serialinfo.baud = pgm->baudrate? pgm->baudrate: 115200;
   pinfo.serialinfo.cflags = SERIAL_8N1;
-  if (serial_open(port, pinfo, &pgm->fd)==-1) {
+  if (serial_open(pgm, port, pinfo, &pgm->fd)==-1) {
     return -1;
   }
 
   /* Clear DTR and RTS to unload the RESET capacitor 
    * (for example in Arduino) */
-  serial_set_dtr_rts(&pgm->fd, 0);
+  serial_set_dtr_rts(pgm, &pgm->fd, 0);
   usleep(250*1000);
   /* Set DTR and RTS back to high */
-  serial_set_dtr_rts(&pgm->fd, 1);
+  serial_set_dtr_rts(pgm, &pgm->fd, 1);
   usleep(50*1000);
 
   /*
@@ -109,8 +109,8 @@ static int arduino_open(PROGRAMMER *pgm, const char *port) {
 
 static void arduino_close(PROGRAMMER * pgm)
 {
-  serial_set_dtr_rts(&pgm->fd, 0);
-  serial_close(&pgm->fd);
+  serial_set_dtr_rts(pgm, &pgm->fd, 0);
+  serial_close(pgm, &pgm->fd);
   pgm->fd.ifd = -1;
 }
 
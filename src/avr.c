@@ -315,7 +315,8 @@ int avr_mem_hiaddr(const AVRMEM * mem)
  * Read the entirety of the specified memory type into the
  * corresponding buffer of the avrpart pointed to by 'p'.
  * If v is non-NULL, verify against v's memory area, only
- * those cells that are tagged TAG_ALLOCATED are verified.
+ * those cells that are tagged TAG_ALLOCATED are verified, and
+ * paged reads skip pages of v that are marked clean.
  *
  * Return the number of bytes read, or < 0 if an error occurs.  
  */
@@ -378,54 +379,39 @@ int avr_read(const PROGRAMMER *pgm, const AVRPART *p, const char *memtype,
     /*
      * the programmer supports a paged mode read
      */
-    int need_read, failure;
-    unsigned int pageaddr;
+    int failure, pageaddr, len, chunk;
     unsigned int npages, nread;
 
-    /* quickly scan number of pages to be written to first */
-    for (pageaddr = 0, npages = 0;
-         pageaddr < mem->size;
-         pageaddr += mem->page_size) {
-      /* check whether this page must be read */
-      for (i = pageaddr;
-           i < pageaddr + mem->page_size;
-           i++)
-        if (vmem == NULL /* no verify, read everything */ ||
-            (mem->tags[i] & TAG_ALLOCATED) != 0 /* verify, do only
-                                                    read pages that
-                                                    are needed in
-                                                    input file */) {
-          npages++;
-          break;
-        }
-    }
-
-    for (pageaddr = 0, failure = 0, nread = 0;
-         !failure && pageaddr < mem->size;
-         pageaddr += mem->page_size) {
-      /* check whether this page must be read */
-      for (i = pageaddr, need_read = 0;
-           i < pageaddr + mem->page_size;
-           i++)
-        if (vmem == NULL /* no verify, read everything */ ||
-            (vmem->tags[i] & TAG_ALLOCATED) != 0 /* verify, do only
-                                                    read pages that
-                                                    are needed in
-                                                    input file */) {
-          need_read = 1;
-          break;
-        }
-      if (need_read) {
-        rc = pgm->paged_load(pgm, p, mem, mem->page_size,
-                            pageaddr, mem->page_size);
-        if (rc < 0)
-          /* paged load failed, fall back to byte-at-a-time read below */
-          failure = 1;
-      } else {
-        avrdude_message(MSG_DEBUG, "%s: avr_read(): skipping page %u: no interesting data\n",
-                        progname, pageaddr / mem->page_size);
-      }
-      nread++;
+    /*
+     * without verify read everything, otherwise only the pages that hold
+     * data from the input file as listed by the extents of vmem; pages
+     * marked clean are known to match the chip and are not read back
+     */
+    npages = vmem == NULL? mem->size / mem->page_size:
+      avr_mem_count_dirty_pages(vmem, mem->size, mem->page_size);
+
+    /* largest whole number of pages the programmer reads in one go */
+    chunk = pgm->max_read_chunk > mem->page_size?
+      pgm->max_read_chunk - pgm->max_read_chunk % mem->page_size: mem->page_size;
+
+    for (pageaddr = vmem == NULL? 0: avr_mem_next_dirty_page(vmem, 0, mem->size, mem->page_size),
+           failure = 0, nread = 0, len = 0;
+         !failure && pageaddr >= 0 && pageaddr < mem->size;
+         pageaddr = vmem == NULL? pageaddr + len:
+           avr_mem_next_dirty_page(vmem, pageaddr + len, mem->size, mem->page_size)) {
+      /* coalesce a run of consecutive pages that need reading */
+      for (len = mem->page_size;
+           len < chunk && pageaddr + len < mem->size &&
+             (vmem == NULL ||
+              avr_mem_next_dirty_page(vmem, pageaddr + len, mem->size, mem->page_size) == pageaddr + len);
+           len += mem->page_size)
+        continue;
+      rc = pgm->paged_load(pgm, p, mem, mem->page_size,
+                          pageaddr, len);
+      if (rc < 0)
+        /* paged load failed, fall back to byte-at-a-time read below */
+        failure = 1;
+      nread += len / mem->page_size;
       report_progress(nread, npages, NULL);
     }
     if (!failure)
@@ -526,6 +512,196 @@ int avr_write_page(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *mem,
 }
 
 
+/*
+ * Generic paged ISP engine for programmers that only provide the
+ * low-level pgm->spi() transfer: a whole block of READ_LO/READ_HI (or
+ * READ) commands, or of LOADPAGE commands, is sent as one multi-byte
+ * SPI transfer instead of one 4-byte pgm->cmd() transaction per byte.
+ */
+#define AVR_SPI_CHUNK 256       // Max data bytes per pgm->spi() transfer
+
+// Issue load extended address command if needed for (word) address addr
+static int avr_spi_load_ext_addr(const PROGRAMMER *pgm, const AVRMEM *mem, unsigned long addr) {
+  unsigned char cmd[4], res[4];
+  OPCODE *lext = mem->op[AVR_OP_LOAD_EXT_ADDR];
+
+  if (lext == NULL)
+    return 0;
+
+  memset(cmd, 0, sizeof(cmd));
+  avr_set_bits(lext, cmd);
+  avr_set_addr(lext, cmd, addr);
+  return pgm->spi(pgm, cmd, res, 4);
+}
+
+/*
+ * Wait for a page write to complete: poll a byte of the page just written
+ * that reads back differently while programming is in progress (data
+ * polling); if there is none, delay the max write time of the memory
+ */
+int avr_spi_poll_ready(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *mem,
+                       unsigned long addr, unsigned int n) {
+  unsigned char cmd[4], res[4], data;
+  unsigned long a, start_time, now;
+  int found = 0, wordaddr = mem->op[AVR_OP_READ_LO] != NULL;
+  OPCODE *readop = NULL;
+  struct timeval tv;
+
+  for (a = addr + n; !found && a > addr; ) {
+    data = mem->buf[--a];
+    found = data != 0xff && data != mem->readback[0] && data != mem->readback[1];
+  }
+  if (found)
+    readop = !wordaddr? mem->op[AVR_OP_READ]: a & 1? mem->op[AVR_OP_READ_HI]: mem->op[AVR_OP_READ_LO];
+  if (readop == NULL) {
+    usleep(mem->max_write_delay);
+    return 0;
+  }
+
+  memset(cmd, 0, sizeof(cmd));
+  avr_set_bits(readop, cmd);
+  avr_set_addr(readop, cmd, wordaddr? a/2: a);
+
+  gettimeofday(&tv, NULL);
+  start_time = (tv.tv_sec * 1000000) + tv.tv_usec;
+  do {
+    if (pgm->spi(pgm, cmd, res, 4) < 0)
+      return -1;
+    data = 0;
+    avr_get_output(readop, res, &data);
+    if (data == mem->buf[a])
+      return 0;
+    gettimeofday(&tv, NULL);
+    now = (tv.tv_sec * 1000000) + tv.tv_usec;
+  } while (now - start_time < (unsigned long) mem->max_write_delay);
+
+  return 0;
+}
+
+int avr_spi_paged_load(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *mem,
+                       unsigned int page_size, unsigned int addr, unsigned int n_bytes)
+{
+  unsigned char *cmd, *res;
+  unsigned int i, n, chunk;
+  int wordaddr, rc = 0;
+  OPCODE *readop;
+
+  if (pgm->spi == NULL || (p->prog_modes & PM_TPI))
+    return -1;
+
+  wordaddr = mem->op[AVR_OP_READ_LO] != NULL;
+  if (wordaddr? !mem->op[AVR_OP_READ_HI]: !mem->op[AVR_OP_READ])
+    return -1;
+
+  if (n_bytes == 0)
+    return 0;
+
+  chunk = n_bytes < AVR_SPI_CHUNK? n_bytes: AVR_SPI_CHUNK;
+  cmd = cfg_malloc("avr_spi_paged_load()", 4*chunk);
+  res = cfg_malloc("avr_spi_paged_load()", 4*chunk);
+
+  pgm->pgm_led(pgm, ON);
+  pgm->err_led(pgm, OFF);
+
+  for (i = 0; rc >= 0 && i < n_bytes; i += n) {
+    unsigned long a = addr + i;
+
+    n = n_bytes - i < chunk? n_bytes - i: chunk;
+    // Load extended address once per chunk; a chunk never straddles a 64 k word boundary
+    if (wordaddr && (a + n-1)/2 >> 16 != a/2 >> 16)
+      n = 2*(((a/2 >> 16) + 1) << 16) - a;
+    if ((rc = avr_spi_load_ext_addr(pgm, mem, wordaddr? a/2: a)) < 0)
+      break;
+
+    memset(cmd, 0, 4*n);
+    for (unsigned int k = 0; k < n; k++) {
+      readop = !wordaddr? mem->op[AVR_OP_READ]: (a+k) & 1? mem->op[AVR_OP_READ_HI]: mem->op[AVR_OP_READ_LO];
+      avr_set_bits(readop, cmd + 4*k);
+      avr_set_addr(readop, cmd + 4*k, wordaddr? (a+k)/2: a+k);
+    }
+    if ((rc = pgm->spi(pgm, cmd, res, 4*n)) < 0)
+      break;
+    for (unsigned int k = 0; k < n; k++) {
+      readop = !wordaddr? mem->op[AVR_OP_READ]: (a+k) & 1? mem->op[AVR_OP_READ_HI]: mem->op[AVR_OP_READ_LO];
+      mem->buf[a+k] = 0;
+      avr_get_output(readop, res + 4*k, mem->buf + a+k);
+    }
+  }
+
+  pgm->pgm_led(pgm, OFF);
+  free(cmd);
+  free(res);
+
+  return rc < 0? -1: (int) n_bytes;
+}
+
+int avr_spi_paged_write(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *mem,
+                        unsigned int page_size, unsigned int addr, unsigned int n_bytes)
+{
+  unsigned char *cmd, *res;
+  unsigned int i, n;
+  int wordaddr, rc = 0;
+  OPCODE *loadop, *wp = mem->op[AVR_OP_WRITEPAGE];
+
+  if (pgm->spi == NULL || (p->prog_modes & PM_TPI) || wp == NULL || !mem->op[AVR_OP_LOADPAGE_LO])
+    return -1;
+
+  wordaddr = mem->op[AVR_OP_READ_LO] != NULL;
+  if (wordaddr && (!mem->paged || !mem->op[AVR_OP_LOADPAGE_HI]))
+    return -1;
+
+  if (page_size == 0 || page_size > (unsigned) mem->page_size)
+    page_size = mem->page_size;
+  if (n_bytes == 0)
+    return 0;
+
+  cmd = cfg_malloc("avr_spi_paged_write()", 4*page_size + 4);
+  res = cfg_malloc("avr_spi_paged_write()", 4*page_size + 4);
+
+  pgm->pgm_led(pgm, ON);
+  pgm->err_led(pgm, OFF);
+
+  // One transfer of LOADPAGE commands per page followed by WRITEPAGE
+  for (i = 0; i < n_bytes; i += n) {
+    unsigned long a = addr + i, pageaddr = a - a % page_size;
+
+    n = pageaddr + page_size - a;
+    if (n > n_bytes - i)
+      n = n_bytes - i;
+
+    memset(cmd, 0, 4*n);
+    for (unsigned int k = 0; k < n; k++) {
+      loadop = !wordaddr? mem->op[AVR_OP_LOADPAGE_LO]:
+        (a+k) & 1? mem->op[AVR_OP_LOADPAGE_HI]: mem->op[AVR_OP_LOADPAGE_LO];
+      avr_set_bits(loadop, cmd + 4*k);
+      avr_set_addr(loadop, cmd + 4*k, wordaddr? (a+k)/2: a+k);
+      avr_set_input(loadop, cmd + 4*k, mem->buf[a+k]);
+    }
+    if ((rc = pgm->spi(pgm, cmd, res, 4*n)) < 0)
+      break;
+
+    if ((rc = avr_spi_load_ext_addr(pgm, mem, wordaddr? pageaddr/2: pageaddr)) < 0)
+      break;
+    memset(cmd, 0, 4);
+    avr_set_bits(wp, cmd);
+    avr_set_addr(wp, cmd, wordaddr? pageaddr/2: pageaddr);
+    if ((rc = pgm->spi(pgm, cmd, res, 4)) < 0)
+      break;
+
+    if ((rc = avr_spi_poll_ready(pgm, p, mem, a, n)) < 0)
+      break;
+  }
+
+  pgm->pgm_led(pgm, OFF);
+  if (rc < 0)
+    pgm->err_led(pgm, ON);
+  free(cmd);
+  free(res);
+
+  return rc < 0? -1: (int) n_bytes;
+}
+
+
 int avr_write_byte_default(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *mem,
                    unsigned long addr, unsigned char data)
 {
@@ -885,48 +1061,26 @@ int avr_write(const PROGRAMMER *pgm, const AVRPART *p, const char *memtype,
     /*
      * the programmer supports a paged mode write
      */
-    int need_write, failure;
-    unsigned int pageaddr;
+    int failure, pageaddr;
     unsigned int npages, nwritten;
 
-    /* quickly scan number of pages to be written to first */
-    for (pageaddr = 0, npages = 0;
-         pageaddr < wsize;
-         pageaddr += m->page_size) {
-      /* check whether this page must be written to */
-      for (i = pageaddr;
-           i < pageaddr + m->page_size;
-           i++)
-        if ((m->tags[i] & TAG_ALLOCATED) != 0) {
-          npages++;
-          break;
-        }
-    }
-
-    for (pageaddr = 0, failure = 0, nwritten = 0;
-         !failure && pageaddr < wsize;
-         pageaddr += m->page_size) {
-      /* check whether this page must be written to */
-      for (i = pageaddr, need_write = 0;
-           i < pageaddr + m->page_size;
-           i++)
-        if ((m->tags[i] & TAG_ALLOCATED) != 0) {
-          need_write = 1;
-          break;
-        }
-      if (need_write) {
-        rc = 0;
-        if (auto_erase)
-          rc = pgm->page_erase(pgm, p, m, pageaddr);
-        if (rc >= 0)
-          rc = pgm->paged_write(pgm, p, m, m->page_size, pageaddr, m->page_size);
-        if (rc < 0)
-          /* paged write failed, fall back to byte-at-a-time write below */
-          failure = 1;
-      } else {
-        avrdude_message(MSG_DEBUG, "%s: avr_write(): skipping page %u: no interesting data\n",
-                        progname, pageaddr / m->page_size);
-      }
+    /*
+     * only dirty pages holding allocated data are written: walk the
+     * extents and skip pages known to match the chip
+     */
+    npages = avr_mem_count_dirty_pages(m, wsize, m->page_size);
+
+    for (pageaddr = avr_mem_next_dirty_page(m, 0, wsize, m->page_size), failure = 0, nwritten = 0;
+         !failure && pageaddr >= 0;
+         pageaddr = avr_mem_next_dirty_page(m, pageaddr + m->page_size, wsize, m->page_size)) {
+      rc = 0;
+      if (auto_erase)
+        rc = pgm->page_erase(pgm, p, m, pageaddr);
+      if (rc >= 0)
+        rc = pgm->paged_write(pgm, p, m, m->page_size, pageaddr, m->page_size);
+      if (rc < 0)
+        /* paged write failed, fall back to byte-at-a-time write below */
+        failure = 1;
       nwritten++;
       report_progress(nwritten, npages, NULL);
     }
@@ -1021,6 +1175,291 @@ int avr_write(const PROGRAMMER *pgm, const AVRPART *p, const char *memtype,
 }
 
 
+/*
+ * Differential writes need paged reads and writes to compare and write
+ * individual pages
+ */
+static int avr_diff_possible(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *m) {
+  return !(p->prog_modes & PM_TPI) && pgm->paged_load && pgm->paged_write &&
+    m->page_size > 1 && m->size % m->page_size == 0;
+}
+
+static int avr_diff_page_erase(const PROGRAMMER *pgm, const AVRPART *p, int auto_erase) {
+  return auto_erase && pgm->page_erase && (p->prog_modes & (PM_PDI | PM_UPDI));
+}
+
+/*
+ * On-chip page content read back by avr_write_diff_needs_erase(), kept
+ * so that the following avr_write_diff() of the same memory need not
+ * read these pages a second time
+ */
+typedef struct {
+  const AVRMEM *mem;
+  unsigned char *chip;          // Copy of the on-chip content of mem
+  unsigned char *known;         // known[pg] is set if page pg of chip is valid
+} Diffcache;
+
+static Diffcache *diffcache;
+static int ndiffcache;
+
+static Diffcache *diffcache_find(const AVRMEM *m) {
+  for(int i = 0; i < ndiffcache; i++)
+    if(diffcache[i].mem == m)
+      return diffcache + i;
+  return NULL;
+}
+
+static void diffcache_drop(int i) {
+  free(diffcache[i].chip);
+  free(diffcache[i].known);
+  diffcache[i] = diffcache[--ndiffcache];
+}
+
+// Forget the cached content of m and of flash memories sharing addresses with it
+static void diffcache_forget(const AVRMEM *m) {
+  for(int i = ndiffcache-1; i >= 0; i--) {
+    const AVRMEM *c = diffcache[i].mem;
+
+    if(c == m || (avr_mem_is_flash_type(c) && avr_mem_is_flash_type(m) &&
+       c->offset < m->offset + m->size && m->offset < c->offset + c->size))
+      diffcache_drop(i);
+  }
+}
+
+static Diffcache *diffcache_new(const AVRMEM *m) {
+  Diffcache *dc;
+
+  diffcache_forget(m);
+  diffcache = cfg_realloc("diffcache_new()", diffcache, (ndiffcache+1)*sizeof*diffcache);
+  dc = diffcache + ndiffcache++;
+  dc->mem = m;
+  dc->chip = cfg_malloc("diffcache_new()", m->size);
+  dc->known = cfg_malloc("diffcache_new()", m->size/m->page_size);
+
+  return dc;
+}
+
+/*
+ * Read back every page that holds data from the input file and compare
+ * it with the buffer: diff[pg] is set for pages that differ and
+ * erase[pg] for those that cannot be programmed without erasing them
+ * (ie, need a bit to go from 0 to 1). Buffer bytes of a page that are
+ * not tagged TAG_ALLOCATED take on the on-chip content so that
+ * rewriting the page leaves them unchanged. Pages known to dc are
+ * taken from there instead of the device, pages read are added to dc
+ * (dc may be NULL). Progress is reported as one unit per page out of
+ * ptotal units.
+ *
+ * Returns the number of pages that were compared.
+ */
+static unsigned int avr_diff_pages(const PROGRAMMER *pgm, const AVRPART *p, AVRMEM *m, int wsize,
+  unsigned char *diff, unsigned char *erase, unsigned int *ndiff, unsigned int *nerase,
+  unsigned int ptotal, Diffcache *dc) {
+
+  unsigned int i, pageaddr, pgsize = m->page_size, ndone = 0;
+  unsigned char *img = cfg_malloc("avr_diff_pages()", pgsize);
+  int rc, next;
+
+  *ndiff = *nerase = 0;
+  for (next = avr_mem_next_dirty_page(m, 0, wsize, pgsize); next >= 0;
+       next = avr_mem_next_dirty_page(m, next + pgsize, wsize, pgsize)) {
+    unsigned int pg = next/pgsize;
+
+    pageaddr = next;
+    diff[pg] = 1;
+    memcpy(img, m->buf + pageaddr, pgsize);
+    if (dc && dc->known[pg]) {
+      memcpy(m->buf + pageaddr, dc->chip + pageaddr, pgsize);
+      rc = 0;
+    } else if ((rc = pgm->paged_load(pgm, p, m, pgsize, pageaddr, pgsize)) >= 0 && dc) {
+      memcpy(dc->chip + pageaddr, m->buf + pageaddr, pgsize);
+      dc->known[pg] = 1;
+    }
+    if (rc < 0) {               // Cannot tell: treat as different page that needs erasing
+      avrdude_message(MSG_DEBUG, "%s: avr_diff_pages(): reading page %u failed\n",
+                      progname, pg);
+      memcpy(m->buf + pageaddr, img, pgsize);
+      erase[pg] = 1;
+    } else {
+      diff[pg] = 0;
+      for (i = 0; i < pgsize; i++) {
+        unsigned char chip = m->buf[pageaddr+i];
+
+        if (m->tags[pageaddr+i] & TAG_ALLOCATED) {
+          if (chip != img[i])
+            diff[pg] = 1;
+          if ((chip & img[i]) != img[i])
+            erase[pg] = 1;
+        } else
+          img[i] = chip;
+      }
+      memcpy(m->buf + pageaddr, img, pgsize);
+    }
+    if (diff[pg]) {
+      (*ndiff)++;
+      *nerase += erase[pg];
+    } else {
+      avrdude_message(MSG_DEBUG, "%s: avr_diff_pages(): page %u unchanged\n",
+                      progname, pg);
+    }
+    report_progress(++ndone, ptotal, NULL);
+  }
+
+  /*
+   * EEPROM and bootloader page writes erase the page themselves; other
+   * memories need a page erase or a chip erase
+   */
+  if (avr_mem_is_eeprom_type(m) || pgm->prog_modes == PM_SPM)
+    *nerase = 0;
+
+  free(img);
+  return ndone;
+}
+
+/*
+ * Check whether a differential write of the buffer of the given memory
+ * needs a chip erase beforehand. This is the case when a page has to go
+ * from 0 to 1 bits and the programmer cannot erase individual pages, or
+ * when the memory cannot be written differentially at all. As the chip
+ * erase also clears other memories the decision has to be taken once
+ * before any -U operation is carried out. The pages read back are kept
+ * for the subsequent avr_write_diff() of this memory.
+ *
+ * Returns 1 if a chip erase is needed, 0 if not, or < 0 on error.
+ */
+int avr_write_diff_needs_erase(const PROGRAMMER *pgm, const AVRPART *p, const char *memtype,
+                               int size)
+{
+  unsigned int ndiff, nerase, npages;
+  unsigned char *diff, *erase;
+  AVRMEM *m;
+  int wsize;
+
+  m = avr_locate_mem(p, memtype);
+  if (m == NULL) {
+    avrdude_message(MSG_INFO, "No \"%s\" memory for part %s\n",
+            memtype, p->desc);
+    return -1;
+  }
+
+  if (!avr_mem_is_flash_type(m) || avr_diff_page_erase(pgm, p, 1))
+    return 0;
+  if (!avr_diff_possible(pgm, p, m))
+    return 1;
+
+  wsize = size < m->size? size: m->size;
+  npages = avr_mem_count_dirty_pages(m, wsize, m->page_size);
+  diff = cfg_malloc("avr_write_diff_needs_erase()", m->size/m->page_size);
+  erase = cfg_malloc("avr_write_diff_needs_erase()", m->size/m->page_size);
+
+  avr_diff_pages(pgm, p, m, wsize, diff, erase, &ndiff, &nerase, npages, diffcache_new(m));
+  if (nerase)
+    avrdude_message(MSG_NOTICE, "%s: %u page%s of %s need erasing\n",
+                    progname, nerase, update_plural(nerase), m->desc);
+
+  free(diff);
+  free(erase);
+
+  return nerase > 0;
+}
+
+/*
+ * Differential write: like avr_write(), but first read back every page
+ * that holds data from the input file and only (erase and) write those
+ * pages whose on-chip content differs from the buffer.
+ *
+ * If auto_erase is set, a differing page that cannot be programmed
+ * without erasing it is erased with pgm->page_erase() where the part
+ * supports page erase. A chip erase is never carried out here as it
+ * would also clear memories written by earlier -U operations; callers
+ * use avr_write_diff_needs_erase() to decide on one up front. If pages
+ * need erasing but cannot be erased here, nothing is written and an
+ * error is returned.
+ *
+ * Pages found unchanged are marked clean, so that a subsequent
+ * avr_read() for verification and avr_verify() skip them. The number
+ * of pages skipped because they were unchanged is returned in *nskipped
+ * if nskipped is not NULL.
+ *
+ * Return the number of bytes written, or < 0 if an error occurs.
+ */
+int avr_write_diff(const PROGRAMMER *pgm, const AVRPART *p, const char *memtype,
+                   int size, int auto_erase, int *nskipped)
+{
+  int rc, wsize, failure, page_erase, next;
+  unsigned int pageaddr, pgsize, npages, ndiff, nerase, ndone;
+  unsigned char *diff, *erase;
+  AVRMEM *m;
+
+  if(nskipped)
+    *nskipped = 0;
+
+  m = avr_locate_mem(p, memtype);
+  if (m == NULL) {
+    avrdude_message(MSG_INFO, "No \"%s\" memory for part %s\n",
+            memtype, p->desc);
+    return -1;
+  }
+
+  wsize = size < m->size? size: m->size;
+  pgsize = m->page_size;
+  page_erase = avr_diff_page_erase(pgm, p, auto_erase);
+
+  // No paged read and write: cannot compare pages, so write everything
+  if (!avr_diff_possible(pgm, p, m))
+    return avr_write(pgm, p, memtype, size, page_erase);
+
+  diff = cfg_malloc("avr_write_diff()", m->size/pgsize);
+  erase = cfg_malloc("avr_write_diff()", m->size/pgsize);
+
+  // Pass 1: compare every dirty page with data with the chip (or what was read before)
+  npages = avr_mem_count_dirty_pages(m, wsize, pgsize);
+  avr_diff_pages(pgm, p, m, wsize, diff, erase, &ndiff, &nerase, 2*npages, diffcache_find(m));
+  diffcache_forget(m);
+
+  // Pages that already match the chip need neither writing nor verifying
+  for (next = avr_mem_next_dirty_page(m, 0, wsize, pgsize); next >= 0;
+       next = avr_mem_next_dirty_page(m, next + pgsize, wsize, pgsize))
+    if (!diff[next/pgsize])
+      avr_mem_set_page_clean(m, next);
+
+  if (nerase && !page_erase) {
+    avrdude_message(MSG_INFO, "%s: avr_write_diff(): %u page%s of %s need erasing but %s;\n"
+                    "%sspecify -e for a chip erase before the write\n",
+                    progname, nerase, update_plural(nerase), m->desc,
+                    auto_erase? "the programmer cannot erase pages": "auto erase is disabled", progbuf);
+    free(diff);
+    free(erase);
+    return -1;
+  }
+
+  // Pass 2: (erase and) write the pages that differ
+  for (pageaddr = 0, failure = 0, ndone = 0; !failure && pageaddr < (unsigned) wsize; pageaddr += pgsize) {
+    unsigned int pg = pageaddr/pgsize;
+
+    if (!diff[pg])
+      continue;
+    rc = 0;
+    if (page_erase && nerase && erase[pg] && (rc = pgm->page_erase(pgm, p, m, pageaddr)) < 0)
+      avrdude_message(MSG_INFO, "%s: avr_write_diff(): failed to erase page %u of %s\n",
+                      progname, pg, m->desc);
+    if (rc >= 0 && (rc = pgm->paged_write(pgm, p, m, pgsize, pageaddr, pgsize)) < 0)
+      avrdude_message(MSG_INFO, "%s: avr_write_diff(): failed to write page %u of %s\n",
+                      progname, pg, m->desc);
+    if (rc < 0)
+      failure = 1;
+    ndone++;
+    report_progress(npages + (ndiff? ndone*npages/ndiff: npages), 2*npages, NULL);
+  }
+  if (nskipped)
+    *nskipped = npages - ndiff;
+
+  free(diff);
+  free(erase);
+
+  return failure? -1: wsize;
+}
+
 
 /*
  * read the AVR device's signature bytes
@@ -1073,13 +1512,14 @@ int compare_memory_masked(AVRMEM * m, uint8_t b1, uint8_t b2) {
 /*
  * Verify the memory buffer of p with that of v.  The byte range of v,
  * may be a subset of p.  The byte range of p should cover the whole
- * chip's memory size.
+ * chip's memory size.  Pages of v marked clean are known to match the
+ * chip and are skipped, as avr_read() does not read them back.
  *
  * Return the number of bytes verified, or -1 if they don't match.
  */
 int avr_verify(const AVRPART * p, const AVRPART * v, const char * memtype, int size)
 {
-  int i;
+  int i, e;
   unsigned char * buf1, * buf2;
   int vsize;
   AVRMEM * a, * b;
@@ -1112,31 +1552,39 @@ int avr_verify(const AVRPART * p, const AVRPART * v, const char * memtype, int s
     size = vsize;
   }
 
-  for (i=0; i<size; i++) {
-    if ((b->tags[i] & TAG_ALLOCATED) != 0 &&
-        buf1[i] != buf2[i]) {
-      uint8_t bitmask = get_fuse_bitmask(a);
-      if((buf1[i] & bitmask) != (buf2[i] & bitmask)) {
-        // Mismatch is not just in unused bits
-        avrdude_message(MSG_INFO, "%s: verification error, first mismatch at byte 0x%04x\n"
-                        "%s0x%02x != 0x%02x\n",
-                        progname, i,
-                        progbuf, buf1[i], buf2[i]);
-        return -1;
-      } else {
-        // Mismatch is only in unused bits
-        if ((buf1[i] | bitmask) != 0xff) {
-          // Programmer returned unused bits as 0, must be the part/programmer
-          avrdude_message(MSG_INFO, "%s: WARNING: ignoring mismatch in unused bits of \"%s\"\n"
-                          "%s(0x%02x != 0x%02x). To prevent this warning fix the part\n"
-                          "%sor programmer definition in the config file.\n",
-                          progname, memtype, progbuf, buf1[i], buf2[i], progbuf);
+  for (e=0; e < b->nextents && b->extents[e].addr < size; e++) {
+    int end = b->extents[e].addr + b->extents[e].len;
+
+    for (i=b->extents[e].addr; i < end && i < size; i++) {
+      if (!avr_mem_page_dirty(b, i)) { // Page known to match the chip, not read back
+        if (b->page_size > 1)
+          i += b->page_size - 1 - i%b->page_size;
+        continue;
+      }
+      if (buf1[i] != buf2[i]) {
+        uint8_t bitmask = get_fuse_bitmask(a);
+        if((buf1[i] & bitmask) != (buf2[i] & bitmask)) {
+          // Mismatch is not just in unused bits
+          avrdude_message(MSG_INFO, "%s: verification error, first mismatch at byte 0x%04x\n"
+                          "%s0x%02x != 0x%02x\n",
+                          progname, i,
+                          progbuf, buf1[i], buf2[i]);
+          return -1;
         } else {
-          // Programmer returned unused bits as 1, must be the user
-          avrdude_message(MSG_INFO, "%s: WARNING: ignoring mismatch in unused bits of \"%s\"\n"
-                          "%s(0x%02x != 0x%02x). To prevent this warning set unused bits\n"
-                          "%sto 1 when writing (double check with your datasheet first).\n",
-                          progname, memtype, progbuf, buf1[i], buf2[i], progbuf);
+          // Mismatch is only in unused bits
+          if ((buf1[i] | bitmask) != 0xff) {
+            // Programmer returned unused bits as 0, must be the part/programmer
+            avrdude_message(MSG_INFO, "%s: WARNING: ignoring mismatch in unused bits of \"%s\"\n"
+                            "%s(0x%02x != 0x%02x). To prevent this warning fix the part\n"
+                            "%sor programmer definition in the config file.\n",
+                            progname, memtype, progbuf, buf1[i], buf2[i], progbuf);
+          } else {
+            // Programmer returned unused bits as 1, must be the user
+            avrdude_message(MSG_INFO, "%s: WARNING: ignoring mismatch in unused bits of \"%s\"\n"
+                            "%s(0x%02x != 0x%02x). To prevent this warning set unused bits\n"
+                            "%sto 1 when writing (double check with your datasheet first).\n",
+                            progname, memtype, progbuf, buf1[i], buf2[i], progbuf);
+          }
         }
       }
     }
@@ -1146,6 +1594,86 @@ int avr_verify(const AVRPART * p, const AVRPART * v, const char * memtype, int s
 }
 
 
+/*
+ * CRC-32 (IEEE 802.3, reflected, as used by zlib) of len bytes of buf; crc
+ * is the value returned by a previous call for continuation, or 0
+ */
+unsigned long avr_crc32(unsigned long crc, const unsigned char *buf, unsigned int len) {
+  crc = ~crc & 0xffffffffUL;
+  while (len--) {
+    crc ^= *buf++;
+    for (int k = 0; k < 8; k++)
+      crc = crc & 1? (crc >> 1) ^ 0xedb88320UL: crc >> 1;
+  }
+
+  return ~crc & 0xffffffffUL;
+}
+
+#define AVR_CRC_MAX_RUNS 16     // Beyond that many sections reading back is likely cheaper
+
+/*
+ * Compare the CRC the programmer computes over len bytes of m from addr
+ * with the one over the buffer; return 1 if they match, 0 if not and -1
+ * if the programmer cannot compute the CRC for this range
+ */
+static int avr_crc_matches(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *m,
+                           int addr, int len) {
+  unsigned long crc, mask;
+  int bits;
+
+  if ((bits = pgm->mem_crc(pgm, p, m, addr, len, &crc)) <= 0)
+    return -1;
+
+  mask = bits >= 32? 0xffffffffUL: (1UL << bits) - 1;
+  if ((crc & mask) != (avr_crc32(0, m->buf + addr, len) & mask)) {
+    avrdude_message(MSG_NOTICE, "%s: CRC mismatch in %s at 0x%04x..0x%04x, reading back\n",
+                    progname, m->desc, addr, addr+len-1);
+    return 0;
+  }
+
+  return 1;
+}
+
+/*
+ * Verify the memory buffer of p against the device using on-target CRCs
+ * over each contiguous run of allocated bytes in the first size bytes.
+ * Programmers that can only checksum a whole memory get the entire
+ * buffer; its unallocated bytes are 0xff and match the device if the
+ * memory was erased before it was written.
+ *
+ * Return 1 if all CRCs match, 0 if the programmer cannot compute them or
+ * any CRC differs (the caller then needs to read back), and -1 on error.
+ */
+int avr_verify_crc(const PROGRAMMER *pgm, const AVRPART *p, const char *memtype, int size) {
+  AVRMEM *m;
+  int e, i, n, nruns, rc;
+
+  if (pgm->mem_crc == NULL || (m = avr_locate_mem(p, memtype)) == NULL || m->page_size <= 1)
+    return 0;
+
+  if (size > m->size)
+    size = m->size;
+
+  // The runs of allocated bytes are the extents of m clipped to size
+  for (nruns = 0; nruns < m->nextents && m->extents[nruns].addr < size; nruns++)
+    continue;
+
+  if (nruns <= AVR_CRC_MAX_RUNS) {
+    for (e = 0; e < nruns; e++) {
+      i = m->extents[e].addr;
+      n = m->extents[e].len < size-i? m->extents[e].len: size-i;
+      if ((rc = avr_crc_matches(pgm, p, m, i, n)) < 0)
+        break;
+      if (rc == 0)
+        return 0;
+    }
+    if (e == nruns)
+      return 1;
+  }
+
+  return avr_crc_matches(pgm, p, m, 0, m->size) > 0;
+}
+
 int avr_get_cycle_count(const PROGRAMMER *pgm, const AVRPART *p, int *cycles) {
   AVRMEM * a;
   unsigned int cycle_count = 0;
@@ -1275,6 +1803,14 @@ int avr_chip_erase(const PROGRAMMER *pgm, const AVRPART *p) {
 
   rc = pgm->chip_erase(pgm, p);
 
+  // Cached flash content now reads back erased; bootloaders may not really erase
+  for(int i = ndiffcache-1; i >= 0; i--)
+    if(rc == 0 && pgm->prog_modes != PM_SPM) {
+      memset(diffcache[i].chip, 0xff, diffcache[i].mem->size);
+      memset(diffcache[i].known, 1, diffcache[i].mem->size/diffcache[i].mem->page_size);
+    } else
+      diffcache_drop(i);
+
   return rc;
 }
 
@@ -50,6 +50,9 @@ struct pdata
   unsigned int buffersize;
   unsigned char test_blockmode;
   unsigned char use_blockmode;
+  unsigned char eeprom_blockmode;	/* use block mode for EEPROM too */
+  int addr_valid;			/* programmer address is known to be addr_next */
+  unsigned long addr_next;
 };
 
 #define PDATA(pgm) ((struct pdata *)(pgm->cookie))
@@ -72,14 +75,18 @@ static void avr910_teardown(PROGRAMMER * pgm)
 
 
 static int avr910_send(const PROGRAMMER *pgm, char *buf, size_t len) {
-  return serial_send(&pgm->fd, (unsigned char *)buf, len);
+  /* all but the address and block commands may move the address */
+  if (len < 1 || !strchr("ABg", buf[0]))
+    PDATA(pgm)->addr_valid = 0;
+
+  return serial_send(pgm, &pgm->fd, (unsigned char *)buf, len);
 }
 
 
 static int avr910_recv(const PROGRAMMER *pgm, char *buf, size_t len) {
   int rv;
 
-  rv = serial_recv(&pgm->fd, (unsigned char *)buf, len);
+  rv = serial_recv(pgm, &pgm->fd, (unsigned char *)buf, len);
   if (rv < 0) {
     avrdude_message(MSG_INFO, "%s: avr910_recv(): programmer is not responding\n",
                     progname);
@@ -90,7 +97,7 @@ static int avr910_recv(const PROGRAMMER *pgm, char *buf, size_t len) {
 
 
 static int avr910_drain(const PROGRAMMER *pgm, int display) {
-  return serial_drain(&pgm->fd, display);
+  return serial_drain(pgm, &pgm->fd, display);
 }
 
 
@@ -107,10 +114,30 @@ static int avr910_vfy_cmd_sent(const PROGRAMMER *pgm, char *errmsg) {
 }
 
 
+/*
+ * Wait until usec microseconds have passed since *start, the time a
+ * command was sent. The time the programmer took to acknowledge counts
+ * towards the delay, so programmers that only answer once the operation
+ * has finished are not slowed down by a second, fixed wait.
+ */
+static void avr910_wait_since(const struct timeval *start, long usec) {
+  struct timeval tv;
+  long elapsed;
+
+  gettimeofday(&tv, NULL);
+  elapsed = (tv.tv_sec - start->tv_sec) * 1000000L + (tv.tv_usec - start->tv_usec);
+  if (elapsed < usec)
+    usleep(usec - elapsed);
+}
+
+
 /*
  * issue the 'chip erase' command to the AVR device
  */
 static int avr910_chip_erase(const PROGRAMMER *pgm, const AVRPART *p) {
+  struct timeval start;
+
+  gettimeofday(&start, NULL);
   avr910_send(pgm, "e", 1);
   if (avr910_vfy_cmd_sent(pgm, "chip erase") < 0)
     return -1;
@@ -118,7 +145,7 @@ static int avr910_chip_erase(const PROGRAMMER *pgm, const AVRPART *p) {
   /*
    * avr910 firmware may not delay long enough
    */
-  usleep (p->chip_erase_delay);
+  avr910_wait_since(&start, p->chip_erase_delay);
 
   return 0;
 }
@@ -216,6 +243,7 @@ static int avr910_initialize(const PROGRAMMER *pgm, const AVRPART *p) {
 
     avr910_send(pgm, "t", 1);
     avrdude_message(MSG_NOTICE, "\nProgrammer supports the following devices:\n");
+    complete_config();
     devtype_1st = 0;
     while (1) {
       avr910_recv(pgm, &c, 1);
@@ -337,6 +365,13 @@ static int avr910_parseextparms(const PROGRAMMER *pgm, const LISTID extparms) {
 
       continue;
     }
+    if (strncmp(extended_param, "eeprom_blockmode", strlen("eeprom_blockmode")) == 0) {
+      avrdude_message(MSG_NOTICE2, "%s: avr910_parseextparms(-x): using Blockmode for EEPROM\n",
+                      progname);
+      PDATA(pgm)->eeprom_blockmode = 1;
+
+      continue;
+    }
 
     avrdude_message(MSG_INFO, "%s: avr910_parseextparms(): invalid extended parameter '%s'\n",
                     progname, extended_param);
@@ -359,7 +394,7 @@ static int avr910_open(PROGRAMMER *pgm, const char *port) {
   strcpy(pgm->port, port);
   pinfo.serialinfo.baud = pgm->baudrate;
   pinfo.serialinfo.cflags = SERIAL_8N1;
-  if (serial_open(port, pinfo, &pgm->fd)==-1) {
+  if (serial_open(pgm, port, pinfo, &pgm->fd)==-1) {
     return -1;
   }
 
@@ -375,7 +410,7 @@ static void avr910_close(PROGRAMMER * pgm)
 {
   avr910_leave_prog_mode(pgm);
 
-  serial_close(&pgm->fd);
+  serial_close(pgm, &pgm->fd);
   pgm->fd.ifd = -1;
 }
 
@@ -388,12 +423,17 @@ static void avr910_display(const PROGRAMMER *pgm, const char *p) {
 static void avr910_set_addr(const PROGRAMMER *pgm, unsigned long addr) {
   char cmd[3];
 
+  /* block commands auto-increment the address: nothing to do if sequential */
+  if (PDATA(pgm)->addr_valid && PDATA(pgm)->addr_next == addr)
+    return;
+
   cmd[0] = 'A';
   cmd[1] = (addr >> 8) & 0xff;
   cmd[2] = addr & 0xff;
   
   avr910_send(pgm, cmd, sizeof(cmd));
-  avr910_vfy_cmd_sent(pgm, "set addr");
+  PDATA(pgm)->addr_valid = avr910_vfy_cmd_sent(pgm, "set addr") == 0;
+  PDATA(pgm)->addr_next = addr;
 }
 
 
@@ -489,6 +529,7 @@ static int avr910_paged_write_flash(const PROGRAMMER *pgm, const AVRPART *p, con
   unsigned int page_addr;
   int page_bytes = page_size;
   int page_wr_cmd_pending = 0;
+  struct timeval start;
 
   page_addr = addr;
   avr910_set_addr(pgm, addr>>1);
@@ -507,11 +548,12 @@ static int avr910_paged_write_flash(const PROGRAMMER *pgm, const AVRPART *p, con
       /* Send the "Issue Page Write" if we have sent a whole page. */
 
       avr910_set_addr(pgm, page_addr>>1);
+      gettimeofday(&start, NULL);
       avr910_send(pgm, "m", 1);
       avr910_vfy_cmd_sent(pgm, "flush page");
 
       page_wr_cmd_pending = 0;
-      usleep(m->max_write_delay);
+      avr910_wait_since(&start, m->max_write_delay);
       avr910_set_addr(pgm, addr>>1);
 
       /* Set page address for next page. */
@@ -529,9 +571,10 @@ static int avr910_paged_write_flash(const PROGRAMMER *pgm, const AVRPART *p, con
 
   if (page_wr_cmd_pending) {
     avr910_set_addr(pgm, page_addr>>1);
+    gettimeofday(&start, NULL);
     avr910_send(pgm, "m", 1);
     avr910_vfy_cmd_sent(pgm, "flush final page");
-    usleep(m->max_write_delay);
+    avr910_wait_since(&start, m->max_write_delay);
   }
 
   return addr;
@@ -545,6 +588,7 @@ static int avr910_paged_write_eeprom(const PROGRAMMER *pgm, const AVRPART *p,
 {
   char cmd[2];
   unsigned int max_addr = addr + n_bytes;
+  struct timeval start;
 
   avr910_set_addr(pgm, addr);
 
@@ -552,9 +596,10 @@ static int avr910_paged_write_eeprom(const PROGRAMMER *pgm, const AVRPART *p,
 
   while (addr < max_addr) {
     cmd[1] = m->buf[addr];
+    gettimeofday(&start, NULL);
     avr910_send(pgm, cmd, sizeof(cmd));
     avr910_vfy_cmd_sent(pgm, "write byte");
-    usleep(m->max_write_delay);
+    avr910_wait_since(&start, m->max_write_delay);
 
     addr++;
 
@@ -592,7 +637,8 @@ static int avr910_paged_write(const PROGRAMMER *pgm, const AVRPART *p, const AVR
       return -2;
 
     if (m->desc[0] == 'e') {
-      blocksize = 1;		/* Write to eeprom single bytes only */
+      if (!PDATA(pgm)->eeprom_blockmode)
+        blocksize = 1;		/* Write to eeprom single bytes only */
       wr_size = 1;
     } else {
       wr_size = 2;
@@ -615,11 +661,13 @@ static int avr910_paged_write(const PROGRAMMER *pgm, const AVRPART *p, const AVR
       cmd[2] = blocksize & 0xff;
 
       avr910_send(pgm, cmd, 4 + blocksize);
-      avr910_vfy_cmd_sent(pgm, "write block");
+      if (avr910_vfy_cmd_sent(pgm, "write block"))
+        PDATA(pgm)->addr_valid = 0;
 
       addr += blocksize;
     } /* while */
     free(cmd);
+    PDATA(pgm)->addr_next = addr / wr_size;
 
     rval = addr;
   }
@@ -666,10 +714,12 @@ static int avr910_paged_load(const PROGRAMMER *pgm, const AVRPART *p, const AVRM
       cmd[2] = blocksize & 0xff;
 
       avr910_send(pgm, cmd, 4);
-      avr910_recv(pgm, (char *)&m->buf[addr], blocksize);
+      if (avr910_recv(pgm, (char *)&m->buf[addr], blocksize))
+        PDATA(pgm)->addr_valid = 0;
 
       addr += blocksize;
     }
+    PDATA(pgm)->addr_next = addr / rd_size;
 
     rval = addr;
   } else {
@@ -26,6 +26,7 @@
 #define USER_CONF_FILE "avrdude.rc"
 #else
 #define USER_CONF_FILE ".avrduderc"
+#define CONFIG_CACHE_FILE ".avrdude.cache"
 #endif
 
 extern char * progname;		/* name of program, for messages */
@@ -48,6 +48,9 @@
 #define MIN(a,b) ((a)<(b)?(a):(b))
 #endif
 
+/* max bytes per MPSSE data command, its length field is 16 bits wide */
+#define MPSSE_MAX_DATA 65536
+
 #ifdef DO_NOT_BUILD_AVRFTDI
 
 static int avrftdi_noftdi_open(PROGRAMMER *pgm, const char *name) {
@@ -205,7 +208,8 @@ static int set_frequency(avrftdi_t* ftdi, uint32_t freq)
 		divisor = 65535;
 	}
 
-	log_info("Using frequency: %d\n", 6000000/(divisor+1));
+	ftdi->frequency = 6000000/(divisor+1);
+	log_info("Using frequency: %d\n", ftdi->frequency);
 	log_info("Clock divisor: 0x%04x\n", divisor);
 
 	buf[0] = TCK_DIVISOR;
@@ -409,26 +413,31 @@ static int avrftdi_transmit_mpsse(avrftdi_t* pdata, unsigned char mode, const un
 	size_t blocksize;
 	size_t remaining = buf_size;
 	size_t written = 0;
+	size_t cmd_remaining = 0;
 	
 	unsigned char cmd[3];
 //	unsigned char si = SEND_IMMEDIATE;
 
-	cmd[0] = mode | MPSSE_WRITE_NEG;
-	cmd[1] = ((buf_size - 1) & 0xff);
-	cmd[2] = (((buf_size - 1) >> 8) & 0xff);
-
 	//if we are not reading back, we can just write the data out
 	if(!(mode & MPSSE_DO_READ))
 		blocksize = buf_size;
 	else
 		blocksize = pdata->rx_buffer_size;
 
-	E(ftdi_write_data(pdata->ftdic, cmd, sizeof(cmd)) != sizeof(cmd), pdata->ftdic);
-
 	while(remaining)
 	{
 		size_t transfer_size = (remaining > blocksize) ? blocksize : remaining;
 
+		/* long streams are sent as a sequence of data commands */
+		if(!cmd_remaining) {
+			cmd_remaining = MIN(remaining, MPSSE_MAX_DATA);
+			cmd[0] = mode | MPSSE_WRITE_NEG;
+			cmd[1] = ((cmd_remaining - 1) & 0xff);
+			cmd[2] = (((cmd_remaining - 1) >> 8) & 0xff);
+			E(ftdi_write_data(pdata->ftdic, cmd, sizeof(cmd)) != sizeof(cmd), pdata->ftdic);
+		}
+		transfer_size = MIN(transfer_size, cmd_remaining);
+
 		E((size_t) ftdi_write_data(pdata->ftdic, (unsigned char*)&buf[written], transfer_size) != transfer_size, pdata->ftdic);
 #if 0
 		if(remaining < blocksize)
@@ -448,6 +457,7 @@ static int avrftdi_transmit_mpsse(avrftdi_t* pdata, unsigned char mode, const un
 		
 		written += transfer_size;
 		remaining -= transfer_size;
+		cmd_remaining -= transfer_size;
 	}
 	
 	return written;
@@ -925,7 +935,7 @@ avrftdi_lext(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *m, unsigned
 	return 0;
 }
 
-static int avrftdi_eeprom_write(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *m,
+static int avrftdi_eeprom_write_bytes(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *m,
 		unsigned int page_size, unsigned int addr, unsigned int len)
 {
 	unsigned char cmd[] = { 0x00, 0x00, 0x00, 0x00 };
@@ -947,29 +957,110 @@ static int avrftdi_eeprom_write(const PROGRAMMER *pgm, const AVRPART *p, const A
 	return len;
 }
 
+/*
+ * Write EEPROM bytes as one MPSSE stream. MPSSE cannot branch on MISO,
+ * so every write command is followed by as many read commands of the
+ * same address as it takes to clock away max_write_delay at the current
+ * SPI frequency. These double as data polling: once decoded, the write
+ * must show up in one of them.
+ */
+static int avrftdi_eeprom_write(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *m,
+		unsigned int page_size, unsigned int addr, unsigned int len)
+{
+	avrftdi_t* pdata = to_pdata(pgm);
+	unsigned int i, k, npoll, stride, buf_size, maxpoll = 0;
+	unsigned char *o_buf, *i_buf;
+
+	if (m->op[AVR_OP_WRITE] == NULL) {
+		log_err("AVR_OP_WRITE command not defined for %s\n", p->desc);
+		return -1;
+	}
+
+	/* bitbanging has no fixed SCK rate to time the polling reads with */
+	if (pdata->use_bitbanging || m->op[AVR_OP_READ] == NULL || !pdata->frequency)
+		return avrftdi_eeprom_write_bytes(pgm, p, m, page_size, addr, len);
+
+	/* each command clocks 32 bits */
+	npoll = (uint64_t) m->max_write_delay * pdata->frequency / 32000000 + 1;
+	stride = 4 * (1 + npoll);
+	buf_size = stride * len;
+	o_buf = cfg_malloc("avrftdi_eeprom_write()", buf_size);
+	i_buf = cfg_malloc("avrftdi_eeprom_write()", buf_size);
+
+	for (i = 0; i < len; i++) {
+		unsigned char *bufptr = o_buf + i*stride;
+
+		avr_set_bits(m->op[AVR_OP_WRITE], bufptr);
+		avr_set_addr(m->op[AVR_OP_WRITE], bufptr, addr + i);
+		avr_set_input(m->op[AVR_OP_WRITE], bufptr, m->buf[addr + i]);
+		for (k = 1; k <= npoll; k++) {
+			avr_set_bits(m->op[AVR_OP_READ], bufptr + 4*k);
+			avr_set_addr(m->op[AVR_OP_READ], bufptr + 4*k, addr + i);
+		}
+	}
+
+	log_debug("Transmitting %d EEPROM bytes with %d polls each\n", len, npoll);
+	if (0 > avrftdi_transmit(pgm, MPSSE_DO_READ | MPSSE_DO_WRITE, o_buf, i_buf, buf_size)) {
+		free(o_buf);
+		free(i_buf);
+		return -1;
+	}
+
+	for (i = 0; i < len; i++) {
+		unsigned char value = m->buf[addr + i], rbyte = 0;
+
+		/* 0xff and the part's readback values cannot be polled for */
+		if (value == 0xff || value == m->readback[0] || value == m->readback[1])
+			continue;
+
+		for (k = 1; k <= npoll; k++) {
+			avr_get_output(m->op[AVR_OP_READ], i_buf + i*stride + 4*k, &rbyte);
+			if (rbyte == value)
+				break;
+		}
+		if (k > npoll) {
+			log_err("EEPROM write at 0x%04x not confirmed (read 0x%02x, expected 0x%02x)\n",
+			        addr + i, rbyte, value);
+			free(o_buf);
+			free(i_buf);
+			return -1;
+		}
+		maxpoll = MAX(maxpoll, k);
+	}
+	log_debug("EEPROM writes finished after at most %d of %d polls\n", maxpoll, npoll);
+
+	free(o_buf);
+	free(i_buf);
+	return len;
+}
+
 static int avrftdi_eeprom_read(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *m,
 		unsigned int page_size, unsigned int addr, unsigned int len)
 {
-	unsigned char cmd[4];
 	unsigned int add;
-	unsigned char* buffer = alloca(len);
-	unsigned char* bufptr = buffer;
+	unsigned int buf_size = 4 * len;
+	unsigned char* o_buf = alloca(buf_size);
+	unsigned char* i_buf = alloca(buf_size);
 
-	memset(buffer, 0, len);
+	if (m->op[AVR_OP_READ] == NULL) {
+		log_err("AVR_OP_READ command not defined for %s\n", p->desc);
+		return -1;
+	}
 
-	for (add = addr; add < addr + len; add++)
+	/* one read command per byte, all in a single transfer */
+	memset(o_buf, 0, buf_size);
+	for (add = 0; add < len; add++)
 	{
-		memset(cmd, 0, sizeof(cmd));
-		avr_set_bits(m->op[AVR_OP_READ], cmd);
-		avr_set_addr(m->op[AVR_OP_READ], cmd, add);
+		avr_set_bits(m->op[AVR_OP_READ], &o_buf[add*4]);
+		avr_set_addr(m->op[AVR_OP_READ], &o_buf[add*4], addr + add);
+	}
 
-		if (0 > avrftdi_transmit(pgm, MPSSE_DO_READ | MPSSE_DO_WRITE, cmd, cmd, 4))
-			return -1;
+	if (0 > avrftdi_transmit(pgm, MPSSE_DO_READ | MPSSE_DO_WRITE, o_buf, i_buf, buf_size))
+		return -1;
 
-		avr_get_output(m->op[AVR_OP_READ], cmd, bufptr++);
-	}
+	for (add = 0; add < len; add++)
+		avr_get_output(m->op[AVR_OP_READ], &i_buf[add*4], &m->buf[addr + add]);
 
-	memcpy(m->buf + addr, buffer, len);
 	return len;
 }
 
@@ -1104,6 +1195,17 @@ static int avrftdi_flash_read(const PROGRAMMER *pgm, const AVRPART *p, const AVR
 		log_err("AVR_OP_READ_HI command not defined for %s\n", p->desc);
 		return -1;
 	}
+
+	/* a multi-page read must not cross a 64k word (extended address) boundary */
+	if(m->op[AVR_OP_LOAD_EXT_ADDR] && (addr >> 17) != ((addr + len - 1) >> 17)) {
+		unsigned int first = (((addr >> 17) + 1) << 17) - addr;
+
+		if(avrftdi_flash_read(pgm, p, m, page_size, addr, first) < 0)
+			return -1;
+		if(avrftdi_flash_read(pgm, p, m, page_size, addr + first, len - first) < 0)
+			return -1;
+		return len;
+	}
 	
 	if(avrftdi_lext(pgm, p, m, addr/2) < 0)
 		return -1;
@@ -1127,20 +1229,20 @@ static int avrftdi_flash_read(const PROGRAMMER *pgm, const AVRPART *p, const AVR
 	 * subsequently fail.
 	 */
 	if(verbose > TRACE) {
-		buf_dump(o_buf, sizeof(o_buf), "o_buf", 0, 32);
+		buf_dump(o_buf, len * 4, "o_buf", 0, 32);
 	}
 
 	if (0 > avrftdi_transmit(pgm, MPSSE_DO_READ | MPSSE_DO_WRITE, o_buf, i_buf, len * 4))
 		return -1;
 
 	if(verbose > TRACE) {
-		buf_dump(i_buf, sizeof(i_buf), "i_buf", 0, 32);
+		buf_dump(i_buf, len * 4, "i_buf", 0, 32);
 	}
 
-	memset(&m->buf[addr], 0, page_size);
+	memset(&m->buf[addr], 0, len);
 
 	/* every (read) op is 4 bytes in size and yields one byte of memory data */
-	for(unsigned int byte = 0; byte < page_size; byte++) {
+	for(unsigned int byte = 0; byte < len; byte++) {
 		if(byte & 1)
 			readop = m->op[AVR_OP_READ_HI];
 		else
@@ -1153,7 +1255,7 @@ static int avrftdi_flash_read(const PROGRAMMER *pgm, const AVRPART *p, const AVR
 	}
 
 	if(verbose > TRACE)
-		buf_dump(&m->buf[addr], page_size, "page:", 0, 32);
+		buf_dump(&m->buf[addr], len, "page:", 0, 32);
 
 	return len;
 }
@@ -1245,6 +1347,7 @@ void avrftdi_initpgm(PROGRAMMER *pgm) {
 
 	pgm->paged_write = avrftdi_paged_write;
 	pgm->paged_load = avrftdi_paged_load;
+	pgm->max_read_chunk = 4096;
 
 	pgm->setpin = set_pin;
 
@@ -79,6 +79,8 @@ typedef struct avrftdi_s {
 	/* internal RX buffer of the device. needed for INOUT transfers */
 	int rx_buffer_size;
 	int tx_buffer_size;
+	/* SPI clock frequency in Hz as set by set_frequency() */
+	uint32_t frequency;
 	/* use bitbanging instead of mpsse spi */
 	bool use_bitbanging;
 	/* bits 16-23 of extended 24-bit word flash address for parts with flash > 128k */
@@ -31,22 +31,21 @@
  ***/
 
 OPCODE *avr_new_opcode(void) {
-  return (OPCODE *) cfg_malloc("avr_new_opcode()", sizeof(OPCODE));
+  return (OPCODE *) cfg_arena_malloc("avr_new_opcode()", sizeof(OPCODE));
 }
 
 static OPCODE *avr_dup_opcode(const OPCODE *op) {
   if(op == NULL)                // Caller wants NULL if op == NULL
     return NULL;
 
-  OPCODE *m = (OPCODE *) cfg_malloc("avr_dup_opcode()", sizeof(*m));
+  OPCODE *m = (OPCODE *) cfg_arena_malloc("avr_dup_opcode()", sizeof(*m));
   memcpy(m, op, sizeof(*m));
 
   return m;
 }
 
 void avr_free_opcode(OPCODE *op) {
-  if(op)
-    free(op);
+  cfg_free(op);
 }
 
 
@@ -64,26 +63,97 @@ int intlog2(unsigned int n) {
 }
 
 
+// Shift v left by s bits, or right if s is negative
+static inline uint32_t opshift(uint32_t v, int s) {
+  return s >= 0? v << s: v >> -s;
+}
+
+// Add command bit i that carries source bit bitno to the shift groups
+static void opshift_add(OPSHIFT *os, int i, int bitno) {
+  int k, shift = i - bitno;
+
+  if(os->n < 0)
+    return;
+  for(k = 0; k < os->n; k++)
+    if(os->shift[k] == shift)
+      break;
+  if(k == OPSHIFT_MAX) {
+    os->n = -1;
+    return;
+  }
+  if(k == os->n) {
+    os->shift[k] = shift;
+    os->mask[k] = 0;
+    os->n++;
+  }
+  os->mask[k] |= 1U << bitno;
+}
+
+static uint32_t opshift_encode(const OPSHIFT *os, uint32_t v) {
+  uint32_t w = 0;
+
+  for(int k = 0; k < os->n; k++)
+    w |= opshift(v & os->mask[k], os->shift[k]);
+
+  return w;
+}
+
+static uint32_t cmd2word(const unsigned char *cmd) {
+  return (uint32_t) cmd[0] << 24 | (uint32_t) cmd[1] << 16 | (uint32_t) cmd[2] << 8 | cmd[3];
+}
+
+static void word2cmd(uint32_t w, unsigned char *cmd) {
+  cmd[0] = w >> 24;
+  cmd[1] = w >> 16;
+  cmd[2] = w >> 8;
+  cmd[3] = w;
+}
+
+
 /*
- * avr_set_bits()
+ * avr_compile_opcode()
  *
- * Set instruction bits in the specified command based on the opcode.
+ * Compute the masks and shift groups of the opcode from its bit specs;
+ * must be called whenever op->bit[] has changed.
  */
-int avr_set_bits(const OPCODE *op, unsigned char *cmd) {
-  int i, j, bit;
-  unsigned char mask;
+void avr_compile_opcode(OPCODE *op) {
+  memset((char *) op + sizeof op->bit, 0, sizeof *op - sizeof op->bit);
 
-  for (i=0; i<32; i++) {
-    if (op->bit[i].type == AVR_CMDBIT_VALUE || op->bit[i].type == AVR_CMDBIT_IGNORE) {
-      j = 3 - i / 8;
-      bit = i % 8;
-      mask = 1 << bit;
-      if (op->bit[i].value && op->bit[i].type == AVR_CMDBIT_VALUE)
-        cmd[j] = cmd[j] | mask;
-      else
-        cmd[j] = cmd[j] & ~mask;
+  for(int i=0; i<32; i++) {
+    uint32_t bit = 1U << i;
+
+    switch(op->bit[i].type) {
+    case AVR_CMDBIT_VALUE:
+      if(op->bit[i].value)
+        op->fixbits |= bit;
+      // Fall through
+    case AVR_CMDBIT_IGNORE:
+      op->fixmask |= bit;
+      break;
+    case AVR_CMDBIT_ADDRESS:
+      op->amask |= bit;
+      opshift_add(&op->addr, i, op->bit[i].bitno & 31);
+      break;
+    case AVR_CMDBIT_INPUT:
+      op->imask |= bit;
+      opshift_add(&op->in, i, op->bit[i].bitno & 7);
+      break;
+    case AVR_CMDBIT_OUTPUT:
+      op->omask |= bit;
+      opshift_add(&op->out, i, op->bit[i].bitno & 7);
+      break;
     }
   }
+}
+
+
+/*
+ * avr_set_bits()
+ *
+ * Set instruction bits in the specified command based on the opcode.
+ */
+int avr_set_bits(const OPCODE *op, unsigned char *cmd) {
+  word2cmd((cmd2word(cmd) & ~op->fixmask) | op->fixbits, cmd);
 
   return 0;
 }
@@ -96,22 +166,15 @@ int avr_set_bits(const OPCODE *op, unsigned char *cmd) {
  * the address.
  */
 int avr_set_addr(const OPCODE *op, unsigned char *cmd, unsigned long addr) {
-  int i, j, bit;
-  unsigned long value;
-  unsigned char mask;
+  uint32_t w = 0;
 
-  for (i=0; i<32; i++) {
-    if (op->bit[i].type == AVR_CMDBIT_ADDRESS) {
-      j = 3 - i / 8;
-      bit = i % 8;
-      mask = 1 << bit;
-      value = addr >> op->bit[i].bitno & 0x01;
-      if (value)
-        cmd[j] = cmd[j] | mask;
-      else
-        cmd[j] = cmd[j] & ~mask;
-    }
-  }
+  if(op->addr.n >= 0)
+    w = opshift_encode(&op->addr, addr);
+  else                          // Address bits scattered over too many groups
+    for(int i=0; i<32; i++)
+      if(op->bit[i].type == AVR_CMDBIT_ADDRESS && (addr >> (op->bit[i].bitno & 31) & 1))
+        w |= 1U << i;
+  word2cmd((cmd2word(cmd) & ~op->amask) | w, cmd);
 
   return 0;
 }
@@ -219,22 +282,7 @@ int avr_set_addr_mem(const AVRMEM *mem, int opnum, unsigned char *cmd, unsigned
  * and the data byte.
  */
 int avr_set_input(const OPCODE *op, unsigned char *cmd, unsigned char data) {
-  int i, j, bit;
-  unsigned char value;
-  unsigned char mask;
-
-  for (i=0; i<32; i++) {
-    if (op->bit[i].type == AVR_CMDBIT_INPUT) {
-      j = 3 - i / 8;
-      bit = i % 8;
-      mask = 1 << bit;
-      value = data >> op->bit[i].bitno & 0x01;
-      if (value)
-        cmd[j] = cmd[j] | mask;
-      else
-        cmd[j] = cmd[j] & ~mask;
-    }
-  }
+  word2cmd((cmd2word(cmd) & ~op->imask) | opshift_encode(&op->in, data), cmd);
 
   return 0;
 }
@@ -247,23 +295,10 @@ int avr_set_input(const OPCODE *op, unsigned char *cmd, unsigned char data) {
  * opcode data.
  */
 int avr_get_output(const OPCODE *op, const unsigned char *res, unsigned char *data) {
-  int i, j, bit;
-  unsigned char value;
-  unsigned char mask;
+  uint32_t w = cmd2word(res);
 
-  for (i=0; i<32; i++) {
-    if (op->bit[i].type == AVR_CMDBIT_OUTPUT) {
-      j = 3 - i / 8;
-      bit = i % 8;
-      mask = 1 << bit;
-      value = ((res[j] & mask) >> bit) & 0x01;
-      value = value << op->bit[i].bitno;
-      if (value)
-        *data = *data | value;
-      else
-        *data = *data & ~value;
-    }
-  }
+  for(int k = 0; k < op->out.n; k++)
+    *data |= opshift(w, -op->out.shift[k]) & op->out.mask[k];
 
   return 0;
 }
@@ -276,16 +311,7 @@ int avr_get_output(const OPCODE *op, const unsigned char *res, unsigned char *da
  * opcode data.
  */
 int avr_get_output_index(const OPCODE *op) {
-  int i, j;
-
-  for (i=0; i<32; i++) {
-    if (op->bit[i].type == AVR_CMDBIT_OUTPUT) {
-      j = 3 - i / 8;
-      return j;
-    }
-  }
-
-  return -1;
+  return op->omask? 3 - intlog2(op->omask & -op->omask)/8: -1;
 }
 
 
@@ -327,7 +353,7 @@ static char * bittype(int type)
  ***/
 
 AVRMEM *avr_new_memtype(void) {
-  AVRMEM *m = (AVRMEM *) cfg_malloc("avr_new_memtype()", sizeof(*m));
+  AVRMEM *m = (AVRMEM *) cfg_arena_malloc("avr_new_memtype()", sizeof(*m));
   m->desc = cache_string("");
   m->page_size = 1; // ensure not 0
 
@@ -335,12 +361,19 @@ AVRMEM *avr_new_memtype(void) {
 }
 
 AVRMEM_ALIAS *avr_new_memalias(void) {
-  AVRMEM_ALIAS *m = (AVRMEM_ALIAS *) cfg_malloc("avr_new_memalias()", sizeof*m);
+  AVRMEM_ALIAS *m = (AVRMEM_ALIAS *) cfg_arena_malloc("avr_new_memalias()", sizeof*m);
   m->desc = cache_string("");
   return m;
 }
 
 
+// Bytes needed for one dirty bit per page of m
+static int avr_mem_dirty_size(const AVRMEM *m) {
+  int pgsize = m->page_size > 1? m->page_size: 1;
+
+  return ((m->size + pgsize-1)/pgsize + 7)/8;
+}
+
 /*
  * Allocate and initialize memory buffers for each of the device's
  * defined memory regions.
@@ -353,6 +386,7 @@ int avr_initmem(const AVRPART *p) {
     AVRMEM *m = ldata(ln);
     m->buf  = (unsigned char *) cfg_malloc("avr_initmem()", m->size);
     m->tags = (unsigned char *) cfg_malloc("avr_initmem()", m->size);
+    m->dirty = (unsigned char *) cfg_malloc("avr_initmem()", avr_mem_dirty_size(m));
   }
 
   return 0;
@@ -375,6 +409,19 @@ AVRMEM *avr_dup_mem(const AVRMEM *m) {
       memcpy(n->tags, m->tags, n->size);
     }
 
+    if(m->dirty) {
+      n->dirty = (unsigned char *) cfg_malloc("avr_dup_mem()", avr_mem_dirty_size(n));
+      memcpy(n->dirty, m->dirty, avr_mem_dirty_size(n));
+    }
+
+    n->extents = NULL;
+    n->nextents = n->maxextents = 0;
+    if(m->nextents) {
+      n->nextents = n->maxextents = m->nextents;
+      n->extents = cfg_malloc("avr_dup_mem()", n->maxextents*sizeof*n->extents);
+      memcpy(n->extents, m->extents, n->nextents*sizeof*n->extents);
+    }
+
     for(int i = 0; i < AVR_OP_MAX; i++)
       n->op[i] = avr_dup_opcode(n->op[i]);
   }
@@ -382,6 +429,198 @@ AVRMEM *avr_dup_mem(const AVRMEM *m) {
   return n;
 }
 
+/*
+ * Tag len bytes from addr as allocated and merge them into the sorted
+ * extent list of m; appending at or after the last extent, which is how
+ * all file readers fill memory, takes constant time. The pages touched
+ * are marked dirty.
+ */
+void avr_mem_set_allocated(AVRMEM *m, int addr, int len) {
+  AVRMEM_EXTENT *e;
+  int lo, hi, end;
+
+  if(!m || !m->tags)
+    return;
+  if(addr < 0)
+    len += addr, addr = 0;
+  if(len > m->size - addr)
+    len = m->size - addr;
+  if(len <= 0)
+    return;
+
+  memset(m->tags + addr, TAG_ALLOCATED, len);
+  end = addr + len;
+
+  if(m->dirty) {
+    int pgsize = m->page_size > 1? m->page_size: 1;
+    for(int pg = addr/pgsize; pg <= (end-1)/pgsize; pg++)
+      m->dirty[pg/8] |= 1 << (pg%8);
+  }
+
+  e = m->extents + m->nextents - 1;
+  if(m->nextents && e->addr <= addr && addr <= e->addr + e->len) {
+    if(end > e->addr + e->len)
+      e->len = end - e->addr;
+    return;
+  }
+
+  // First extent that touches or lies beyond [addr, end)
+  for(lo = 0, hi = m->nextents; lo < hi; ) {
+    int mid = (lo+hi)/2;
+    if(m->extents[mid].addr + m->extents[mid].len < addr)
+      lo = mid+1;
+    else
+      hi = mid;
+  }
+  // Extents lo..hi-1 touch [addr, end) and are merged into one
+  for(hi = lo; hi < m->nextents && m->extents[hi].addr <= end; hi++)
+    continue;
+
+  if(hi > lo) {
+    if(m->extents[lo].addr < addr)
+      addr = m->extents[lo].addr;
+    if(m->extents[hi-1].addr + m->extents[hi-1].len > end)
+      end = m->extents[hi-1].addr + m->extents[hi-1].len;
+    memmove(m->extents+lo+1, m->extents+hi, (m->nextents-hi)*sizeof*m->extents);
+    m->nextents -= hi-lo-1;
+  } else {
+    if(m->nextents == m->maxextents) {
+      m->maxextents = m->maxextents? 2*m->maxextents: 16;
+      m->extents = cfg_realloc("avr_mem_set_allocated()", m->extents, m->maxextents*sizeof*m->extents);
+    }
+    memmove(m->extents+lo+1, m->extents+lo, (m->nextents-lo)*sizeof*m->extents);
+    m->nextents++;
+  }
+  m->extents[lo].addr = addr;
+  m->extents[lo].len = end - addr;
+}
+
+// Untag all bytes of m and mark all pages clean
+void avr_mem_clear_allocated(AVRMEM *m) {
+  if(!m)
+    return;
+  if(m->tags)
+    memset(m->tags, 0, m->size);
+  if(m->dirty)
+    memset(m->dirty, 0, avr_mem_dirty_size(m));
+  m->nextents = 0;
+}
+
+/*
+ * A page is dirty when it holds allocated data that are not known to be
+ * on the chip; without a dirty map every page counts as dirty
+ */
+int avr_mem_page_dirty(const AVRMEM *m, int addr) {
+  int pg;
+
+  if(!m || !m->dirty || addr < 0 || addr >= m->size)
+    return 1;
+  pg = addr/(m->page_size > 1? m->page_size: 1);
+
+  return (m->dirty[pg/8] >> (pg%8)) & 1;
+}
+
+// Record that the page containing addr matches the chip
+void avr_mem_set_page_clean(AVRMEM *m, int addr) {
+  int pg;
+
+  if(!m || !m->dirty || addr < 0 || addr >= m->size)
+    return;
+  pg = addr/(m->page_size > 1? m->page_size: 1);
+  m->dirty[pg/8] &= ~(1 << (pg%8));
+}
+
+// Return the lowest allocated address >= addr, or -1 if there is none
+int avr_mem_next_allocated(const AVRMEM *m, int addr) {
+  int lo, hi;
+
+  if(!m)
+    return -1;
+
+  // First extent ending after addr
+  for(lo = 0, hi = m->nextents; lo < hi; ) {
+    int mid = (lo+hi)/2;
+    if(m->extents[mid].addr + m->extents[mid].len <= addr)
+      lo = mid+1;
+    else
+      hi = mid;
+  }
+  if(lo == m->nextents)
+    return -1;
+
+  return m->extents[lo].addr > addr? m->extents[lo].addr: addr;
+}
+
+/*
+ * Return the address of the first pgsize page at or above the page
+ * containing addr that holds allocated data below end, or -1 if none
+ */
+int avr_mem_next_page(const AVRMEM *m, int addr, int end, int pgsize) {
+  if(pgsize < 1)
+    pgsize = 1;
+  addr -= addr % pgsize;
+  if((addr = avr_mem_next_allocated(m, addr)) < 0 || addr >= end)
+    return -1;
+
+  return addr - addr % pgsize;
+}
+
+/*
+ * Like avr_mem_next_page() but skip pages that are clean, ie, known to
+ * match the chip already
+ */
+int avr_mem_next_dirty_page(const AVRMEM *m, int addr, int end, int pgsize) {
+  if(pgsize < 1)
+    pgsize = 1;
+  for(addr = avr_mem_next_page(m, addr, end, pgsize); addr >= 0;
+      addr = avr_mem_next_page(m, addr + pgsize, end, pgsize)) {
+    // A pgsize page is dirty if any memory page it overlaps is
+    for(int a = addr; a < addr + pgsize && a < m->size; a += m->page_size > 1? m->page_size: 1)
+      if(avr_mem_page_dirty(m, a))
+        return addr;
+  }
+
+  return -1;
+}
+
+// Number of dirty pgsize pages holding allocated data below end
+int avr_mem_count_dirty_pages(const AVRMEM *m, int end, int pgsize) {
+  int n = 0;
+
+  if(pgsize < 1)
+    pgsize = 1;
+  for(int addr = avr_mem_next_dirty_page(m, 0, end, pgsize); addr >= 0;
+      addr = avr_mem_next_dirty_page(m, addr + pgsize, end, pgsize))
+    n++;
+
+  return n;
+}
+
+// Number of pgsize pages holding allocated data below end
+int avr_mem_count_pages(const AVRMEM *m, int end, int pgsize) {
+  int n = 0, last = -1;
+
+  if(!m)
+    return 0;
+  if(pgsize < 1)
+    pgsize = 1;
+
+  for(int i = 0; i < m->nextents && m->extents[i].addr < end; i++) {
+    int first = m->extents[i].addr/pgsize;
+    int final = m->extents[i].addr + m->extents[i].len;
+
+    final = ((final < end? final: end) - 1)/pgsize;
+    if(first <= last)
+      first = last+1;
+    if(final >= first)
+      n += final - first + 1;
+    if(final > last)
+      last = final;
+  }
+
+  return n;
+}
+
 AVRMEM_ALIAS *avr_dup_memalias(const AVRMEM_ALIAS *m) {
   AVRMEM_ALIAS *n = avr_new_memalias();
 
@@ -403,18 +642,25 @@ void avr_free_mem(AVRMEM * m) {
     free(m->tags);
     m->tags = NULL;
   }
+  if(m->extents) {
+    free(m->extents);
+    m->extents = NULL;
+  }
+  if(m->dirty) {
+    free(m->dirty);
+    m->dirty = NULL;
+  }
   for(size_t i=0; i<sizeof(m->op)/sizeof(m->op[0]); i++) {
     if(m->op[i]) {
       avr_free_opcode(m->op[i]);
       m->op[i] = NULL;
     }
   }
-  free(m);
+  cfg_free(m);
 }
 
 void avr_free_memalias(AVRMEM_ALIAS *m) {
-  if(m)
-    free(m);
+  cfg_free(m);
 }
 
 AVRMEM_ALIAS *avr_locate_memalias(const AVRPART *p, const char *desc) {
@@ -568,7 +814,7 @@ void avr_mem_display(const char *prefix, FILE *f, const AVRMEM *m,
  */
 
 AVRPART *avr_new_part(void) {
-  AVRPART *p = (AVRPART *) cfg_malloc("avr_new_part()", sizeof(AVRPART));
+  AVRPART *p = (AVRPART *) cfg_arena_malloc("avr_new_part()", sizeof(AVRPART));
   const char *nulp = cache_string("");
 
   memset(p, 0, sizeof(*p));
@@ -643,7 +889,80 @@ void avr_free_part(AVRPART * d)
       d->op[i] = NULL;
     }
   }
-  free(d);
+  cfg_free(d);
+}
+
+/*
+ * Hash index of a part list for locate_part(), locate_part_by_signature()
+ * and locate_part_by_avr910_devcode(). Each key has a chain of entries in
+ * list order, so lookups return the same (first) match as a list walk.
+ * Name entry 2*i is the id of part i, 2*i+1 its description.
+ */
+static struct {
+  LISTID list;                  // Indexed list, NULL if none
+  int n, nb, bits;              // Number of parts, number of buckets, nb == 1<<bits
+  AVRPART **part;               // Parts in list order
+  int *name_head, *name_next;   // Chains of id/desc entries
+  int *sig_head, *sig_next;     // Chains of parts by signature
+  int *dev_head, *dev_next;     // Chains of parts by AVR910 device code
+} pidx;
+
+// Fibonacci hashing: the top bits of the product are the well-mixed ones
+static unsigned sighash(const unsigned char *sig) {
+  return (uint32_t) ((sig[0] << 16 | sig[1] << 8 | sig[2]) * 2654435761U) >> (32 - pidx.bits);
+}
+
+static void pidx_add(int *head, int *next, unsigned h, int e) {
+  h &= pidx.nb - 1;
+  next[e] = head[h];
+  head[h] = e;
+}
+
+/*
+ * Build the hash index of the part list parts, replacing any previous
+ * index; a NULL list drops the index. The list must not change while it
+ * is indexed: call again after modifying or sorting it.
+ */
+void avr_index_parts(LISTID parts) {
+  free(pidx.part);
+  free(pidx.name_head);
+  free(pidx.name_next);
+  free(pidx.sig_head);
+  free(pidx.sig_next);
+  free(pidx.dev_head);
+  free(pidx.dev_next);
+  memset(&pidx, 0, sizeof pidx);
+
+  if(!parts)
+    return;
+
+  pidx.list = parts;
+  pidx.n = lsize(parts);
+  for(pidx.nb = 16, pidx.bits = 4; pidx.nb < 2*pidx.n; pidx.nb *= 2, pidx.bits++)
+    continue;
+
+  pidx.part = cfg_malloc("avr_index_parts()", (pidx.n+1)*sizeof*pidx.part);
+  pidx.name_head = cfg_malloc("avr_index_parts()", pidx.nb*sizeof(int));
+  pidx.name_next = cfg_malloc("avr_index_parts()", (2*pidx.n+1)*sizeof(int));
+  pidx.sig_head = cfg_malloc("avr_index_parts()", pidx.nb*sizeof(int));
+  pidx.sig_next = cfg_malloc("avr_index_parts()", (pidx.n+1)*sizeof(int));
+  pidx.dev_head = cfg_malloc("avr_index_parts()", pidx.nb*sizeof(int));
+  pidx.dev_next = cfg_malloc("avr_index_parts()", (pidx.n+1)*sizeof(int));
+  for(int h = 0; h < pidx.nb; h++)
+    pidx.name_head[h] = pidx.sig_head[h] = pidx.dev_head[h] = -1;
+
+  int i = 0;
+  for(LNODEID ln = lfirst(parts); ln; ln = lnext(ln))
+    pidx.part[i++] = ldata(ln);
+
+  // Add in reverse order so that chains are in list order
+  for(i = pidx.n-1; i >= 0; i--) {
+    AVRPART *p = pidx.part[i];
+    pidx_add(pidx.name_head, pidx.name_next, strcasehash(p->desc), 2*i+1);
+    pidx_add(pidx.name_head, pidx.name_next, strcasehash(p->id), 2*i);
+    pidx_add(pidx.sig_head, pidx.sig_next, sighash(p->signature), i);
+    pidx_add(pidx.dev_head, pidx.dev_next, p->avr910_devcode, i);
+  }
 }
 
 AVRPART *locate_part(const LISTID parts, const char *partdesc) {
@@ -653,6 +972,13 @@ AVRPART *locate_part(const LISTID parts, const char *partdesc) {
   if(!parts || !partdesc)
     return NULL;
 
+  if(parts == pidx.list) {
+    for(int e = pidx.name_head[strcasehash(partdesc) & (pidx.nb-1)]; e >= 0; e = pidx.name_next[e])
+      if(strcasecmp(partdesc, e & 1? pidx.part[e/2]->desc: pidx.part[e/2]->id) == 0)
+        return pidx.part[e/2];
+    return NULL;
+  }
+
   for (LNODEID ln1=lfirst(parts); ln1 && !found; ln1=lnext(ln1)) {
     p = ldata(ln1);
     if ((strcasecmp(partdesc, p->id) == 0) ||
@@ -664,6 +990,13 @@ AVRPART *locate_part(const LISTID parts, const char *partdesc) {
 }
 
 AVRPART *locate_part_by_avr910_devcode(const LISTID parts, int devcode) {
+  if(parts && parts == pidx.list) {
+    for(int i = pidx.dev_head[devcode & (pidx.nb-1)]; i >= 0; i = pidx.dev_next[i])
+      if(pidx.part[i]->avr910_devcode == devcode)
+        return pidx.part[i];
+    return NULL;
+  }
+
   if(parts)
     for (LNODEID ln1=lfirst(parts); ln1; ln1=lnext(ln1)) {
       AVRPART * p = ldata(ln1);
@@ -675,6 +1008,13 @@ AVRPART *locate_part_by_avr910_devcode(const LISTID parts, int devcode) {
 }
 
 AVRPART *locate_part_by_signature(const LISTID parts, unsigned char *sig, int sigsize) {
+  if(parts && sigsize == 3 && parts == pidx.list) {
+    for(int i = pidx.sig_head[sighash(sig) & (pidx.nb-1)]; i >= 0; i = pidx.sig_next[i])
+      if(memcmp(pidx.part[i]->signature, sig, 3) == 0)
+        return pidx.part[i];
+    return NULL;
+  }
+
   if(parts && sigsize == 3)
     for(LNODEID ln1=lfirst(parts); ln1; ln1=lnext(ln1)) {
       AVRPART *p = ldata(ln1);
@@ -726,6 +1066,8 @@ static int sort_avrparts_compare(const AVRPART *p1, const AVRPART *p2) {
 void sort_avrparts(LISTID avrparts)
 {
   lsort(avrparts,(int (*)(void*, void*)) sort_avrparts_compare);
+  if(avrparts == pidx.list)     // Keep first-match order of the index
+    avr_index_parts(avrparts);
 }
 
 
@@ -111,7 +111,7 @@ static int buspirate_send_bin(const PROGRAMMER *pgm, const unsigned char *data,
 	avrdude_message(MSG_DEBUG, "%s: buspirate_send_bin():\n", progname);
 	dump_mem(MSG_DEBUG, data, len);
 
-	rc = serial_send(&pgm->fd, data, len);
+	rc = serial_send(pgm, &pgm->fd, data, len);
 
 	return rc;
 }
@@ -119,7 +119,7 @@ static int buspirate_send_bin(const PROGRAMMER *pgm, const unsigned char *data,
 static int buspirate_recv_bin(const PROGRAMMER *pgm, unsigned char *buf, size_t len) {
 	int rc;
 
-	rc = serial_recv(&pgm->fd, buf, len);
+	rc = serial_recv(pgm, &pgm->fd, buf, len);
 	if (rc < 0)
 		return EOF;
 
@@ -163,7 +163,7 @@ static int buspirate_getc(const PROGRAMMER *pgm) {
 		return EOF;
 	}
 
-	rc = serial_recv(&pgm->fd, &ch, 1);
+	rc = serial_recv(pgm, &pgm->fd, &ch, 1);
 	if (rc < 0)
 		return EOF;
 	return ch;
@@ -228,7 +228,7 @@ static int buspirate_send(const PROGRAMMER *pgm, const char *str) {
 		return -1;
 	}
 
-	rc = serial_send(&pgm->fd, (const unsigned char*)str, strlen(str));
+	rc = serial_send(pgm, &pgm->fd, (const unsigned char*)str, strlen(str));
 	if (rc)
 		return rc;
 	do {
@@ -265,7 +265,7 @@ static int buspirate_expect(const PROGRAMMER *pgm, char *send,
 		}
 		if (strncmp(rcvd, expect, expect_len) == 0) {
 			if (! wait_for_prompt) {
-				serial_drain(&pgm->fd, 0);
+				serial_drain(pgm, &pgm->fd, 0);
 				return 1;
 			} else {
 				got_it = 1;
@@ -418,19 +418,19 @@ static int buspirate_open(PROGRAMMER *pgm, const char *port) {
 	pinfo.serialinfo.baud = pgm->baudrate;
 	pinfo.serialinfo.cflags = SERIAL_8N1;
 	strcpy(pgm->port, port);
-	if (serial_open(port, pinfo, &pgm->fd)==-1) {
+	if (serial_open(pgm, port, pinfo, &pgm->fd)==-1) {
 		return -1;
 	}
 
 	/* drain any extraneous input */
-	serial_drain(&pgm->fd, 0);
+	serial_drain(pgm, &pgm->fd, 0);
 
 	return 0;
 }
 
 static void buspirate_close(PROGRAMMER *pgm)
 {
-	serial_close(&pgm->fd);
+	serial_close(pgm, &pgm->fd);
 	pgm->fd.ifd = -1;
 }
 
@@ -584,7 +584,7 @@ static int buspirate_start_mode_bin(PROGRAMMER *pgm)
 			avrdude_message(MSG_NOTICE, "%s: Disabling paged flash write. (Need BusPirate firmware >=v5.10.)\n", progname);
 
 			/* Flush serial buffer: */
-			serial_drain(&pgm->fd, 0);
+			serial_drain(pgm, &pgm->fd, 0);
 		} else {
 			avrdude_message(MSG_INFO, "%s: Paged flash write enabled.\n", progname);
 		}
@@ -706,7 +706,7 @@ static void buspirate_enable(PROGRAMMER *pgm, const AVRPART *p) {
 		buspirate_send_bin(pgm, (const unsigned char*)"\n\n", 2);
 
 		/* Clear input buffer: */
-		serial_drain(&pgm->fd, 0);
+		serial_drain(pgm, &pgm->fd, 0);
 
 		/* Attempt to enter binary mode: */
 		if (buspirate_start_mode_bin(pgm) >= 0)
@@ -1164,7 +1164,7 @@ static void buspirate_bb_enable(PROGRAMMER *pgm, const AVRPART *p) {
 	buspirate_send_bin(pgm, (const unsigned char*)"\n\n", 2);
 
 	/* Clear input buffer: */
-	serial_drain(&pgm->fd, 0);
+	serial_drain(pgm, &pgm->fd, 0);
 
 	/* == Switch to binmode - send 20x '\0' == */
 	buspirate_send_bin(pgm, buf, sizeof(buf));
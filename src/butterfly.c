@@ -56,6 +56,9 @@ struct pdata
 {
   char has_auto_incr_addr;
   unsigned int buffersize;
+  int eeprom_blockmode;		/* use 'B'/'g' block access for EEPROM too */
+  int addr_valid;		/* bootloader address is known to be addr_next */
+  unsigned long addr_next;
 };
 
 #define PDATA(pgm) ((struct pdata *)(pgm->cookie))
@@ -76,14 +79,21 @@ static void butterfly_teardown(PROGRAMMER * pgm)
 }
 
 static int butterfly_send(const PROGRAMMER *pgm, char *buf, size_t len) {
-  return serial_send(&pgm->fd, (unsigned char *)buf, len);
+  /*
+   * Only the address and block commands leave the bootloader's address
+   * where butterfly_set_addr() and the paged functions expect it
+   */
+  if (len < 1 || !strchr("AHBg", buf[0]))
+    PDATA(pgm)->addr_valid = 0;
+
+  return serial_send(pgm, &pgm->fd, (unsigned char *)buf, len);
 }
 
 
 static int butterfly_recv(const PROGRAMMER *pgm, char *buf, size_t len) {
   int rv;
 
-  rv = serial_recv(&pgm->fd, (unsigned char *)buf, len);
+  rv = serial_recv(pgm, &pgm->fd, (unsigned char *)buf, len);
   if (rv < 0) {
     avrdude_message(MSG_INFO, "%s: butterfly_recv(): programmer is not responding\n",
                     progname);
@@ -94,7 +104,7 @@ static int butterfly_recv(const PROGRAMMER *pgm, char *buf, size_t len) {
 
 
 static int butterfly_drain(const PROGRAMMER *pgm, int display) {
-  return serial_drain(&pgm->fd, display);
+  return serial_drain(pgm, &pgm->fd, display);
 }
 
 
@@ -375,7 +385,7 @@ static int butterfly_open(PROGRAMMER *pgm, const char *port) {
   }
   pinfo.serialinfo.baud = pgm->baudrate;
   pinfo.serialinfo.cflags = SERIAL_8N1;
-  if (serial_open(port, pinfo, &pgm->fd)==-1) {
+  if (serial_open(pgm, port, pinfo, &pgm->fd)==-1) {
     return -1;
   }
 
@@ -394,7 +404,7 @@ static void butterfly_close(PROGRAMMER * pgm)
   butterfly_send(pgm, "E", 1);
   butterfly_vfy_cmd_sent(pgm, "exit bootloader");
 
-  serial_close(&pgm->fd);
+  serial_close(pgm, &pgm->fd);
   pgm->fd.ifd = -1;
 }
 
@@ -407,25 +417,34 @@ static void butterfly_display(const PROGRAMMER *pgm, const char *p) {
 static void butterfly_set_addr(const PROGRAMMER *pgm, unsigned long addr) {
   char cmd[3];
 
+  /* block commands auto-increment the address: nothing to do if sequential */
+  if (PDATA(pgm)->addr_valid && PDATA(pgm)->addr_next == addr)
+    return;
+
   cmd[0] = 'A';
   cmd[1] = (addr >> 8) & 0xff;
   cmd[2] = addr & 0xff;
   
   butterfly_send(pgm, cmd, sizeof(cmd));
-  butterfly_vfy_cmd_sent(pgm, "set addr");
+  PDATA(pgm)->addr_valid = butterfly_vfy_cmd_sent(pgm, "set addr") == 0;
+  PDATA(pgm)->addr_next = addr;
 }
 
 
 static void butterfly_set_extaddr(const PROGRAMMER *pgm, unsigned long addr) {
   char cmd[4];
 
+  if (PDATA(pgm)->addr_valid && PDATA(pgm)->addr_next == addr)
+    return;
+
   cmd[0] = 'H';
   cmd[1] = (addr >> 16) & 0xff;
   cmd[2] = (addr >> 8) & 0xff;
   cmd[3] = addr & 0xff;
 
   butterfly_send(pgm, cmd, sizeof(cmd));
-  butterfly_vfy_cmd_sent(pgm, "set extaddr");
+  PDATA(pgm)->addr_valid = butterfly_vfy_cmd_sent(pgm, "set extaddr") == 0;
+  PDATA(pgm)->addr_next = addr;
 }
 
 
@@ -467,8 +486,13 @@ static int butterfly_write_byte(const PROGRAMMER *pgm, const AVRPART *p, const A
     return -1;
 
   butterfly_send(pgm, cmd, size);
-  if (butterfly_vfy_cmd_sent(pgm, "write byte") < 0)
+  if (butterfly_vfy_cmd_sent(pgm, "write byte") < 0) {
+      PDATA(pgm)->addr_valid = 0;
       return -1;
+  }
+  /* 'B' auto-increments the bootloader's address */
+  if (cmd[0] == 'B')
+    PDATA(pgm)->addr_next = addr + 1;
 
   return 0;
 }
@@ -498,7 +522,10 @@ static int butterfly_read_byte_flash(const PROGRAMMER *pgm, const AVRPART *p, co
     butterfly_send(pgm, "g\000\002F", 4);
 
     /* Read back the program mem word (MSB first) */
-    butterfly_recv(pgm, buf, sizeof(buf));
+    if (butterfly_recv(pgm, buf, sizeof(buf)) < 0)
+      PDATA(pgm)->addr_valid = 0;
+    /* 'g' auto-increments the bootloader's (word) address */
+    PDATA(pgm)->addr_next = (addr >> 1) + 1;
 
     if ((addr & 0x01) == 0) {
       *value = buf[0];
@@ -520,7 +547,10 @@ static int butterfly_read_byte_eeprom(const PROGRAMMER *pgm, const AVRPART *p, c
 {
   butterfly_set_addr(pgm, addr);
   butterfly_send(pgm, "g\000\001E", 4);
-  butterfly_recv(pgm, (char *)value, 1);
+  if (butterfly_recv(pgm, (char *)value, 1) < 0)
+    PDATA(pgm)->addr_valid = 0;
+  /* 'g' auto-increments the bootloader's address */
+  PDATA(pgm)->addr_next = addr + 1;
   return 0;
 }
 
@@ -583,8 +613,11 @@ static int butterfly_paged_write(const PROGRAMMER *pgm, const AVRPART *p, const
   if (strcmp(m->desc, "flash") && strcmp(m->desc, "eeprom"))
     return -2;
 
-  if (m->desc[0] == 'e')
-    wr_size = blocksize = 1;		/* Write to eeprom single bytes only */
+  if (m->desc[0] == 'e') {
+    wr_size = 1;
+    if (!PDATA(pgm)->eeprom_blockmode)
+      blocksize = 1;		/* Write to eeprom single bytes only */
+  }
 
   if (use_ext_addr) {
     butterfly_set_extaddr(pgm, addr / wr_size);
@@ -592,13 +625,6 @@ static int butterfly_paged_write(const PROGRAMMER *pgm, const AVRPART *p, const
     butterfly_set_addr(pgm, addr / wr_size);
   }
 
-#if 0
-  usleep(1000000);
-  butterfly_send(pgm, "y", 1);
-  if (butterfly_vfy_cmd_sent(pgm, "clear LED") < 0)
-    return -1;
-#endif
-
   cmd = malloc(4+blocksize);
   if (!cmd) return -1;
   cmd[0] = 'B';
@@ -613,12 +639,16 @@ static int butterfly_paged_write(const PROGRAMMER *pgm, const AVRPART *p, const
     cmd[2] = blocksize & 0xff;
 
     butterfly_send(pgm, cmd, 4+blocksize);
-    if (butterfly_vfy_cmd_sent(pgm, "write block") < 0)
+    if (butterfly_vfy_cmd_sent(pgm, "write block") < 0) {
+      PDATA(pgm)->addr_valid = 0;
+      free(cmd);
       return -1;
+    }
 
     addr += blocksize;
   } /* while */
   free(cmd);
+  PDATA(pgm)->addr_next = addr / wr_size;
 
   return addr;
 }
@@ -638,8 +668,11 @@ static int butterfly_paged_load(const PROGRAMMER *pgm, const AVRPART *p, const A
   if (strcmp(m->desc, "flash") && strcmp(m->desc, "eeprom"))
     return -2;
 
-  if (m->desc[0] == 'e')
-    rd_size = blocksize = 1;		/* Read from eeprom single bytes only */
+  if (m->desc[0] == 'e') {
+    rd_size = 1;
+    if (!PDATA(pgm)->eeprom_blockmode)
+      blocksize = 1;		/* Read from eeprom single bytes only */
+  }
 
   {		/* use buffered mode */
     char cmd[4];
@@ -660,10 +693,14 @@ static int butterfly_paged_load(const PROGRAMMER *pgm, const AVRPART *p, const A
       cmd[2] = blocksize & 0xff;
 
       butterfly_send(pgm, cmd, 4);
-      butterfly_recv(pgm, (char *)&m->buf[addr], blocksize);
+      if (butterfly_recv(pgm, (char *)&m->buf[addr], blocksize) < 0) {
+        PDATA(pgm)->addr_valid = 0;
+        return -1;
+      }
 
       addr += blocksize;
     } /* while */
+    PDATA(pgm)->addr_next = addr / rd_size;
   }
 
   return addr * rd_size;
@@ -689,6 +726,30 @@ static int butterfly_read_sig_bytes(const PROGRAMMER *pgm, const AVRPART *p, con
   return 3;
 }
 
+static int butterfly_parseextparms(const PROGRAMMER *pgm, const LISTID extparms) {
+  LNODEID ln;
+  const char *extended_param;
+  int rv = 0;
+
+  for (ln = lfirst(extparms); ln; ln = lnext(ln)) {
+    extended_param = ldata(ln);
+
+    if (strcmp(extended_param, "eeprom_blockmode") == 0) {
+      avrdude_message(MSG_NOTICE2, "%s: butterfly_parseextparms(): using block mode for EEPROM\n",
+                      progname);
+      PDATA(pgm)->eeprom_blockmode = 1;
+      continue;
+    }
+
+    avrdude_message(MSG_INFO, "%s: butterfly_parseextparms(): invalid extended parameter '%s'\n",
+                    progname, extended_param);
+    rv = -1;
+  }
+
+  return rv;
+}
+
+
 const char butterfly_desc[] = "Atmel Butterfly evaluation board; Atmel AppNotes AVR109, AVR911";
 
 void butterfly_initpgm(PROGRAMMER *pgm) {
@@ -723,6 +784,7 @@ void butterfly_initpgm(PROGRAMMER *pgm) {
   pgm->paged_load = butterfly_paged_load;
 
   pgm->read_sig_bytes = butterfly_read_sig_bytes;
+  pgm->parseextparams = butterfly_parseextparms;
 
   pgm->setup          = butterfly_setup;
   pgm->teardown       = butterfly_teardown;
@@ -27,6 +27,14 @@
 #include <stddef.h>
 #include <string.h>
 #include <ctype.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#if !defined(WIN32)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
 
 #include "avrdude.h"
 #include "libavrdude.h"
@@ -40,6 +48,7 @@ const char *default_parallel;
 const char *default_serial;
 const char *default_spi;
 double default_bitclock;
+bool cfg_keep_comments = true;  // Capture comments for developer options
 
 LISTID       string_list;
 LISTID       number_list;
@@ -74,12 +83,21 @@ Component_t avr_comp[] = {
 
 #define DEBUG 0
 
+static void cc_lazy_free(void);
+static void free_string_cache(void);
+static void cfg_arena_free(void);
+
 void cleanup_config(void)
 {
+  cc_lazy_free();
+  avr_index_parts(NULL);
+  pgm_index_programmers(NULL);
   ldestroy_cb(part_list, (void(*)(void*))avr_free_part);
   ldestroy_cb(programmers, (void(*)(void*))pgm_free);
   ldestroy_cb(string_list, (void(*)(void*))free_token);
   ldestroy_cb(number_list, (void(*)(void*))free_token);
+  free_string_cache();
+  cfg_arena_free();
 }
 
 int init_config(void)
@@ -131,6 +149,105 @@ char *cfg_strdup(const char *funcname, const char *s) {
 }
 
 
+/*
+ * Arena for objects that live as long as the configuration: parts,
+ * memories, opcodes, aliases and cached strings created while config
+ * files are read are carved out of large chunks that cleanup_config()
+ * releases at once. cfg_free() ignores arena objects, so the usual free
+ * functions can be applied to any object. Outside reading config files
+ * cfg_arena_malloc() is the same as cfg_malloc(). Chunk sizes double, so
+ * there are few chunks for cfg_free() to check.
+ */
+
+#define CFG_ARENA_CHUNK (256*1024)
+#define CFG_ARENA_ALIGN 16
+
+typedef struct cfg_chunk {
+  struct cfg_chunk *next;
+  size_t size, used;
+  unsigned char *data;
+} CFG_CHUNK;
+
+static struct {
+  int on;                       // Reading config files
+  CFG_CHUNK *chunks;            // Newest first
+  unsigned long nalloc, nbytes; // Statistics
+  int nchunks;
+} arena;
+
+void *cfg_arena_malloc(const char *funcname, size_t n) {
+  CFG_CHUNK *c = arena.chunks;
+  void *ret;
+
+  if(!arena.on)
+    return cfg_malloc(funcname, n);
+
+  n = (n + CFG_ARENA_ALIGN-1) & ~(size_t) (CFG_ARENA_ALIGN-1);
+  if(!c || c->size - c->used < n) {
+    size_t size = c? 2*c->size: CFG_ARENA_CHUNK;
+    if(size < n)
+      size = n;
+    // Chunk header is rounded up so the data stay aligned
+    size_t hdr = (sizeof *c + CFG_ARENA_ALIGN-1) & ~(size_t) (CFG_ARENA_ALIGN-1);
+    c = cfg_malloc(funcname, hdr + size);
+    c->data = (unsigned char *) c + hdr;
+    c->size = size;
+    c->next = arena.chunks;
+    arena.chunks = c;
+    arena.nchunks++;
+  }
+
+  ret = c->data + c->used;      // Chunks are zeroed by cfg_malloc()
+  c->used += n;
+  arena.nalloc++;
+  arena.nbytes += n;
+
+  return ret;
+}
+
+char *cfg_arena_strdup(const char *funcname, const char *s) {
+  size_t n = strlen(s) + 1;
+
+  return memcpy(cfg_arena_malloc(funcname, n), s, n);
+}
+
+// Free p unless it belongs to the arena
+void cfg_free(void *p) {
+  if(!p)
+    return;
+
+  for(CFG_CHUNK *c = arena.chunks; c; c = c->next)
+    if((unsigned char *) p >= c->data && (unsigned char *) p < c->data + c->size)
+      return;
+
+  free(p);
+}
+
+// Objects created from now on until cfg_arena_end() go into the arena
+static void cfg_arena_begin(void) {
+  arena.on = 1;
+}
+
+static void cfg_arena_end(void) {
+  arena.on = 0;
+}
+
+static void cfg_arena_stats(void) {
+  avrdude_message(MSG_DEBUG, "%s: config arena holds %lu objects in %lu bytes (%d chunks)\n",
+    progname, arena.nalloc, arena.nbytes, arena.nchunks);
+}
+
+static void cfg_arena_free(void) {
+  CFG_CHUNK *c, *next;
+
+  for(c = arena.chunks; c; c = next) {
+    next = c->next;
+    free(c);
+  }
+  memset(&arena, 0, sizeof arena);
+}
+
+
 int yywrap()
 {
   return 1;
@@ -347,6 +464,10 @@ int read_config(const char * file)
   FILE * f;
   int r;
 
+  // Parsing modifies the lists
+  avr_index_parts(NULL);
+  pgm_index_programmers(NULL);
+
   if(!(cfg_infile = realpath(file, NULL))) {
     avrdude_message(MSG_INFO, "%s: can't determine realpath() of config file \"%s\": %s\n",
             progname, file, strerror(errno));
@@ -365,7 +486,10 @@ int read_config(const char * file)
   cfg_lineno = 1;
   yyin   = f;
 
+  cfg_arena_begin();
   r = yyparse();
+  cfg_arena_end();
+  cfg_arena_stats();
 
 #ifdef HAVE_YYLEX_DESTROY
   /* reset lexer and free any allocated memory */
@@ -394,6 +518,17 @@ unsigned strhash(const char *str) {
 }
 
 
+// Case-insensitive variant of strhash() that hashes the whole string
+unsigned strcasehash(const char *str) {
+  unsigned c, hash = 5381;
+
+  while((c = (unsigned char) *str++))
+    hash = 33*hash ^ tolower(c);
+
+  return hash;
+}
+
+
 static char **hstrings[1<<12];
 
 // Return a copy of the argument as hashed string
@@ -417,7 +552,17 @@ const char *cache_string(const char *p) {
 
   hstrings[h][k+1]=NULL;
 
-  return hstrings[h][k] = cfg_strdup("cache_string()", p);
+  return hstrings[h][k] = cfg_arena_strdup("cache_string()", p);
+}
+
+static void free_string_cache(void) {
+  for(size_t h = 0; h < sizeof hstrings/sizeof*hstrings; h++)
+    if(hstrings[h]) {
+      for(int k = 0; hstrings[h][k]; k++)
+        cfg_free(hstrings[h][k]);
+      free(hstrings[h]);
+      hstrings[h] = NULL;
+    }
 }
 
 
@@ -466,6 +611,9 @@ LISTID cfg_get_prologue(void) {
 
 // Captures comments during parsing
 void capture_comment_str(const char *com, int lineno) {
+  if(!cfg_keep_comments)
+    return;
+
   if(!cfg_comms)
     cfg_comms = lcreat(NULL, 0);
   ladd(cfg_comms, cfg_strdup("capture_comment_str()", com));
@@ -477,6 +625,9 @@ void capture_comment_str(const char *com, int lineno) {
 
 // Capture assignments (keywords left of =) and associate comments to them
 void capture_lvalue_kw(const char *kw, int lineno) {
+  if(!cfg_keep_comments)
+    return;
+
   if(!strcmp(kw, "memory")) {   // Push part comments and start memory comments
     if(!cfg_pushed) {           // config_gram.y pops the part comments
       cfg_pushed = 1;
@@ -883,3 +1034,652 @@ void cfg_update_mcuid(AVRPART *part) {
     yywarning("mcuid %d for %s is out of range [0..%d], use a free number >= %d",
       part->mcuid, part->desc, UB_N_MCU-1, sizeof uP_table/sizeof *uP_table);
 }
+
+
+/*
+ * Binary cache of the parsed configuration
+ *
+ * The cache holds part_list, programmers and the default_* settings as
+ * they are after reading a given sequence of config files. It is keyed
+ * by the real path, modification time and size of each of these files
+ * as well as by the avrdude version and the sizes of the structures
+ * stored, so a cache written by a different build or for other files is
+ * simply ignored. Parts, memories and opcodes are stored as raw structs
+ * followed by their strings and sub-structures; pointers are rebuilt on
+ * loading. Programmers are stored field by field with their type id in
+ * place of the initpgm() pointer. Comments are not cached, so callers
+ * must parse the config files themselves for developer options.
+ *
+ * An index at the end of the cache lists the ids and file offsets of all
+ * entries, so that a reader can materialise only the part and programmers
+ * it needs; complete_config() loads the others when they are needed.
+ */
+
+#define CC_MAGIC "avrdude config cache 2"
+
+typedef struct {                // Index entry of the cache
+  long long off;                // File offset of the entry
+  void *obj;                    // AVRPART or PROGRAMMER once loaded
+} CC_ENTRY;
+
+static struct {                 // Cache of a lazy read_config_cache()
+  unsigned char *map;
+  size_t len;
+  int nparts, npgms;
+  CC_ENTRY *parts, *pgms;
+} cc_lazy;
+
+typedef struct {                // Cache reader
+  const unsigned char *p, *end;
+  int err;
+} CC_READER;
+
+static void cc_put(FILE *f, const void *v, size_t n) {
+  fwrite(v, 1, n, f);
+}
+
+static void cc_putint(FILE *f, int i) {
+  cc_put(f, &i, sizeof i);
+}
+
+static void cc_putstr(FILE *f, const char *s) {
+  int n = s? (int) strlen(s): -1;
+
+  cc_putint(f, n);
+  if(n > 0)
+    cc_put(f, s, n);
+}
+
+static void cc_get(CC_READER *r, void *v, size_t n) {
+  if(r->err || (size_t) (r->end - r->p) < n) {
+    r->err = 1;
+    memset(v, 0, n);
+    return;
+  }
+  memcpy(v, r->p, n);
+  r->p += n;
+}
+
+static int cc_getint(CC_READER *r) {
+  int i;
+
+  cc_get(r, &i, sizeof i);
+  return i;
+}
+
+// Return the next string as cached string, NULL if it was stored as NULL
+static const char *cc_getstr(CC_READER *r) {
+  char buf[1024], *s;
+  const char *ret;
+  int n = cc_getint(r);
+
+  if(n < 0 || r->err)
+    return NULL;
+  if((size_t) (r->end - r->p) < (size_t) n) {
+    r->err = 1;
+    return NULL;
+  }
+  s = n < (int) sizeof buf? buf: cfg_malloc("cc_getstr()", n+1);
+  memcpy(s, r->p, n);
+  s[n] = 0;
+  r->p += n;
+  ret = cache_string(s);
+  if(s != buf)
+    free(s);
+
+  return ret;
+}
+
+// Key of the cache: version, struct sizes and config file stats
+#define CC_NKEYINTS 6
+
+static void cc_keyints(int *ki, const LISTID cfgfiles) {
+  ki[0] = sizeof(AVRPART);
+  ki[1] = sizeof(AVRMEM);
+  ki[2] = sizeof(OPCODE);
+  ki[3] = sizeof(PROGRAMMER);
+  ki[4] = AVR_OP_MAX;
+  ki[5] = lsize(cfgfiles);
+}
+
+// Real path, modification time and size of a config file
+static char *cc_filestat(const char *file, long long *mtime, long long *size) {
+  struct stat sb;
+  char *rp;
+
+  if(!(rp = realpath(file, NULL)))
+    return NULL;
+  if(stat(rp, &sb) < 0) {
+    free(rp);
+    return NULL;
+  }
+  *mtime = sb.st_mtime;
+  *size = sb.st_size;
+
+  return rp;
+}
+
+static int cc_putkey(FILE *f, const LISTID cfgfiles) {
+  int ki[CC_NKEYINTS];
+  long long mtime, size;
+  char *rp;
+
+  cc_putstr(f, CC_MAGIC);
+  cc_putstr(f, VERSION);
+  cc_keyints(ki, cfgfiles);
+  cc_put(f, ki, sizeof ki);
+  for(LNODEID ln = lfirst(cfgfiles); ln; ln = lnext(ln)) {
+    if(!(rp = cc_filestat(ldata(ln), &mtime, &size)))
+      return -1;
+    cc_putstr(f, rp);
+    free(rp);
+    cc_put(f, &mtime, sizeof mtime);
+    cc_put(f, &size, sizeof size);
+  }
+
+  return 0;
+}
+
+// Return 0 if the key at the start of the cache matches cfgfiles, -1 otherwise
+static int cc_checkkey(CC_READER *r, const LISTID cfgfiles) {
+  int ki[CC_NKEYINTS], cki[CC_NKEYINTS];
+  long long mtime, size, cmtime, csize;
+  const char *crp;
+  char *rp;
+
+  if(cc_getstr(r) != cache_string(CC_MAGIC) || cc_getstr(r) != cache_string(VERSION))
+    return -1;
+  cc_keyints(ki, cfgfiles);
+  cc_get(r, cki, sizeof cki);
+  if(r->err || memcmp(ki, cki, sizeof ki))
+    return -1;
+  for(LNODEID ln = lfirst(cfgfiles); ln; ln = lnext(ln)) {
+    if(!(rp = cc_filestat(ldata(ln), &mtime, &size)))
+      return -1;
+    crp = cc_getstr(r);
+    cc_get(r, &cmtime, sizeof cmtime);
+    cc_get(r, &csize, sizeof csize);
+    if(r->err || !crp || strcmp(crp, rp) || cmtime != mtime || csize != size) {
+      free(rp);
+      return -1;
+    }
+    free(rp);
+  }
+
+  return 0;
+}
+
+static void cc_putops(FILE *f, OPCODE * const *op) {
+  for(int i = 0; i < AVR_OP_MAX; i++) {
+    cc_putint(f, !!op[i]);
+    if(op[i])
+      cc_put(f, op[i], sizeof *op[i]);
+  }
+}
+
+static void cc_getops(CC_READER *r, OPCODE **op) {
+  for(int i = 0; i < AVR_OP_MAX; i++) {
+    op[i] = NULL;
+    if(cc_getint(r)) {
+      op[i] = avr_new_opcode();
+      cc_get(r, op[i], sizeof *op[i]);
+    }
+  }
+}
+
+static void cc_putintlist(FILE *f, const LISTID list) {
+  cc_putint(f, list? lsize(list): 0);
+  if(list)
+    for(LNODEID ln = lfirst(list); ln; ln = lnext(ln))
+      cc_putint(f, *(int *) ldata(ln));
+}
+
+static void cc_getintlist(CC_READER *r, LISTID list) {
+  int n = cc_getint(r);
+
+  for(int i = 0; i < n && !r->err; i++) {
+    int *ip = cfg_malloc("cc_getintlist()", sizeof(int));
+    *ip = cc_getint(r);
+    ladd(list, ip);
+  }
+}
+
+static void cc_putpart(FILE *f, const AVRPART *p) {
+  LNODEID ln, ln2;
+  int idx;
+
+  cc_put(f, p, sizeof *p);
+  cc_putstr(f, p->desc);
+  cc_putstr(f, p->id);
+  cc_putstr(f, p->parent_id);
+  cc_putstr(f, p->family_id);
+  cc_putstr(f, p->config_file);
+  cc_putops(f, p->op);
+
+  cc_putint(f, lsize(p->mem));
+  for(ln = lfirst(p->mem); ln; ln = lnext(ln)) {
+    AVRMEM *m = ldata(ln);
+    cc_put(f, m, sizeof *m);
+    cc_putstr(f, m->desc);
+    cc_putops(f, m->op);
+  }
+
+  cc_putint(f, lsize(p->mem_alias));
+  for(ln = lfirst(p->mem_alias); ln; ln = lnext(ln)) {
+    AVRMEM_ALIAS *a = ldata(ln);
+    cc_putstr(f, a->desc);
+    for(idx = 0, ln2 = lfirst(p->mem); ln2 && ldata(ln2) != a->aliased_mem; ln2 = lnext(ln2))
+      idx++;
+    cc_putint(f, ln2? idx: -1);
+  }
+}
+
+static AVRPART *cc_getpart(CC_READER *r) {
+  AVRPART *p = avr_new_part();
+  LISTID mem = p->mem, mem_alias = p->mem_alias;
+  int n;
+
+  cc_get(r, p, sizeof *p);
+  p->mem = mem;
+  p->mem_alias = mem_alias;
+  p->comments = NULL;
+  p->desc = cc_getstr(r);
+  p->id = cc_getstr(r);
+  p->parent_id = cc_getstr(r);
+  p->family_id = cc_getstr(r);
+  p->config_file = cc_getstr(r);
+  cc_getops(r, p->op);
+
+  n = cc_getint(r);
+  for(int i = 0; i < n && !r->err; i++) {
+    AVRMEM *m = avr_new_memtype();
+    cc_get(r, m, sizeof *m);
+    m->comments = NULL;
+    m->buf = m->tags = NULL;
+    m->extents = NULL;
+    m->nextents = m->maxextents = 0;
+    m->dirty = NULL;
+    m->desc = cc_getstr(r);
+    cc_getops(r, m->op);
+    ladd(p->mem, m);
+  }
+
+  n = cc_getint(r);
+  for(int i = 0; i < n && !r->err; i++) {
+    AVRMEM_ALIAS *a = avr_new_memalias();
+    int idx;
+    a->desc = cc_getstr(r);
+    idx = cc_getint(r);
+    a->aliased_mem = idx >= 0 && idx < lsize(p->mem)? lget_n(p->mem, idx+1): NULL;
+    ladd(p->mem_alias, a);
+  }
+
+  if(!p->desc || !p->id || !p->parent_id || !p->family_id || !p->config_file)
+    r->err = 1;
+
+  return p;
+}
+
+static void cc_putpgm(FILE *f, const PROGRAMMER *pgm) {
+  cc_putint(f, lsize(pgm->id));
+  for(LNODEID ln = lfirst(pgm->id); ln; ln = lnext(ln))
+    cc_putstr(f, ldata(ln));
+  cc_putstr(f, pgm->desc);
+  cc_putstr(f, locate_programmer_type_id(pgm->initpgm));
+  cc_putstr(f, pgm->parent_id);
+  cc_putint(f, pgm->prog_modes);
+  cc_put(f, pgm->pin, sizeof pgm->pin);
+  cc_putint(f, pgm->conntype);
+  cc_putint(f, pgm->baudrate);
+  cc_putint(f, pgm->usbvid);
+  cc_putintlist(f, pgm->usbpid);
+  cc_putstr(f, pgm->usbdev);
+  cc_putstr(f, pgm->usbsn);
+  cc_putstr(f, pgm->usbvendor);
+  cc_putstr(f, pgm->usbproduct);
+  cc_putintlist(f, pgm->hvupdi_support);
+  cc_putstr(f, pgm->config_file);
+  cc_putint(f, pgm->lineno);
+}
+
+static PROGRAMMER *cc_getpgm(CC_READER *r) {
+  PROGRAMMER *pgm = pgm_new();
+  const PROGRAMMER_TYPE *type;
+  const char *s;
+  int n;
+
+  n = cc_getint(r);
+  for(int i = 0; i < n && !r->err; i++)
+    if((s = cc_getstr(r)))
+      ladd(pgm->id, cfg_strdup("cc_getpgm()", s));
+  pgm->desc = cc_getstr(r);
+  if((s = cc_getstr(r)) && (type = locate_programmer_type(s)))
+    pgm->initpgm = type->initpgm;
+  pgm->parent_id = cc_getstr(r);
+  pgm->prog_modes = cc_getint(r);
+  cc_get(r, pgm->pin, sizeof pgm->pin);
+  pgm->conntype = cc_getint(r);
+  pgm->baudrate = cc_getint(r);
+  pgm->usbvid = cc_getint(r);
+  cc_getintlist(r, pgm->usbpid);
+  pgm->usbdev = cc_getstr(r);
+  pgm->usbsn = cc_getstr(r);
+  pgm->usbvendor = cc_getstr(r);
+  pgm->usbproduct = cc_getstr(r);
+  cc_getintlist(r, pgm->hvupdi_support);
+  pgm->config_file = cc_getstr(r);
+  pgm->lineno = cc_getint(r);
+
+  if(!pgm->initpgm || !pgm->desc || !pgm->parent_id || !pgm->usbdev || !pgm->usbsn ||
+     !pgm->usbvendor || !pgm->usbproduct || !pgm->config_file)
+    r->err = 1;
+
+  return pgm;
+}
+
+/*
+ * Write the current configuration to cachefile for the list of config
+ * files cfgfiles that it was read from. The file is written under a
+ * temporary name and renamed, so concurrent invocations never see a
+ * partial cache. Returns 0 on success and -1 otherwise.
+ */
+int write_config_cache(const char *cachefile, const LISTID cfgfiles) {
+  char *tmp;
+  FILE *f;
+  double bitclock = default_bitclock;
+  long long *offs = NULL, idxoff;
+  int ok, i, n;
+  LNODEID ln;
+
+  tmp = cfg_malloc("write_config_cache()", strlen(cachefile) + 32);
+#if !defined(WIN32)
+  sprintf(tmp, "%s.%lu", cachefile, (unsigned long) getpid());
+#else
+  sprintf(tmp, "%s.tmp", cachefile);
+#endif
+
+  if(!(f = fopen(tmp, "wb"))) {
+    avrdude_message(MSG_NOTICE2, "%s: cannot write config cache \"%s\": %s\n",
+      progname, tmp, strerror(errno));
+    free(tmp);
+    return -1;
+  }
+
+  ok = cc_putkey(f, cfgfiles) == 0;
+  if(ok) {
+    cc_putstr(f, default_programmer);
+    cc_putstr(f, default_parallel);
+    cc_putstr(f, default_serial);
+    cc_putstr(f, default_spi);
+    cc_put(f, &bitclock, sizeof bitclock);
+
+    offs = cfg_malloc("write_config_cache()", (lsize(part_list) + lsize(programmers) + 1)*sizeof*offs);
+    for(n = 0, ln = lfirst(part_list); ln; ln = lnext(ln)) {
+      offs[n++] = ftell(f);
+      cc_putpart(f, ldata(ln));
+    }
+    for(ln = lfirst(programmers); ln; ln = lnext(ln)) {
+      offs[n++] = ftell(f);
+      cc_putpgm(f, ldata(ln));
+    }
+
+    // Index: ids and offsets of parts and programmers
+    idxoff = ftell(f);
+    cc_putint(f, lsize(part_list));
+    for(i = 0, ln = lfirst(part_list); ln; ln = lnext(ln), i++) {
+      AVRPART *p = ldata(ln);
+      cc_putstr(f, p->id);
+      cc_putstr(f, p->desc);
+      cc_put(f, offs+i, sizeof*offs);
+    }
+    cc_putint(f, lsize(programmers));
+    for(ln = lfirst(programmers); ln; ln = lnext(ln), i++) {
+      PROGRAMMER *pgm = ldata(ln);
+      cc_putint(f, lsize(pgm->id));
+      for(LNODEID ln2 = lfirst(pgm->id); ln2; ln2 = lnext(ln2))
+        cc_putstr(f, ldata(ln2));
+      cc_put(f, offs+i, sizeof*offs);
+    }
+    cc_put(f, &idxoff, sizeof idxoff);
+    cc_putstr(f, CC_MAGIC);
+    free(offs);
+  }
+
+  ok = !ferror(f) && !fclose(f) && ok;
+  if(ok && rename(tmp, cachefile) < 0)
+    ok = 0;
+  if(!ok) {
+    avrdude_message(MSG_NOTICE2, "%s: cannot write config cache \"%s\"\n", progname, cachefile);
+    remove(tmp);
+  }
+  free(tmp);
+
+  return ok? 0: -1;
+}
+
+static void cc_unmap(unsigned char *map, size_t len) {
+  if(map)
+#if !defined(WIN32)
+    munmap(map, len);
+#else
+    free(map);
+#endif
+}
+
+static void cc_lazy_free(void) {
+  cc_unmap(cc_lazy.map, cc_lazy.len);
+  free(cc_lazy.parts);
+  free(cc_lazy.pgms);
+  memset(&cc_lazy, 0, sizeof cc_lazy);
+}
+
+// Materialise entry e of the lazy cache; exits if the cache is corrupt
+static void *cc_lazy_load(CC_ENTRY *e, int ispart) {
+  CC_READER r;
+
+  if(!e->obj) {
+    r.p = cc_lazy.map + e->off;
+    r.end = cc_lazy.map + cc_lazy.len;
+    r.err = 0;
+    cfg_arena_begin();
+    e->obj = ispart? (void *) cc_getpart(&r): (void *) cc_getpgm(&r);
+    cfg_arena_end();
+    if(r.err) {
+      avrdude_message(MSG_INFO, "%s: config cache is corrupt, remove it and try again\n", progname);
+      exit(1);
+    }
+  }
+
+  return e->obj;
+}
+
+/*
+ * Replace the current configuration with that of cachefile if the cache
+ * is valid for the list of config files cfgfiles. Returns 0 if the
+ * configuration was loaded from the cache and -1 if it is missing or
+ * stale, in which case the configuration is left unchanged.
+ *
+ * If partdesc is not NULL only the parts with that id or description are
+ * loaded into part_list, and if pgmids is not NULL only the programmers
+ * with one of the ids in that list are loaded into programmers. The
+ * cache then stays mapped, and complete_config() loads the other
+ * entries on demand.
+ */
+int read_config_cache(const char *cachefile, const LISTID cfgfiles, const char *partdesc,
+  const LISTID pgmids) {
+
+  unsigned char *map = NULL;
+  size_t len = 0, taillen = sizeof(int) + strlen(CC_MAGIC);
+  struct stat sb;
+  CC_READER r, ir;
+  LISTID parts, pgms;
+  const char *dflt[4], *s;
+  double bitclock;
+  long long idxoff;
+  CC_ENTRY *pe = NULL, *ge = NULL;
+  int n, np = 0, ng = 0, rc = -1;
+
+  if(stat(cachefile, &sb) < 0 || (size_t) sb.st_size <= taillen + sizeof idxoff)
+    return -1;
+  len = sb.st_size;
+
+#if !defined(WIN32)
+  {
+    int fd = open(cachefile, O_RDONLY);
+    if(fd < 0)
+      return -1;
+    map = mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(map == MAP_FAILED)
+      return -1;
+  }
+#else
+  {
+    FILE *f = fopen(cachefile, "rb");
+    if(!f)
+      return -1;
+    map = cfg_malloc("read_config_cache()", len);
+    n = fread(map, 1, len, f) == len;
+    fclose(f);
+    if(!n)
+      goto out;
+  }
+#endif
+
+  r.p = map;
+  r.end = map + len;
+  r.err = 0;
+
+  if(cc_checkkey(&r, cfgfiles) < 0) {
+    avrdude_message(MSG_NOTICE2, "%s: config cache \"%s\" is stale\n", progname, cachefile);
+    goto out;
+  }
+
+  // Trailer: index offset and magic
+  ir.p = map + len - taillen - sizeof idxoff;
+  ir.end = map + len;
+  ir.err = 0;
+  cc_get(&ir, &idxoff, sizeof idxoff);
+  if(cc_getstr(&ir) != cache_string(CC_MAGIC) || idxoff < r.p - map || idxoff > (long long) (len - taillen))
+    goto corrupt;
+  ir.p = map + idxoff;
+  ir.end = map + len - taillen - sizeof idxoff;
+
+  for(int i = 0; i < 4; i++)
+    dflt[i] = cc_getstr(&r);
+  cc_get(&r, &bitclock, sizeof bitclock);
+
+  // Read the index and load the entries that are asked for
+  parts = lcreat(NULL, 0);
+  pgms = lcreat(NULL, 0);
+  cfg_arena_begin();
+  np = cc_getint(&ir);
+  if(np < 0 || (size_t) np > len)
+    ir.err = 1;
+  pe = cfg_malloc("read_config_cache()", (np+1)*sizeof*pe);
+  for(int i = 0; i < np && !ir.err; i++) {
+    const char *id = cc_getstr(&ir), *desc = cc_getstr(&ir);
+    cc_get(&ir, &pe[i].off, sizeof pe[i].off);
+    if(!id || !desc || pe[i].off < r.p - map || pe[i].off >= idxoff)
+      ir.err = 1;
+    else if(!partdesc || !strcasecmp(partdesc, id) || !strcasecmp(partdesc, desc)) {
+      r.p = map + pe[i].off;
+      ladd(parts, pe[i].obj = cc_getpart(&r));
+    }
+  }
+  ng = cc_getint(&ir);
+  if(ng < 0 || (size_t) ng > len)
+    ir.err = 1;
+  ge = cfg_malloc("read_config_cache()", (ng+1)*sizeof*ge);
+  for(int i = 0; i < ng && !ir.err; i++) {
+    int want = !pgmids;
+    n = cc_getint(&ir);
+    for(int k = 0; k < n && !ir.err; k++)
+      if((s = cc_getstr(&ir)) && pgmids)
+        for(LNODEID ln = lfirst(pgmids); ln && !want; ln = lnext(ln))
+          want = !strcasecmp(s, ldata(ln));
+    cc_get(&ir, &ge[i].off, sizeof ge[i].off);
+    if(ge[i].off < r.p - map || ge[i].off >= idxoff)
+      ir.err = 1;
+    else if(want) {
+      r.p = map + ge[i].off;
+      ladd(pgms, ge[i].obj = cc_getpgm(&r));
+    }
+  }
+
+  cfg_arena_end();
+  cfg_arena_stats();
+
+  if(r.err || ir.err || ir.p != ir.end) {
+    ldestroy_cb(parts, (void(*)(void*))avr_free_part);
+    ldestroy_cb(pgms, (void(*)(void*))pgm_free);
+    goto corrupt;
+  }
+
+  avr_index_parts(NULL);
+  pgm_index_programmers(NULL);
+  ldestroy_cb(part_list, (void(*)(void*))avr_free_part);
+  ldestroy_cb(programmers, (void(*)(void*))pgm_free);
+  part_list = parts;
+  programmers = pgms;
+  if(dflt[0])
+    default_programmer = dflt[0];
+  if(dflt[1])
+    default_parallel = dflt[1];
+  if(dflt[2])
+    default_serial = dflt[2];
+  if(dflt[3])
+    default_spi = dflt[3];
+  default_bitclock = bitclock;
+
+  cc_lazy_free();
+  if(partdesc || pgmids) {      // Keep the cache for complete_config()
+    cc_lazy.map = map;
+    cc_lazy.len = len;
+    cc_lazy.nparts = np;
+    cc_lazy.npgms = ng;
+    cc_lazy.parts = pe;
+    cc_lazy.pgms = ge;
+    map = NULL;
+    pe = ge = NULL;
+  }
+  rc = 0;
+  goto out;
+
+corrupt:
+  avrdude_message(MSG_NOTICE2, "%s: config cache \"%s\" is corrupt\n", progname, cachefile);
+
+out:
+  cc_unmap(map, len);
+  free(pe);
+  free(ge);
+
+  return rc;
+}
+
+/*
+ * Load all parts and programmers that a read_config_cache() for selected
+ * entries left out. The lists part_list and programmers keep their
+ * identity and the entries already loaded; they are refilled in the order
+ * of the config files, and hash indexes of the lists are rebuilt.
+ */
+void complete_config(void) {
+  if(!cc_lazy.map)
+    return;
+
+  avr_index_parts(NULL);
+  pgm_index_programmers(NULL);
+
+  while(lrmv(part_list))
+    continue;
+  for(int i = 0; i < cc_lazy.nparts; i++)
+    ladd(part_list, cc_lazy_load(cc_lazy.parts+i, 1));
+  while(lrmv(programmers))
+    continue;
+  for(int i = 0; i < cc_lazy.npgms; i++)
+    ladd(programmers, cc_lazy_load(cc_lazy.pgms+i, 0));
+
+  cc_lazy_free();
+  avr_index_parts(part_list);
+  pgm_index_programmers(programmers);
+}
@@ -1772,5 +1772,8 @@ static int parse_cmdbits(OPCODE * op, int opnum)
   if(bitno > 0)
     yywarning("too few opcode bits in instruction");
 
+  if(rv == 0)
+    avr_compile_opcode(op);
+
   return rv;
 }
@@ -435,6 +435,10 @@ static int avrmem_deep_copy(AVRMEMdeep *d, const AVRMEM *m) {
   d->base.comments = NULL;
   d->base.buf = NULL;
   d->base.tags = NULL;
+  d->base.extents = NULL;
+  d->base.nextents = 0;
+  d->base.maxextents = 0;
+  d->base.dirty = NULL;
   d->base.desc = NULL;
   for(int i=0; i<AVR_OP_MAX; i++)
     d->base.op[i] = NULL;
@@ -351,10 +351,9 @@ static int ihex2b(char * infile, FILE * inf,
                           progname, nextaddr+ihex.reclen, lineno, infile);
           return -1;
         }
-        for (i=0; i<ihex.reclen; i++) {
+        for (i=0; i<ihex.reclen; i++)
           mem->buf[nextaddr+i] = ihex.data[i];
-          mem->tags[nextaddr+i] = TAG_ALLOCATED;
-        }
+        avr_mem_set_allocated(mem, nextaddr, ihex.reclen);
         if (nextaddr+ihex.reclen > maxaddr)
           maxaddr = nextaddr+ihex.reclen;
         break;
@@ -691,10 +690,9 @@ static int srec2b(char * infile, FILE * inf,
                 lineno, infile);
         return -1;
       }
-      for (i=0; i<srec.reclen; i++) {
+      for (i=0; i<srec.reclen; i++)
         mem->buf[nextaddr+i] = srec.data[i];
-        mem->tags[nextaddr+i] = TAG_ALLOCATED;
-      }
+      avr_mem_set_allocated(mem, nextaddr, srec.reclen);
       if (nextaddr+srec.reclen > maxaddr)
         maxaddr = nextaddr+srec.reclen;
       reccount++;      
@@ -1028,7 +1026,7 @@ static int elf2b(char * infile, FILE * inf,
             avrdude_message(MSG_NOTICE2, "    Extracting one byte from file offset %d\n",
                             foff);
             mem->buf[0] = ((unsigned char *)d->d_buf)[foff];
-            mem->tags[0] = TAG_ALLOCATED;
+            avr_mem_set_allocated(mem, 0, 1);
             rv = 1;
           }
         } else {
@@ -1040,7 +1038,7 @@ static int elf2b(char * infile, FILE * inf,
           avrdude_message(MSG_DEBUG, "    Writing %d bytes to mem offset 0x%x\n",
                           d->d_size, idx);
           memcpy(mem->buf + idx, d->d_buf, d->d_size);
-          memset(mem->tags + idx, TAG_ALLOCATED, d->d_size);
+          avr_mem_set_allocated(mem, idx, d->d_size);
         }
       }
     }
@@ -1101,7 +1099,7 @@ static int fileio_rbin(struct fioparms * fio,
     case FIO_READ:
       rc = fread(buf, 1, size, f);
       if (rc > 0)
-        memset(mem->tags, TAG_ALLOCATED, rc);
+        avr_mem_set_allocated(mem, 0, rc);
       break;
     case FIO_WRITE:
       rc = fwrite(buf, 1, size, f);
@@ -1147,7 +1145,7 @@ static int fileio_imm(struct fioparms * fio,
           return -1;
         }
         mem->buf[loc] = b;
-        mem->tags[loc++] = TAG_ALLOCATED;
+        avr_mem_set_allocated(mem, loc++, 1);
         p = strtok(NULL, " ,");
         rc = loc;
       }
@@ -1505,7 +1503,7 @@ int fileio(int oprwv, char * filename, FILEFMT format,
     /* 0xff fill unspecified memory */
     memset(mem->buf, 0xff, size);
   }
-  memset(mem->tags, 0, size);
+  avr_mem_clear_allocated(mem);
 
   using_stdio = 0;
 
@@ -110,7 +110,6 @@ void ft245r_initpgm(PROGRAMMER *pgm) {
 #define FT245R_CYCLES          2
 #define FT245R_CMD_SIZE       (4 * 8*FT245R_CYCLES)
 #define FT245R_FRAGMENT_SIZE  (8 * FT245R_CMD_SIZE)
-#define REQ_OUTSTANDINGS      10
 
 #define FT245R_DEBUG	0
 /*
@@ -126,32 +125,70 @@ void ft245r_initpgm(PROGRAMMER *pgm) {
 */
 #define FT245R_BITBANG_VARIABLE_PULSE_WIDTH_WORKAROUND 0
 
-static struct ftdi_context *handle;
+#define FT245R_BUFSIZE		0x10000	// receive buffer size
+#define FT245R_MIN_FIFO_SIZE	128	// min of FTDI RX/TX FIFO size
 
-#if FT245R_BITBANG_VARIABLE_PULSE_WIDTH_WORKAROUND
-static unsigned int baud_multiplier;
+/*
+  With libftdi1 the read of the synchronous bitbang echo is submitted
+  before the write, so the host keeps draining the RX FIFO while the
+  TX FIFO is being fed; a transfer can then be much longer than the
+  chip FIFOs.  Older libftdi can only write what fits into the RX FIFO
+  before reading it back.
+*/
+#if defined(HAVE_LIBFTDI1) && defined(HAVE_LIBUSB_1_0)
+#define FT245R_ASYNC		1
+#define FT245R_XFER_SIZE	4096	// transmit buffer size, bytes per USB transfer
 #else
-# define baud_multiplier 1		// this let's C compiler optimize
+#define FT245R_ASYNC		0
+#define FT245R_XFER_SIZE	FT245R_MIN_FIFO_SIZE
 #endif
-static unsigned char ft245r_ddr;
-static unsigned char ft245r_out;
 
-#define FT245R_BUFSIZE		0x2000	// receive buffer size
-#define FT245R_MIN_FIFO_SIZE	128	// min of FTDI RX/TX FIFO size
+struct ft245r_request {
+    int addr;
+    int bytes;
+    int n;
+    struct ft245r_request *next;
+};
+
+/*
+ * Private data for this programmer
+ */
+struct pdata {
+    struct ftdi_context *handle;
+#if FT245R_BITBANG_VARIABLE_PULSE_WIDTH_WORKAROUND
+    unsigned int baud_multiplier;
+#endif
+    unsigned char ddr;
+    unsigned char out;
+    int req_depth;			// max # of outstanding paged requests
+
+    struct {
+	int len;				// # of bytes in transmit buffer
+	uint8_t buf[FT245R_XFER_SIZE];		// transmit buffer
+    } tx;
+
+    struct {
+	int discard;	// # of bytes to discard during read
+	int pending;	// # of bytes that have been written since last read
+	int len;	// # of bytes in receive buffer
+	int wr;		// write pointer
+	int rd;		// read pointer
+	uint8_t buf[FT245R_BUFSIZE];	// receive ring buffer
+#if FT245R_ASYNC
+	uint8_t xfer[FT245R_XFER_SIZE];	// landing area of one read transfer
+#endif
+    } rx;
 
-static struct {
-    int len;				// # of bytes in transmit buffer
-    uint8_t buf[FT245R_MIN_FIFO_SIZE];	// transmit buffer
-} tx;
+    struct ft245r_request *req_head, *req_tail, *req_pool;
+};
 
-static struct {
-    int discard;	// # of bytes to discard during read
-    int pending;	// # of bytes that have been written since last read
-    int len;	// # of bytes in receive buffer
-    int wr;		// write pointer
-    int rd;		// read pointer
-    uint8_t buf[FT245R_BUFSIZE];	// receive ring buffer
-} rx;
+#define PDATA(pgm) ((struct pdata *)(pgm->cookie))
+
+#if FT245R_BITBANG_VARIABLE_PULSE_WIDTH_WORKAROUND
+# define baud_multiplier (PDATA(pgm)->baud_multiplier)
+#else
+# define baud_multiplier 1		// this let's C compiler optimize
+#endif
 
 static int ft245r_cmd(const PROGRAMMER *pgm, const unsigned char *cmd,
                       unsigned char *res);
@@ -160,22 +197,22 @@ static int ft245r_tpi_rx(const PROGRAMMER *pgm, uint8_t *bytep);
 
 // Discard all data from the receive buffer.
 static void ft245r_rx_buf_purge(const PROGRAMMER *pgm) {
-    rx.len = 0;
-    rx.rd = rx.wr = 0;
+    PDATA(pgm)->rx.len = 0;
+    PDATA(pgm)->rx.rd = PDATA(pgm)->rx.wr = 0;
 }
 
 static void ft245r_rx_buf_put(const PROGRAMMER *pgm, uint8_t byte) {
-    rx.len++;
-    rx.buf[rx.wr++] = byte;
-    if (rx.wr >= sizeof(rx.buf))
-	rx.wr = 0;
+    PDATA(pgm)->rx.len++;
+    PDATA(pgm)->rx.buf[PDATA(pgm)->rx.wr++] = byte;
+    if (PDATA(pgm)->rx.wr >= sizeof(PDATA(pgm)->rx.buf))
+	PDATA(pgm)->rx.wr = 0;
 }
 
 static uint8_t ft245r_rx_buf_get(const PROGRAMMER *pgm) {
-    rx.len--;
-    uint8_t byte = rx.buf[rx.rd++];
-    if (rx.rd >= sizeof(rx.buf))
-	rx.rd = 0;
+    PDATA(pgm)->rx.len--;
+    uint8_t byte = PDATA(pgm)->rx.buf[PDATA(pgm)->rx.rd++];
+    if (PDATA(pgm)->rx.rd >= sizeof(PDATA(pgm)->rx.buf))
+	PDATA(pgm)->rx.rd = 0;
     return byte;
 }
 
@@ -184,13 +221,13 @@ static int ft245r_fill(const PROGRAMMER *pgm) {
     uint8_t raw[FT245R_MIN_FIFO_SIZE];
     int i, nread;
 
-    nread = ftdi_read_data(handle, raw, rx.pending);
+    nread = ftdi_read_data(PDATA(pgm)->handle, raw, PDATA(pgm)->rx.pending);
     if (nread < 0)
 	return -1;
-    rx.pending -= nread;
+    PDATA(pgm)->rx.pending -= nread;
 #if FT245R_DEBUG
     avrdude_message(MSG_INFO, "%s: read %d bytes (pending=%d)\n",
-		    __func__, nread, rx.pending);
+		    __func__, nread, PDATA(pgm)->rx.pending);
 #endif
     for (i = 0; i < nread; ++i)
 	ft245r_rx_buf_put(pgm, raw[i]);
@@ -198,34 +235,91 @@ static int ft245r_fill(const PROGRAMMER *pgm) {
 }
 
 static int ft245r_rx_buf_fill_and_get(const PROGRAMMER *pgm) {
-    while (rx.len == 0)
+    while (PDATA(pgm)->rx.len == 0)
     {
         int result = ft245r_fill(pgm);
         if (result < 0)
         {
             return result;
         }
+        if (result == 0 && PDATA(pgm)->rx.pending == 0)
+        {
+            return -1;      // nothing left that could arrive
+        }
     }
 
     return ft245r_rx_buf_get(pgm);
 }
 
+#if FT245R_ASYNC
+/*
+ * Flush pending TX data: submit the read of the echoed bytes first,
+ * then the write, and wait for both
+ */
+static int ft245r_flush(const PROGRAMMER *pgm) {
+    struct ftdi_transfer_control *rtc, *wtc;
+    int i, rv, len = PDATA(pgm)->tx.len;
+
+    if (!len)
+	return 0;
+    PDATA(pgm)->tx.len = 0;	// dropped on error, never overrun
+
+#if FT245R_DEBUG
+    avrdude_message(MSG_INFO, "%s: writing %d bytes\n", __func__, len);
+#endif
+    rtc = ftdi_read_data_submit(PDATA(pgm)->handle, PDATA(pgm)->rx.xfer, len);
+    if (!rtc) {
+	avrdude_message(MSG_INFO, "%s: read submit failed: %s\n",
+			__func__, ftdi_get_error_string(PDATA(pgm)->handle));
+	return -1;
+    }
+    wtc = ftdi_write_data_submit(PDATA(pgm)->handle, PDATA(pgm)->tx.buf, len);
+    if (!wtc) {
+	avrdude_message(MSG_INFO, "%s: write submit failed: %s\n",
+			__func__, ftdi_get_error_string(PDATA(pgm)->handle));
+	ftdi_transfer_data_done(rtc); // times out and releases the read
+	return -1;
+    }
+
+    rv = ftdi_transfer_data_done(wtc);
+    if (rv != len) {
+	avrdude_message(MSG_INFO,
+			"%s: write returned %d (expected %d): %s\n",
+			__func__, rv, len, ftdi_get_error_string(PDATA(pgm)->handle));
+	ftdi_transfer_data_done(rtc);
+	return -1;
+    }
+    rv = ftdi_transfer_data_done(rtc);
+    if (rv != len) {
+	avrdude_message(MSG_INFO,
+			"%s: read returned %d (expected %d): %s\n",
+			__func__, rv, len, ftdi_get_error_string(PDATA(pgm)->handle));
+	return -1;
+    }
+
+    for (i = 0; i < len; ++i)
+	ft245r_rx_buf_put(pgm, PDATA(pgm)->rx.xfer[i]);
+    return 0;
+}
+
+#else
+
 /* Flush pending TX data to the FTDI send FIFO.  */
 static int ft245r_flush(const PROGRAMMER *pgm) {
-    int rv, len = tx.len, avail;
-    uint8_t *src = tx.buf;
+    int rv, len = PDATA(pgm)->tx.len, avail;
+    uint8_t *src = PDATA(pgm)->tx.buf;
 
     if (!len)
 	return 0;
 
     while (len > 0) {
-	avail = FT245R_MIN_FIFO_SIZE - rx.pending;
+	avail = FT245R_MIN_FIFO_SIZE - PDATA(pgm)->rx.pending;
 	if (avail <= 0) {
 	    avail = ft245r_fill(pgm);
 	    if (avail < 0) {
 		avrdude_message(MSG_INFO,
 				"%s: fill returned %d: %s\n",
-				__func__, avail, ftdi_get_error_string(handle));
+				__func__, avail, ftdi_get_error_string(PDATA(pgm)->handle));
 		return -1;
 	    }
 	}
@@ -235,20 +329,21 @@ static int ft245r_flush(const PROGRAMMER *pgm) {
 #if FT245R_DEBUG
 	avrdude_message(MSG_INFO, "%s: writing %d bytes\n", __func__, avail);
 #endif
-	rv = ftdi_write_data(handle, src, avail);
+	rv = ftdi_write_data(PDATA(pgm)->handle, src, avail);
 	if (rv != avail) {
 	    avrdude_message(MSG_INFO,
 			    "%s: write returned %d (expected %d): %s\n",
-			    __func__, rv, avail, ftdi_get_error_string(handle));
+			    __func__, rv, avail, ftdi_get_error_string(PDATA(pgm)->handle));
 	    return -1;
 	}
 	src += avail;
 	len -= avail;
-	rx.pending += avail;
+	PDATA(pgm)->rx.pending += avail;
     }
-    tx.len = 0;
+    PDATA(pgm)->tx.len = 0;
     return 0;
 }
+#endif
 
 static int ft245r_send2(const PROGRAMMER *pgm, unsigned char *buf, size_t len,
 			bool discard_rx_data) {
@@ -257,9 +352,9 @@ static int ft245r_send2(const PROGRAMMER *pgm, unsigned char *buf, size_t len,
     for (i = 0; i < len; ++i) {
 	for (j = 0; j < baud_multiplier; ++j) {
 	    if (discard_rx_data)
-		++rx.discard;
-	    tx.buf[tx.len++] = buf[i];
-	    if (tx.len >= FT245R_MIN_FIFO_SIZE)
+		++PDATA(pgm)->rx.discard;
+	    PDATA(pgm)->tx.buf[PDATA(pgm)->tx.len++] = buf[i];
+	    if (PDATA(pgm)->tx.len >= FT245R_XFER_SIZE)
 		ft245r_flush(pgm);
 	}
     }
@@ -283,16 +378,16 @@ static int ft245r_recv(const PROGRAMMER *pgm, unsigned char *buf, size_t len) {
 
 #if FT245R_DEBUG
     avrdude_message(MSG_INFO, "%s: discarding %d, consuming %zu bytes\n",
-        __func__, rx.discard, len);
+        __func__, PDATA(pgm)->rx.discard, len);
 #endif
-    while (rx.discard > 0) {
+    while (PDATA(pgm)->rx.discard > 0) {
         int result = ft245r_rx_buf_fill_and_get(pgm);
         if (result < 0)
         {
             return result;
         }
 
-        --rx.discard;
+        --PDATA(pgm)->rx.discard;
     }
 
     for (i = 0; i < len; ++i)
@@ -321,9 +416,9 @@ static int ft245r_drain(const PROGRAMMER *pgm, int display) {
     int r;
 
     // flush the buffer in the chip by changing the mode.....
-    r = ftdi_set_bitmode(handle, 0, BITMODE_RESET); 	// reset
+    r = ftdi_set_bitmode(PDATA(pgm)->handle, 0, BITMODE_RESET); 	// reset
     if (r) return -1;
-    r = ftdi_set_bitmode(handle, ft245r_ddr, BITMODE_SYNCBB); // set Synchronuse BitBang
+    r = ftdi_set_bitmode(PDATA(pgm)->handle, PDATA(pgm)->ddr, BITMODE_SYNCBB); // set Synchronuse BitBang
     if (r) return -1;
 
     // drain our buffer.
@@ -381,14 +476,22 @@ static int ft245r_set_bitclock(const PROGRAMMER *pgm) {
     ftdi_rate = rate;
 #endif
 
+    /*
+     * The receive ring buffer must hold the echo of every outstanding
+     * paged request; keep half of it in reserve for discarded bytes
+     */
+    PDATA(pgm)->req_depth = FT245R_BUFSIZE/2 / ((FT245R_FRAGMENT_SIZE+1) * baud_multiplier);
+    if (PDATA(pgm)->req_depth < 1)
+	PDATA(pgm)->req_depth = 1;
+
     avrdude_message(MSG_NOTICE2,
-		    "%s: bitclk %d -> FTDI rate %d, baud multiplier %d\n",
-		    __func__, rate, ftdi_rate, baud_multiplier);
+		    "%s: bitclk %d -> FTDI rate %d, baud multiplier %d, %d requests in flight\n",
+		    __func__, rate, ftdi_rate, baud_multiplier, PDATA(pgm)->req_depth);
 
-    r = ftdi_set_baudrate(handle, ftdi_rate);
+    r = ftdi_set_baudrate(PDATA(pgm)->handle, ftdi_rate);
     if (r) {
         avrdude_message(MSG_INFO, "Set baudrate (%d) failed with error '%s'.\n",
-                rate, ftdi_get_error_string (handle));
+                rate, ftdi_get_error_string (PDATA(pgm)->handle));
         return -1;
     }
     return 0;
@@ -399,7 +502,7 @@ static int get_pin(const PROGRAMMER *pgm, int pinname) {
 
   ft245r_flush(pgm);
 
-  if (ftdi_read_pins(handle, &byte) != 0)
+  if (ftdi_read_pins(PDATA(pgm)->handle, &byte) != 0)
     return -1;
   if (FT245R_DEBUG)
     avrdude_message(MSG_INFO, "%s: in 0x%02x\n", __func__, byte);
@@ -414,8 +517,8 @@ static int set_pin(const PROGRAMMER *pgm, int pinname, int val) {
         return 0;
     }
 
-    ft245r_out = SET_BITS_0(ft245r_out,pgm,pinname,val);
-    buf[0] = ft245r_out;
+    PDATA(pgm)->out = SET_BITS_0(PDATA(pgm)->out,pgm,pinname,val);
+    buf[0] = PDATA(pgm)->out;
 
     ft245r_send_and_discard(pgm, buf, 1);
     return 0;
@@ -615,13 +718,13 @@ static int ft245r_initialize(const PROGRAMMER *pgm, const AVRPART *p) {
 
 static inline void add_bit(const PROGRAMMER *pgm, unsigned char *buf, int *buf_pos,
 			   uint8_t bit) {
-    ft245r_out = SET_BITS_0(ft245r_out,pgm,PIN_AVR_MOSI, bit);
-    ft245r_out = SET_BITS_0(ft245r_out,pgm,PIN_AVR_SCK,0);
-    buf[*buf_pos] = ft245r_out;
+    PDATA(pgm)->out = SET_BITS_0(PDATA(pgm)->out,pgm,PIN_AVR_MOSI, bit);
+    PDATA(pgm)->out = SET_BITS_0(PDATA(pgm)->out,pgm,PIN_AVR_SCK,0);
+    buf[*buf_pos] = PDATA(pgm)->out;
     (*buf_pos)++;
 
-    ft245r_out = SET_BITS_0(ft245r_out,pgm,PIN_AVR_SCK,1);
-    buf[*buf_pos] = ft245r_out;
+    PDATA(pgm)->out = SET_BITS_0(PDATA(pgm)->out,pgm,PIN_AVR_SCK,1);
+    buf[*buf_pos] = PDATA(pgm)->out;
     (*buf_pos)++;
 }
 
@@ -886,8 +989,8 @@ static int ft245r_open(PROGRAMMER *pgm, const char *port) {
       return -1;
     }
 
-    handle = malloc (sizeof (struct ftdi_context));
-    ftdi_init(handle);
+    PDATA(pgm)->handle = malloc (sizeof (struct ftdi_context));
+    ftdi_init(PDATA(pgm)->handle);
     LNODEID usbpid = lfirst(pgm->usbpid);
     int pid;
     if (usbpid) {
@@ -898,7 +1001,7 @@ static int ft245r_open(PROGRAMMER *pgm, const char *port) {
     } else {
       pid = USB_DEVICE_FT245;
     }
-    rv = ftdi_usb_open_desc_index(handle,
+    rv = ftdi_usb_open_desc_index(PDATA(pgm)->handle,
                                   pgm->usbvid?pgm->usbvid:USB_VENDOR_FTDI,
                                   pid,
                                   pgm->usbproduct[0]?pgm->usbproduct:NULL,
@@ -906,11 +1009,11 @@ static int ft245r_open(PROGRAMMER *pgm, const char *port) {
                                   devnum);
     if (rv) {
         avrdude_message(MSG_INFO, "%s: can't open ftdi device: %s\n",
-                        progname, ftdi_get_error_string(handle));
+                        progname, ftdi_get_error_string(PDATA(pgm)->handle));
         goto cleanup_no_usb;
     }
 
-    ft245r_ddr = 
+    PDATA(pgm)->ddr = 
          pgm->pin[PIN_AVR_SCK].mask[0]
        | pgm->pin[PIN_AVR_MOSI].mask[0]
        | pgm->pin[PIN_AVR_RESET].mask[0]
@@ -922,29 +1025,29 @@ static int ft245r_open(PROGRAMMER *pgm, const char *port) {
        | pgm->pin[PIN_LED_VFY].mask[0];
 
     /* set initial values for outputs, no reset everything else is off */
-    ft245r_out = 0;
-    ft245r_out = SET_BITS_0(ft245r_out,pgm,PIN_AVR_RESET,1);
-    ft245r_out = SET_BITS_0(ft245r_out,pgm,PIN_AVR_SCK,0);
-    ft245r_out = SET_BITS_0(ft245r_out,pgm,PIN_AVR_MOSI,0);
-    ft245r_out = SET_BITS_0(ft245r_out,pgm,PPI_AVR_BUFF,0);
-    ft245r_out = SET_BITS_0(ft245r_out,pgm,PPI_AVR_VCC,0);
-    ft245r_out = SET_BITS_0(ft245r_out,pgm,PIN_LED_ERR,0);
-    ft245r_out = SET_BITS_0(ft245r_out,pgm,PIN_LED_RDY,0);
-    ft245r_out = SET_BITS_0(ft245r_out,pgm,PIN_LED_PGM,0);
-    ft245r_out = SET_BITS_0(ft245r_out,pgm,PIN_LED_VFY,0);
-
-
-    rv = ftdi_set_latency_timer(handle, 1);
+    PDATA(pgm)->out = 0;
+    PDATA(pgm)->out = SET_BITS_0(PDATA(pgm)->out,pgm,PIN_AVR_RESET,1);
+    PDATA(pgm)->out = SET_BITS_0(PDATA(pgm)->out,pgm,PIN_AVR_SCK,0);
+    PDATA(pgm)->out = SET_BITS_0(PDATA(pgm)->out,pgm,PIN_AVR_MOSI,0);
+    PDATA(pgm)->out = SET_BITS_0(PDATA(pgm)->out,pgm,PPI_AVR_BUFF,0);
+    PDATA(pgm)->out = SET_BITS_0(PDATA(pgm)->out,pgm,PPI_AVR_VCC,0);
+    PDATA(pgm)->out = SET_BITS_0(PDATA(pgm)->out,pgm,PIN_LED_ERR,0);
+    PDATA(pgm)->out = SET_BITS_0(PDATA(pgm)->out,pgm,PIN_LED_RDY,0);
+    PDATA(pgm)->out = SET_BITS_0(PDATA(pgm)->out,pgm,PIN_LED_PGM,0);
+    PDATA(pgm)->out = SET_BITS_0(PDATA(pgm)->out,pgm,PIN_LED_VFY,0);
+
+
+    rv = ftdi_set_latency_timer(PDATA(pgm)->handle, 1);
     if (rv) {
         avrdude_message(MSG_INFO, "%s: unable to set latency timer to 1 (%s)\n",
-                        progname, ftdi_get_error_string(handle));
+                        progname, ftdi_get_error_string(PDATA(pgm)->handle));
         goto cleanup;
     }
 
-    rv = ftdi_set_bitmode(handle, ft245r_ddr, BITMODE_SYNCBB); // set Synchronous BitBang
+    rv = ftdi_set_bitmode(PDATA(pgm)->handle, PDATA(pgm)->ddr, BITMODE_SYNCBB); // set Synchronous BitBang
     if (rv) {
         avrdude_message(MSG_INFO, "%s: Synchronous BitBangMode is not supported (%s)\n",
-                        progname, ftdi_get_error_string(handle));
+                        progname, ftdi_get_error_string(PDATA(pgm)->handle));
         goto cleanup;
     }
 
@@ -958,32 +1061,47 @@ static int ft245r_open(PROGRAMMER *pgm, const char *port) {
      */
     ft245r_drain (pgm, 0);
 
-    ft245r_send_and_discard(pgm, &ft245r_out, 1);
+    ft245r_send_and_discard(pgm, &PDATA(pgm)->out, 1);
 
     return 0;
 
 cleanup:
-    ftdi_usb_close(handle);
+    ftdi_usb_close(PDATA(pgm)->handle);
 cleanup_no_usb:
-    ftdi_deinit (handle);
-    free(handle);
-    handle = NULL;
+    ftdi_deinit (PDATA(pgm)->handle);
+    free(PDATA(pgm)->handle);
+    PDATA(pgm)->handle = NULL;
     return -1;
 }
 
 
 static void ft245r_close(PROGRAMMER * pgm) {
-    if (handle) {
+    if (PDATA(pgm)->handle) {
         // I think the switch to BB mode and back flushes the buffer.
-        ftdi_set_bitmode(handle, 0, BITMODE_SYNCBB); // set Synchronous BitBang, all in puts
-        ftdi_set_bitmode(handle, 0, BITMODE_RESET); // disable Synchronous BitBang
-        ftdi_usb_close(handle);
-        ftdi_deinit (handle);
-        free(handle);
-        handle = NULL;
+        ftdi_set_bitmode(PDATA(pgm)->handle, 0, BITMODE_SYNCBB); // set Synchronous BitBang, all in puts
+        ftdi_set_bitmode(PDATA(pgm)->handle, 0, BITMODE_RESET); // disable Synchronous BitBang
+        ftdi_usb_close(PDATA(pgm)->handle);
+        ftdi_deinit (PDATA(pgm)->handle);
+        free(PDATA(pgm)->handle);
+        PDATA(pgm)->handle = NULL;
     }
 }
 
+static void ft245r_setup(PROGRAMMER *pgm) {
+    pgm->cookie = cfg_malloc("ft245r_setup()", sizeof(struct pdata));
+}
+
+static void ft245r_teardown(PROGRAMMER *pgm) {
+    struct ft245r_request *p;
+
+    while ((p = PDATA(pgm)->req_pool)) {
+        PDATA(pgm)->req_pool = p->next;
+        free(p);
+    }
+    free(pgm->cookie);
+    pgm->cookie = NULL;
+}
+
 static void ft245r_display(const PROGRAMMER *pgm, const char *p) {
     avrdude_message(MSG_INFO, "%sPin assignment  : 0..7 = DBUS0..7\n",p);/* , 8..11 = GPIO0..3\n",p);*/
     pgm_display_generic_mask(pgm, p, SHOW_ALL_PINS);
@@ -1001,18 +1119,11 @@ static int ft245r_paged_write_gen(const PROGRAMMER *pgm, const AVRPART *p, const
 }
 
 
-static struct ft245r_request {
-    int addr;
-    int bytes;
-    int n;
-    struct ft245r_request *next;
-} *req_head,*req_tail,*req_pool;
-
-static void put_request(int addr, int bytes, int n) {
+static void put_request(const PROGRAMMER *pgm, int addr, int bytes, int n) {
     struct ft245r_request *p;
-    if (req_pool) {
-        p = req_pool;
-        req_pool = p->next;
+    if (PDATA(pgm)->req_pool) {
+        p = PDATA(pgm)->req_pool;
+        PDATA(pgm)->req_pool = p->next;
     } else {
         p = malloc(sizeof(struct ft245r_request));
         if (!p) {
@@ -1024,11 +1135,11 @@ static void put_request(int addr, int bytes, int n) {
     p->addr = addr;
     p->bytes = bytes;
     p->n = n;
-    if (req_tail) {
-        req_tail->next = p;
-        req_tail = p;
+    if (PDATA(pgm)->req_tail) {
+        PDATA(pgm)->req_tail->next = p;
+        PDATA(pgm)->req_tail = p;
     } else {
-        req_head = req_tail = p;
+        PDATA(pgm)->req_head = PDATA(pgm)->req_tail = p;
     }
 }
 
@@ -1037,17 +1148,17 @@ static int do_request(const PROGRAMMER *pgm, const AVRMEM *m) {
     int addr, bytes, j, n;
     unsigned char buf[FT245R_FRAGMENT_SIZE+1+128];
 
-    if (!req_head) return 0;
-    p = req_head;
-    req_head = p->next;
-    if (!req_head) req_tail = req_head;
+    if (!PDATA(pgm)->req_head) return 0;
+    p = PDATA(pgm)->req_head;
+    PDATA(pgm)->req_head = p->next;
+    if (!PDATA(pgm)->req_head) PDATA(pgm)->req_tail = PDATA(pgm)->req_head;
 
     addr = p->addr;
     bytes = p->bytes;
     n = p->n;
     memset(p, 0, sizeof(struct ft245r_request));
-    p->next = req_pool;
-    req_pool = p;
+    p->next = PDATA(pgm)->req_pool;
+    PDATA(pgm)->req_pool = p;
 
     ft245r_recv(pgm, buf, bytes);
     for (j=0; j<n; j++) {
@@ -1090,17 +1201,17 @@ static int ft245r_paged_write_flash(const PROGRAMMER *pgm, const AVRPART *p, con
         // page boundary, finished or buffer exhausted? queue up requests
         if(do_page_write || i >= (int) n_bytes || j >= FT245R_FRAGMENT_SIZE/FT245R_CMD_SIZE) {
             if(i >= n_bytes) {
-                ft245r_out = SET_BITS_0(ft245r_out, pgm, PIN_AVR_SCK, 0); // SCK down
-                buf[buf_pos++] = ft245r_out;
+                PDATA(pgm)->out = SET_BITS_0(PDATA(pgm)->out, pgm, PIN_AVR_SCK, 0); // SCK down
+                buf[buf_pos++] = PDATA(pgm)->out;
             } else {
                 // stretch sequence to allow correct readout, see extract_data()
                 buf[buf_pos] = buf[buf_pos - 1];
                 buf_pos++;
             }
             ft245r_send(pgm, buf, buf_pos);
-            put_request(addr_save, buf_pos, 0);
+            put_request(pgm, addr_save, buf_pos, 0);
 
-            if(++req_count > REQ_OUTSTANDINGS)
+            if(++req_count > PDATA(pgm)->req_depth)
                 do_request(pgm, m);
 
             if(do_page_write) {
@@ -1197,17 +1308,17 @@ static int ft245r_paged_load_flash(const PROGRAMMER *pgm, const AVRPART *p, cons
         // finished or buffer exhausted? queue up requests
         if(i >= (int) n_bytes || j >= FT245R_FRAGMENT_SIZE/FT245R_CMD_SIZE) {
             if(i >= (int) n_bytes) {
-                ft245r_out = SET_BITS_0(ft245r_out, pgm, PIN_AVR_SCK, 0); // SCK down
-                buf[buf_pos++] = ft245r_out;
+                PDATA(pgm)->out = SET_BITS_0(PDATA(pgm)->out, pgm, PIN_AVR_SCK, 0); // SCK down
+                buf[buf_pos++] = PDATA(pgm)->out;
             } else {
                 // stretch sequence to allow correct readout, see extract_data()
                 buf[buf_pos] = buf[buf_pos - 1];
                 buf_pos++;
             }
             ft245r_send(pgm, buf, buf_pos);
-            put_request(addr_save, buf_pos, j);
+            put_request(pgm, addr_save, buf_pos, j);
 
-            if(++req_count > REQ_OUTSTANDINGS)
+            if(++req_count > PDATA(pgm)->req_depth)
                 do_request(pgm, m);
 
             // reset buffer variables
@@ -1268,8 +1379,8 @@ void ft245r_initpgm(PROGRAMMER *pgm) {
     pgm->vfy_led        = set_led_vfy;
     pgm->powerup        = ft245r_powerup;
     pgm->powerdown      = ft245r_powerdown;
-
-    handle = NULL;
+    pgm->setup          = ft245r_setup;
+    pgm->teardown       = ft245r_teardown;
 }
 
 #endif
@@ -76,8 +76,21 @@ struct pdata
 
   /* Function to set the appropriate clock parameter */
   int (*set_sck)(const PROGRAMMER *, unsigned char *);
+
+  /*
+   * EDBG streaming: number of CMSIS-DAP packets the ICE can queue, and
+   * the AVR_CMD status reports not yet collected.  Bit n of
+   * edbg_ackmask is set if the n-th oldest of these acknowledges the
+   * last fragment of a command.
+   */
+  int edbg_window;
+  int edbg_acks;
+  unsigned int edbg_ackmask;
 };
 
+/* Upper limit for edbg_window, given by the width of edbg_ackmask */
+#define EDBG_MAX_WINDOW 16
+
 #define PDATA(pgm) ((struct pdata *)(pgm->cookie))
 
 /*
@@ -119,6 +132,7 @@ void jtag3_setup(PROGRAMMER * pgm)
     exit(1);
   }
   memset(pgm->cookie, 0, sizeof(struct pdata));
+  PDATA(pgm)->edbg_window = 1;
 }
 
 void jtag3_teardown(PROGRAMMER * pgm)
@@ -435,7 +449,7 @@ int jtag3_send(const PROGRAMMER *pgm, unsigned char *data, size_t len) {
   u16_to_b2(buf + 2, PDATA(pgm)->command_sequence);
   memcpy(buf + 4, data, len);
 
-  if (serial_send(&pgm->fd, buf, len + 4) != 0) {
+  if (serial_send(pgm, &pgm->fd, buf, len + 4) != 0) {
     avrdude_message(MSG_INFO, "%s: jtag3_send(): failed to send command to serial port\n",
                     progname);
     free(buf);
@@ -447,17 +461,53 @@ int jtag3_send(const PROGRAMMER *pgm, unsigned char *data, size_t len) {
   return 0;
 }
 
-static int jtag3_edbg_send(const PROGRAMMER *pgm, unsigned char *data, size_t len) {
-  unsigned char buf[USBDEV_MAX_XFER_3];
+/*
+ * Collect outstanding AVR_CMD status reports until no more than keep
+ * of them are left.
+ */
+static int jtag3_edbg_collect(const PROGRAMMER *pgm, int keep) {
   unsigned char status[USBDEV_MAX_XFER_3];
-  int rv;
+  int rv, last;
 
-  if (verbose >= 4)
+  while (PDATA(pgm)->edbg_acks > keep)
     {
-      memset(buf, 0, USBDEV_MAX_XFER_3);
-      memset(status, 0, USBDEV_MAX_XFER_3);
+      last = PDATA(pgm)->edbg_ackmask & 1;
+      PDATA(pgm)->edbg_ackmask >>= 1;
+      PDATA(pgm)->edbg_acks--;
+
+      rv = serial_recv(pgm, &pgm->fd, status, pgm->fd.usb.max_xfer);
+      if (rv < 0) {
+        /* timeout in receive */
+        avrdude_message(MSG_NOTICE2, "%s: jtag3_edbg_collect(): Timeout receiving packet\n",
+                        progname);
+        PDATA(pgm)->edbg_acks = 0;
+        PDATA(pgm)->edbg_ackmask = 0;
+        return -1;
+      }
+      if (status[0] != EDBG_VENDOR_AVR_CMD ||
+          (last && status[1] != 0x01))
+        {
+          /* what to do in this case? */
+          avrdude_message(MSG_NOTICE, "%s: jtag3_edbg_collect(): Unexpected response 0x%02x, 0x%02x\n",
+                          progname, status[0], status[1]);
+        }
     }
 
+  return 0;
+}
+
+/*
+ * Send a command as a sequence of AVR_CMD fragments.  The fragments
+ * are streamed out back to back as far as the ICE can queue them;
+ * their status reports are collected as room is needed, at the latest
+ * by the next jtag3_edbg_recv_frame().
+ */
+static int jtag3_edbg_send(const PROGRAMMER *pgm, unsigned char *data, size_t len) {
+  unsigned char buf[USBDEV_MAX_XFER_3];
+
+  if (verbose >= 4)
+    memset(buf, 0, USBDEV_MAX_XFER_3);
+
   avrdude_message(MSG_DEBUG, "\n%s: jtag3_edbg_send(): sending %lu bytes\n",
 	    progname, (unsigned long)len);
 
@@ -499,26 +549,19 @@ static int jtag3_edbg_send(const PROGRAMMER *pgm, unsigned char *data, size_t le
           memcpy(buf + 4, data, this_len);
         }
 
-      if (serial_send(&pgm->fd, buf, max_xfer) != 0) {
-        avrdude_message(MSG_NOTICE, "%s: jtag3_edbg_send(): failed to send command to serial port\n",
-                        progname);
+      /* make room in the ICE's queue for this fragment */
+      if (jtag3_edbg_collect(pgm, PDATA(pgm)->edbg_window - 1) < 0)
         return -1;
-      }
-      rv = serial_recv(&pgm->fd, status, max_xfer);
 
-      if (rv < 0) {
-        /* timeout in receive */
-        avrdude_message(MSG_NOTICE2, "%s: jtag3_edbg_send(): Timeout receiving packet\n",
+      if (serial_send(pgm, &pgm->fd, buf, max_xfer) != 0) {
+        avrdude_message(MSG_NOTICE, "%s: jtag3_edbg_send(): failed to send command to serial port\n",
                         progname);
         return -1;
       }
-      if (status[0] != EDBG_VENDOR_AVR_CMD ||
-          (frag == nfragments - 1 && status[1] != 0x01))
-        {
-          /* what to do in this case? */
-          avrdude_message(MSG_NOTICE, "%s: jtag3_edbg_send(): Unexpected response 0x%02x, 0x%02x\n",
-                          progname, status[0], status[1]);
-        }
+      if (frag == nfragments - 1)
+        PDATA(pgm)->edbg_ackmask |= 1u << PDATA(pgm)->edbg_acks;
+      PDATA(pgm)->edbg_acks++;
+
       data += this_len;
       len -= this_len;
     }
@@ -542,12 +585,12 @@ static int jtag3_edbg_prepare(const PROGRAMMER *pgm) {
 
   buf[0] = CMSISDAP_CMD_CONNECT;
   buf[1] = CMSISDAP_CONN_SWD;
-  if (serial_send(&pgm->fd, buf, pgm->fd.usb.max_xfer) != 0) {
+  if (serial_send(pgm, &pgm->fd, buf, pgm->fd.usb.max_xfer) != 0) {
     avrdude_message(MSG_INFO, "%s: jtag3_edbg_prepare(): failed to send command to serial port\n",
                     progname);
     return -1;
   }
-  rv = serial_recv(&pgm->fd, status, pgm->fd.usb.max_xfer);
+  rv = serial_recv(pgm, &pgm->fd, status, pgm->fd.usb.max_xfer);
   if (rv != pgm->fd.usb.max_xfer) {
     avrdude_message(MSG_INFO, "%s: jtag3_edbg_prepare(): failed to read from serial port (%d)\n",
                     progname, rv);
@@ -563,12 +606,12 @@ static int jtag3_edbg_prepare(const PROGRAMMER *pgm) {
   buf[0] = CMSISDAP_CMD_LED;
   buf[1] = CMSISDAP_LED_CONNECT;
   buf[2] = 1;
-  if (serial_send(&pgm->fd, buf, pgm->fd.usb.max_xfer) != 0) {
+  if (serial_send(pgm, &pgm->fd, buf, pgm->fd.usb.max_xfer) != 0) {
     avrdude_message(MSG_INFO, "%s: jtag3_edbg_prepare(): failed to send command to serial port\n",
                     progname);
     return -1;
   }
-  rv = serial_recv(&pgm->fd, status, pgm->fd.usb.max_xfer);
+  rv = serial_recv(pgm, &pgm->fd, status, pgm->fd.usb.max_xfer);
   if (rv != pgm->fd.usb.max_xfer) {
     avrdude_message(MSG_INFO, "%s: jtag3_edbg_prepare(): failed to read from serial port (%d)\n",
                     progname, rv);
@@ -579,6 +622,30 @@ static int jtag3_edbg_prepare(const PROGRAMMER *pgm) {
     avrdude_message(MSG_INFO, "%s: jtag3_edbg_prepare(): unexpected response 0x%02x, 0x%02x\n",
                     progname, status[0], status[1]);
 
+  /*
+   * Find out how many packets the ICE can queue, so AVR command
+   * fragments can be streamed to it without waiting for each
+   * acknowledgement.
+   */
+  buf[0] = CMSISDAP_CMD_INFO;
+  buf[1] = CMSISDAP_INFO_PACKET_COUNT;
+  if (serial_send(pgm, &pgm->fd, buf, pgm->fd.usb.max_xfer) != 0) {
+    avrdude_message(MSG_INFO, "%s: jtag3_edbg_prepare(): failed to send command to serial port\n",
+                    progname);
+    return -1;
+  }
+  rv = serial_recv(pgm, &pgm->fd, status, pgm->fd.usb.max_xfer);
+  if (rv != pgm->fd.usb.max_xfer) {
+    avrdude_message(MSG_INFO, "%s: jtag3_edbg_prepare(): failed to read from serial port (%d)\n",
+                    progname, rv);
+    return -1;
+  }
+  PDATA(pgm)->edbg_window = 1;
+  if (status[0] == CMSISDAP_CMD_INFO && status[1] == 1 && status[2] > 0)
+    PDATA(pgm)->edbg_window = status[2] < EDBG_MAX_WINDOW? status[2]: EDBG_MAX_WINDOW;
+  avrdude_message(MSG_NOTICE2, "%s: jtag3_edbg_prepare(): streaming up to %d packets\n",
+                    progname, PDATA(pgm)->edbg_window);
+
   return 0;
 }
 
@@ -594,18 +661,20 @@ static int jtag3_edbg_signoff(const PROGRAMMER *pgm) {
   avrdude_message(MSG_DEBUG, "\n%s: jtag3_edbg_signoff()\n",
 	    progname);
 
+  (void)jtag3_edbg_collect(pgm, 0);
+
   if (verbose >= 4)
     memset(buf, 0, USBDEV_MAX_XFER_3);
 
   buf[0] = CMSISDAP_CMD_LED;
   buf[1] = CMSISDAP_LED_CONNECT;
   buf[2] = 0;
-  if (serial_send(&pgm->fd, buf, pgm->fd.usb.max_xfer) != 0) {
+  if (serial_send(pgm, &pgm->fd, buf, pgm->fd.usb.max_xfer) != 0) {
     avrdude_message(MSG_NOTICE, "%s: jtag3_edbg_signoff(): failed to send command to serial port\n",
                     progname);
     return -1;
   }
-  rv = serial_recv(&pgm->fd, status, pgm->fd.usb.max_xfer);
+  rv = serial_recv(pgm, &pgm->fd, status, pgm->fd.usb.max_xfer);
   if (rv != pgm->fd.usb.max_xfer) {
     avrdude_message(MSG_NOTICE, "%s: jtag3_edbg_signoff(): failed to read from serial port (%d)\n",
                     progname, rv);
@@ -617,12 +686,12 @@ static int jtag3_edbg_signoff(const PROGRAMMER *pgm) {
                     progname, status[0], status[1]);
 
   buf[0] = CMSISDAP_CMD_DISCONNECT;
-  if (serial_send(&pgm->fd, buf, pgm->fd.usb.max_xfer) != 0) {
+  if (serial_send(pgm, &pgm->fd, buf, pgm->fd.usb.max_xfer) != 0) {
     avrdude_message(MSG_NOTICE, "%s: jtag3_edbg_signoff(): failed to send command to serial port\n",
                     progname);
     return -1;
   }
-  rv = serial_recv(&pgm->fd, status, pgm->fd.usb.max_xfer);
+  rv = serial_recv(pgm, &pgm->fd, status, pgm->fd.usb.max_xfer);
   if (rv != pgm->fd.usb.max_xfer) {
     avrdude_message(MSG_NOTICE, "%s: jtag3_edbg_signoff(): failed to read from serial port (%d)\n",
                     progname, rv);
@@ -638,7 +707,7 @@ static int jtag3_edbg_signoff(const PROGRAMMER *pgm) {
 
 
 static int jtag3_drain(const PROGRAMMER *pgm, int display) {
-  return serial_drain(&pgm->fd, display);
+  return serial_drain(pgm, &pgm->fd, display);
 }
 
 
@@ -667,7 +736,7 @@ static int jtag3_recv_frame(const PROGRAMMER *pgm, unsigned char **msg) {
   if (verbose >= 4)
     memset(buf, 0, pgm->fd.usb.max_xfer);
 
-  rv = serial_recv(&pgm->fd, buf, pgm->fd.usb.max_xfer);
+  rv = serial_recv(pgm, &pgm->fd, buf, pgm->fd.usb.max_xfer);
 
   if (rv < 0) {
     /* timeout in receive */
@@ -682,10 +751,34 @@ static int jtag3_recv_frame(const PROGRAMMER *pgm, unsigned char **msg) {
   return rv;
 }
 
+/*
+ * Send one AVR_RSP request report.
+ */
+static int jtag3_edbg_request(const PROGRAMMER *pgm, unsigned char *request) {
+  request[0] = EDBG_VENDOR_AVR_RSP;
+
+  if (serial_send(pgm, &pgm->fd, request, pgm->fd.usb.max_xfer) != 0) {
+    avrdude_message(MSG_NOTICE, "%s: jtag3_edbg_recv(): error sending CMSIS-DAP vendor command\n",
+                    progname);
+    return -1;
+  }
+
+  return 0;
+}
+
+/*
+ * Receive a response as a sequence of AVR_RSP fragments.  The status
+ * reports of the preceding command are collected while the first
+ * request is already queued, and once the number of fragments is
+ * known, requests for the remaining ones are streamed ahead as far as
+ * the ICE can queue them.
+ */
 static int jtag3_edbg_recv_frame(const PROGRAMMER *pgm, unsigned char **msg) {
   int rv, len = 0;
   unsigned char *buf = NULL;
   unsigned char *request;
+  int window = PDATA(pgm)->edbg_window;
+  int requested, inflight;
 
   avrdude_message(MSG_TRACE, "%s: jtag3_edbg_recv():\n", progname);
 
@@ -700,40 +793,38 @@ static int jtag3_edbg_recv_frame(const PROGRAMMER *pgm, unsigned char **msg) {
     free(buf);
     return -1;
   }
+  memset(request, 0, pgm->fd.usb.max_xfer);
 
   *msg = buf;
 
   int nfrags = 0;
   int thisfrag = 0;
 
-  do {
-    request[0] = EDBG_VENDOR_AVR_RSP;
-
-    if (serial_send(&pgm->fd, request, pgm->fd.usb.max_xfer) != 0) {
-      avrdude_message(MSG_NOTICE, "%s: jtag3_edbg_recv(): error sending CMSIS-DAP vendor command\n",
-                      progname);
-      free(request);
-      free(*msg);
-      return -1;
-    }
+  if (jtag3_edbg_collect(pgm, window - 1) < 0 ||
+      jtag3_edbg_request(pgm, request) < 0) {
+    free(*msg);
+    free(request);
+    return -1;
+  }
+  requested = inflight = 1;
+  if (jtag3_edbg_collect(pgm, 0) < 0)
+    goto fail;
 
-    rv = serial_recv(&pgm->fd, buf, pgm->fd.usb.max_xfer);
+  do {
+    rv = serial_recv(pgm, &pgm->fd, buf, pgm->fd.usb.max_xfer);
+    inflight--;
 
     if (rv < 0) {
       /* timeout in receive */
       avrdude_message(MSG_NOTICE2, "%s: jtag3_edbg_recv(): Timeout receiving packet\n",
                       progname);
-      free(*msg);
-      free(request);
-      return -1;
+      goto fail;
     }
 
     if (buf[0] != EDBG_VENDOR_AVR_RSP) {
       avrdude_message(MSG_NOTICE, "%s: jtag3_edbg_recv(): Unexpected response 0x%02x\n",
                       progname, buf[0]);
-      free(*msg);
-      free(request);
-      return -1;
+      goto fail;
     }
 
     if (buf[1] == 0) {
@@ -744,9 +835,7 @@ static int jtag3_edbg_recv_frame(const PROGRAMMER *pgm, unsigned char **msg) {
 		      "%s: jtag3_edbg_recv(): "
 		      "No response available\n",
 		      progname);
-      free(*msg);
-      free(request);
-      return -1;
+      goto fail;
     }
 
     /* calculate fragment information */
@@ -760,9 +849,7 @@ static int jtag3_edbg_recv_frame(const PROGRAMMER *pgm, unsigned char **msg) {
                         "%s: jtag3_edbg_recv(): "
                         "Inconsistent # of fragments; had %d, now %d\n",
                         progname, nfrags, (buf[1] & 0x0F));
-        free(*msg);
-        free(request);
-        return -1;
+        goto fail;
       }
     }
     if (thisfrag != ((buf[1] >> 4) & 0x0F)) {
@@ -770,9 +857,15 @@ static int jtag3_edbg_recv_frame(const PROGRAMMER *pgm, unsigned char **msg) {
                       "%s: jtag3_edbg_recv(): "
                       "Inconsistent fragment number; expect %d, got %d\n",
                       progname, thisfrag, ((buf[1] >> 4) & 0x0F));
-      free(*msg);
-      free(request);
-      return -1;
+      goto fail;
+    }
+
+    /* keep the ICE busy with requests for the remaining fragments */
+    while (requested < nfrags && inflight < window) {
+      if (jtag3_edbg_request(pgm, request) < 0)
+        goto fail;
+      requested++;
+      inflight++;
     }
 
     int thislen = (buf[2] << 8) | buf[3];
@@ -794,6 +887,14 @@ static int jtag3_edbg_recv_frame(const PROGRAMMER *pgm, unsigned char **msg) {
 
   free(request);
   return len;
+
+ fail:
+  /* drop the responses to requests still in flight */
+  while (inflight-- > 0)
+    (void)serial_recv(pgm, &pgm->fd, request, pgm->fd.usb.max_xfer);
+  free(*msg);
+  free(request);
+  return -1;
 }
 
 int jtag3_recv(const PROGRAMMER *pgm, unsigned char **msg) {
@@ -1530,7 +1631,7 @@ int jtag3_open_common(PROGRAMMER *pgm, const char *port) {
    * Try HIDAPI first.  LibUSB is more generic, but might then cause
    * troubles for HID-class devices in some OSes (like Windows).
    */
-  serdev = &usbhid_serdev;
+  pgm->serdev = &usbhid_serdev;
   for (usbpid = lfirst(pgm->usbpid); rv < 0 && usbpid != NULL; usbpid = lnext(usbpid)) {
     pinfo.usbinfo.flags = PINFO_FL_SILENT;
     pinfo.usbinfo.pid = *(int *)(ldata(usbpid));
@@ -1540,12 +1641,12 @@ int jtag3_open_common(PROGRAMMER *pgm, const char *port) {
     pgm->fd.usb.eep = 0;
 
     strcpy(pgm->port, port);
-    rv = serial_open(port, pinfo, &pgm->fd);
+    rv = serial_open(pgm, port, pinfo, &pgm->fd);
   }
   if (rv < 0) {
 #endif	/* HAVE_LIBHIDAPI */
 #if defined(HAVE_LIBUSB)
-    serdev = &usb_serdev_frame;
+    pgm->serdev = &usb_serdev_frame;
     for (usbpid = lfirst(pgm->usbpid); rv < 0 && usbpid != NULL; usbpid = lnext(usbpid)) {
       pinfo.usbinfo.flags = PINFO_FL_SILENT;
       pinfo.usbinfo.pid = *(int *)(ldata(usbpid));
@@ -1555,7 +1656,7 @@ int jtag3_open_common(PROGRAMMER *pgm, const char *port) {
       pgm->fd.usb.eep = USBDEV_EVT_EP_READ_3;
 
       strcpy(pgm->port, port);
-      rv = serial_open(port, pinfo, &pgm->fd);
+      rv = serial_open(pgm, port, pinfo, &pgm->fd);
     }
 #endif	/* HAVE_LIBUSB */
 #if defined(HAVE_LIBHIDAPI)
@@ -1675,7 +1776,7 @@ void jtag3_close(PROGRAMMER * pgm)
       jtag3_edbg_signoff(pgm);
   }
 
-  serial_close(&pgm->fd);
+  serial_close(pgm, &pgm->fd);
   pgm->fd.ifd = -1;
 }
 
@@ -2517,6 +2618,7 @@ void jtag3_initpgm(PROGRAMMER *pgm) {
    */
   pgm->paged_write    = jtag3_paged_write;
   pgm->paged_load     = jtag3_paged_load;
+  pgm->max_read_chunk = 4096;
   pgm->page_erase     = jtag3_page_erase;
   pgm->print_parms    = jtag3_print_parms;
   pgm->set_sck_period = jtag3_set_sck_period;
@@ -2551,6 +2653,7 @@ void jtag3_dw_initpgm(PROGRAMMER *pgm) {
    */
   pgm->paged_write    = jtag3_paged_write;
   pgm->paged_load     = jtag3_paged_load;
+  pgm->max_read_chunk = 4096;
   pgm->print_parms    = jtag3_print_parms;
   pgm->setup          = jtag3_setup;
   pgm->teardown       = jtag3_teardown;
@@ -2582,6 +2685,7 @@ void jtag3_pdi_initpgm(PROGRAMMER *pgm) {
    */
   pgm->paged_write    = jtag3_paged_write;
   pgm->paged_load     = jtag3_paged_load;
+  pgm->max_read_chunk = 4096;
   pgm->page_erase     = jtag3_page_erase;
   pgm->print_parms    = jtag3_print_parms;
   pgm->set_sck_period = jtag3_set_sck_period;
@@ -2616,6 +2720,7 @@ void jtag3_updi_initpgm(PROGRAMMER *pgm) {
    */
   pgm->paged_write    = jtag3_paged_write;
   pgm->paged_load     = jtag3_paged_load;
+  pgm->max_read_chunk = 4096;
   pgm->page_erase     = jtag3_page_erase;
   pgm->print_parms    = jtag3_print_parms;
   pgm->set_sck_period = jtag3_set_sck_period;
@@ -209,7 +209,7 @@ static int jtagmkI_send(const PROGRAMMER *pgm, unsigned char *data, size_t len)
   buf[len] = ' ';		/* "CRC" */
   buf[len + 1] = ' ';		/* EOP */
 
-  if (serial_send(&pgm->fd, buf, len + 2) != 0) {
+  if (serial_send(pgm, &pgm->fd, buf, len + 2) != 0) {
     avrdude_message(MSG_INFO, "%s: jtagmkI_send(): failed to send command to serial port\n",
                     progname);
     free(buf);
@@ -222,7 +222,7 @@ static int jtagmkI_send(const PROGRAMMER *pgm, unsigned char *data, size_t len)
 }
 
 static int jtagmkI_recv(const PROGRAMMER *pgm, unsigned char *buf, size_t len) {
-  if (serial_recv(&pgm->fd, buf, len) != 0) {
+  if (serial_recv(pgm, &pgm->fd, buf, len) != 0) {
     avrdude_message(MSG_INFO, "\n%s: jtagmkI_recv(): failed to send command to serial port\n",
                     progname);
     return -1;
@@ -236,7 +236,7 @@ static int jtagmkI_recv(const PROGRAMMER *pgm, unsigned char *buf, size_t len) {
 
 
 static int jtagmkI_drain(const PROGRAMMER *pgm, int display) {
-  return serial_drain(&pgm->fd, display);
+  return serial_drain(pgm, &pgm->fd, display);
 }
 
 
@@ -258,13 +258,13 @@ static int jtagmkI_resync(const PROGRAMMER *pgm, int maxtries, int signon) {
     avrdude_message(MSG_NOTICE2, "%s: jtagmkI_resync(): Sending sync command: ",
 	      progname);
 
-    if (serial_send(&pgm->fd, buf, 1) != 0) {
+    if (serial_send(pgm, &pgm->fd, buf, 1) != 0) {
       avrdude_message(MSG_INFO, "\n%s: jtagmkI_resync(): failed to send command to serial port\n",
                       progname);
       serial_recv_timeout = otimeout;
       return -1;
     }
-    if (serial_recv(&pgm->fd, resp, 1) == 0 && resp[0] == RESP_OK) {
+    if (serial_recv(pgm, &pgm->fd, resp, 1) == 0 && resp[0] == RESP_OK) {
       avrdude_message(MSG_NOTICE2, "got RESP_OK\n");
       break;
     }
@@ -287,13 +287,13 @@ static int jtagmkI_resync(const PROGRAMMER *pgm, int maxtries, int signon) {
       avrdude_message(MSG_NOTICE2, "%s: jtagmkI_resync(): Sending sign-on command: ",
 		progname);
 
-      if (serial_send(&pgm->fd, buf, 4) != 0) {
+      if (serial_send(pgm, &pgm->fd, buf, 4) != 0) {
 	avrdude_message(MSG_INFO, "\n%s: jtagmkI_resync(): failed to send command to serial port\n",
                         progname);
 	serial_recv_timeout = otimeout;
 	return -1;
       }
-      if (serial_recv(&pgm->fd, resp, 9) == 0 && resp[0] == RESP_OK) {
+      if (serial_recv(pgm, &pgm->fd, resp, 9) == 0 && resp[0] == RESP_OK) {
         avrdude_message(MSG_NOTICE2, "got RESP_OK\n");
 	break;
       }
@@ -531,7 +531,7 @@ static int jtagmkI_initialize(const PROGRAMMER *pgm, const AVRPART *p) {
 
   jtagmkI_drain(pgm, 0);
 
-  if ((serdev->flags & SERDEV_FL_CANSETSPEED) && PDATA(pgm)->initial_baudrate != pgm->baudrate) {
+  if ((pgm->serdev->flags & SERDEV_FL_CANSETSPEED) && PDATA(pgm)->initial_baudrate != pgm->baudrate) {
     if ((b = jtagmkI_get_baud(pgm->baudrate)) == 0) {
       avrdude_message(MSG_INFO, "%s: jtagmkI_initialize(): unsupported baudrate %d\n",
               progname, pgm->baudrate);
@@ -541,7 +541,7 @@ static int jtagmkI_initialize(const PROGRAMMER *pgm, const AVRPART *p) {
                 progname, pgm->baudrate);
       if (jtagmkI_setparm(pgm, PARM_BITRATE, b) == 0) {
         PDATA(pgm)->initial_baudrate = pgm->baudrate; /* don't adjust again later */
-        serial_setparams(&pgm->fd, pgm->baudrate, SERIAL_8N1);
+        serial_setparams(pgm, &pgm->fd, pgm->baudrate, SERIAL_8N1);
       }
     }
   }
@@ -638,7 +638,7 @@ static int jtagmkI_open(PROGRAMMER *pgm, const char *port)
     pinfo.serialinfo.cflags = SERIAL_8N1;
     avrdude_message(MSG_NOTICE2, "%s: jtagmkI_open(): trying to sync at baud rate %ld:\n",
                       progname, pinfo.serialinfo.baud);
-    if (serial_open(port, pinfo, &pgm->fd)==-1) {
+    if (serial_open(pgm, port, pinfo, &pgm->fd)==-1) {
       return -1;
     }
 
@@ -653,7 +653,7 @@ static int jtagmkI_open(PROGRAMMER *pgm, const char *port)
       return 0;
     }
 
-    serial_close(&pgm->fd);
+    serial_close(pgm, &pgm->fd);
   }
 
   avrdude_message(MSG_INFO, "%s: jtagmkI_open(): failed to synchronize to ICE\n",
@@ -675,7 +675,7 @@ static void jtagmkI_close(PROGRAMMER * pgm)
    * appears to make AVR Studio happier when it is about to access the
    * ICE later on.
    */
-  if ((serdev->flags & SERDEV_FL_CANSETSPEED) && PDATA(pgm)->initial_baudrate != pgm->baudrate) {
+  if ((pgm->serdev->flags & SERDEV_FL_CANSETSPEED) && PDATA(pgm)->initial_baudrate != pgm->baudrate) {
     if ((b = jtagmkI_get_baud(PDATA(pgm)->initial_baudrate)) == 0) {
       avrdude_message(MSG_INFO, "%s: jtagmkI_close(): unsupported baudrate %d\n",
               progname, PDATA(pgm)->initial_baudrate);
@@ -684,13 +684,13 @@ static void jtagmkI_close(PROGRAMMER * pgm)
                 "trying to set baudrate to %d\n",
                 progname, PDATA(pgm)->initial_baudrate);
       if (jtagmkI_setparm(pgm, PARM_BITRATE, b) == 0) {
-        serial_setparams(&pgm->fd, pgm->baudrate, SERIAL_8N1);
+        serial_setparams(pgm, &pgm->fd, pgm->baudrate, SERIAL_8N1);
       }
     }
   }
 
   if (pgm->fd.ifd != -1) {
-    serial_close(&pgm->fd);
+    serial_close(pgm, &pgm->fd);
   }
 
   pgm->fd.ifd = -1;
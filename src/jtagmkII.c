@@ -438,7 +438,7 @@ int jtagmkII_send(const PROGRAMMER *pgm, unsigned char *data, size_t len) {
 
   crcappend(buf, len + 8);
 
-  if (serial_send(&pgm->fd, buf, len + 10) != 0) {
+  if (serial_send(pgm, &pgm->fd, buf, len + 10) != 0) {
     avrdude_message(MSG_INFO, "%s: jtagmkII_send(): failed to send command to serial port\n",
                     progname);
     free(buf);
@@ -452,7 +452,7 @@ int jtagmkII_send(const PROGRAMMER *pgm, unsigned char *data, size_t len) {
 
 
 static int jtagmkII_drain(const PROGRAMMER *pgm, int display) {
-  return serial_drain(&pgm->fd, display);
+  return serial_drain(pgm, &pgm->fd, display);
 }
 
 
@@ -499,9 +499,9 @@ static int jtagmkII_recv_frame(const PROGRAMMER *pgm, unsigned char **msg,
       if (ignorpkt) {
 	/* skip packet's contents */
 	for(l = 0; l < msglen; l++)
-	  rv += serial_recv(&pgm->fd, &c, 1);
+	  rv += serial_recv(pgm, &pgm->fd, &c, 1);
       } else {
-	rv += serial_recv(&pgm->fd, buf + 8, msglen);
+	rv += serial_recv(pgm, &pgm->fd, buf + 8, msglen);
       }
       if (rv != 0) {
 	timedout:
@@ -512,7 +512,7 @@ static int jtagmkII_recv_frame(const PROGRAMMER *pgm, unsigned char **msg,
 	return -1;
       }
     } else {
-      if (serial_recv(&pgm->fd, &c, 1) != 0)
+      if (serial_recv(pgm, &pgm->fd, &c, 1) != 0)
 	goto timedout;
     }
 
@@ -1318,7 +1318,7 @@ static int jtagmkII_initialize(const PROGRAMMER *pgm, const AVRPART *p) {
     return -1;
   }
 
-  if ((serdev->flags & SERDEV_FL_CANSETSPEED) && pgm->baudrate && pgm->baudrate != 19200) {
+  if ((pgm->serdev->flags & SERDEV_FL_CANSETSPEED) && pgm->baudrate && pgm->baudrate != 19200) {
     if ((b = jtagmkII_get_baud(pgm->baudrate)) == 0) {
       avrdude_message(MSG_INFO, "%s: jtagmkII_initialize(): unsupported baudrate %d\n",
 	      progname, pgm->baudrate);
@@ -1327,7 +1327,7 @@ static int jtagmkII_initialize(const PROGRAMMER *pgm, const AVRPART *p) {
 		"trying to set baudrate to %d\n",
 		progname, pgm->baudrate);
       if (jtagmkII_setparm(pgm, PAR_BAUD_RATE, &b) == 0)
-	serial_setparams(&pgm->fd, pgm->baudrate, SERIAL_8N1);
+	serial_setparams(pgm, &pgm->fd, pgm->baudrate, SERIAL_8N1);
     }
   }
   if ((pgm->flag & PGM_FL_IS_JTAG) && pgm->bitclock != 0.0) {
@@ -1511,7 +1511,7 @@ static int jtagmkII_open(PROGRAMMER *pgm, const char *port) {
    */
   if (strncmp(port, "usb", 3) == 0) {
 #if defined(HAVE_LIBUSB)
-    serdev = &usb_serdev;
+    pgm->serdev = &usb_serdev;
     pinfo.usbinfo.vid = USB_VENDOR_ATMEL;
     pinfo.usbinfo.flags = 0;
     pinfo.usbinfo.pid = USB_DEVICE_JTAGICEMKII;
@@ -1526,7 +1526,7 @@ static int jtagmkII_open(PROGRAMMER *pgm, const char *port) {
   }
 
   strcpy(pgm->port, port);
-  if (serial_open(port, pinfo, &pgm->fd)==-1) {
+  if (serial_open(pgm, port, pinfo, &pgm->fd)==-1) {
     return -1;
   }
 
@@ -1563,7 +1563,7 @@ static int jtagmkII_open_dw(PROGRAMMER *pgm, const char *port) {
    */
   if (strncmp(port, "usb", 3) == 0) {
 #if defined(HAVE_LIBUSB)
-    serdev = &usb_serdev;
+    pgm->serdev = &usb_serdev;
     pinfo.usbinfo.vid = USB_VENDOR_ATMEL;
     pinfo.usbinfo.flags = 0;
     pinfo.usbinfo.pid = USB_DEVICE_JTAGICEMKII;
@@ -1578,7 +1578,7 @@ static int jtagmkII_open_dw(PROGRAMMER *pgm, const char *port) {
   }
 
   strcpy(pgm->port, port);
-  if (serial_open(port, pinfo, &pgm->fd)==-1) {
+  if (serial_open(pgm, port, pinfo, &pgm->fd)==-1) {
     return -1;
   }
 
@@ -1615,7 +1615,7 @@ static int jtagmkII_open_pdi(PROGRAMMER *pgm, const char *port) {
    */
   if (strncmp(port, "usb", 3) == 0) {
 #if defined(HAVE_LIBUSB)
-    serdev = &usb_serdev;
+    pgm->serdev = &usb_serdev;
     pinfo.usbinfo.vid = USB_VENDOR_ATMEL;
     pinfo.usbinfo.flags = 0;
     pinfo.usbinfo.pid = USB_DEVICE_JTAGICEMKII;
@@ -1630,7 +1630,7 @@ static int jtagmkII_open_pdi(PROGRAMMER *pgm, const char *port) {
   }
 
   strcpy(pgm->port, port);
-  if (serial_open(port, pinfo, &pgm->fd)==-1) {
+  if (serial_open(pgm, port, pinfo, &pgm->fd)==-1) {
     return -1;
   }
 
@@ -1668,7 +1668,7 @@ static int jtagmkII_dragon_open(PROGRAMMER *pgm, const char *port) {
    */
   if (strncmp(port, "usb", 3) == 0) {
 #if defined(HAVE_LIBUSB)
-    serdev = &usb_serdev;
+    pgm->serdev = &usb_serdev;
     pinfo.usbinfo.vid = USB_VENDOR_ATMEL;
     pinfo.usbinfo.flags = 0;
     pinfo.usbinfo.pid = USB_DEVICE_AVRDRAGON;
@@ -1683,7 +1683,7 @@ static int jtagmkII_dragon_open(PROGRAMMER *pgm, const char *port) {
   }
 
   strcpy(pgm->port, port);
-  if (serial_open(port, pinfo, &pgm->fd)==-1) {
+  if (serial_open(pgm, port, pinfo, &pgm->fd)==-1) {
     return -1;
   }
 
@@ -1721,7 +1721,7 @@ static int jtagmkII_dragon_open_dw(PROGRAMMER *pgm, const char *port) {
    */
   if (strncmp(port, "usb", 3) == 0) {
 #if defined(HAVE_LIBUSB)
-    serdev = &usb_serdev;
+    pgm->serdev = &usb_serdev;
     pinfo.usbinfo.vid = USB_VENDOR_ATMEL;
     pinfo.usbinfo.flags = 0;
     pinfo.usbinfo.pid = USB_DEVICE_AVRDRAGON;
@@ -1736,7 +1736,7 @@ static int jtagmkII_dragon_open_dw(PROGRAMMER *pgm, const char *port) {
   }
 
   strcpy(pgm->port, port);
-  if (serial_open(port, pinfo, &pgm->fd)==-1) {
+  if (serial_open(pgm, port, pinfo, &pgm->fd)==-1) {
     return -1;
   }
 
@@ -1774,7 +1774,7 @@ static int jtagmkII_dragon_open_pdi(PROGRAMMER *pgm, const char *port) {
    */
   if (strncmp(port, "usb", 3) == 0) {
 #if defined(HAVE_LIBUSB)
-    serdev = &usb_serdev;
+    pgm->serdev = &usb_serdev;
     pinfo.usbinfo.vid = USB_VENDOR_ATMEL;
     pinfo.usbinfo.flags = 0;
     pinfo.usbinfo.pid = USB_DEVICE_AVRDRAGON;
@@ -1789,7 +1789,7 @@ static int jtagmkII_dragon_open_pdi(PROGRAMMER *pgm, const char *port) {
   }
 
   strcpy(pgm->port, port);
-  if (serial_open(port, pinfo, &pgm->fd)==-1) {
+  if (serial_open(pgm, port, pinfo, &pgm->fd)==-1) {
     return -1;
   }
 
@@ -1869,7 +1869,7 @@ void jtagmkII_close(PROGRAMMER * pgm)
                     progname, jtagmkII_get_rc(c));
   }
 
-  serial_close(&pgm->fd);
+  serial_close(pgm, &pgm->fd);
   pgm->fd.ifd = -1;
 }
 
@@ -3344,7 +3344,7 @@ static int jtagmkII_open32(PROGRAMMER *pgm, const char *port) {
    */
   if (strncmp(port, "usb", 3) == 0) {
 #if defined(HAVE_LIBUSB)
-    serdev = &usb_serdev;
+    pgm->serdev = &usb_serdev;
     pinfo.usbinfo.vid = USB_VENDOR_ATMEL;
     pinfo.usbinfo.flags = 0;
     pinfo.usbinfo.pid = USB_DEVICE_JTAGICEMKII;
@@ -3359,7 +3359,7 @@ static int jtagmkII_open32(PROGRAMMER *pgm, const char *port) {
   }
 
   strcpy(pgm->port, port);
-  if (serial_open(port, pinfo, &pgm->fd)==-1) {
+  if (serial_open(pgm, port, pinfo, &pgm->fd)==-1) {
     return -1;
   }
 
@@ -3445,7 +3445,7 @@ static void jtagmkII_close32(PROGRAMMER * pgm)
   }
 
   ret:
-    serial_close(&pgm->fd);
+    serial_close(pgm, &pgm->fd);
     pgm->fd.ifd = -1;
     return;
 
@@ -3801,6 +3801,7 @@ void jtagmkII_initpgm(PROGRAMMER *pgm) {
    */
   pgm->paged_write    = jtagmkII_paged_write;
   pgm->paged_load     = jtagmkII_paged_load;
+  pgm->max_read_chunk = 4096;
   pgm->page_erase     = jtagmkII_page_erase;
   pgm->print_parms    = jtagmkII_print_parms;
   pgm->set_sck_period = jtagmkII_set_sck_period;
@@ -3835,6 +3836,7 @@ void jtagmkII_dw_initpgm(PROGRAMMER *pgm) {
    */
   pgm->paged_write    = jtagmkII_paged_write;
   pgm->paged_load     = jtagmkII_paged_load;
+  pgm->max_read_chunk = 4096;
   pgm->print_parms    = jtagmkII_print_parms;
   pgm->setup          = jtagmkII_setup;
   pgm->teardown       = jtagmkII_teardown;
@@ -3866,6 +3868,7 @@ void jtagmkII_pdi_initpgm(PROGRAMMER *pgm) {
    */
   pgm->paged_write    = jtagmkII_paged_write;
   pgm->paged_load     = jtagmkII_paged_load;
+  pgm->max_read_chunk = 4096;
   pgm->page_erase     = jtagmkII_page_erase;
   pgm->print_parms    = jtagmkII_print_parms;
   pgm->setup          = jtagmkII_setup;
@@ -3898,6 +3901,7 @@ void jtagmkII_updi_initpgm(PROGRAMMER *pgm) {
    */
   pgm->paged_write    = jtagmkII_paged_write;
   pgm->paged_load     = jtagmkII_paged_load;
+  pgm->max_read_chunk = 4096;
   pgm->page_erase     = jtagmkII_page_erase;
   pgm->print_parms    = jtagmkII_print_parms;
   pgm->setup          = jtagmkII_setup;
@@ -3930,6 +3934,7 @@ void jtagmkII_dragon_initpgm(PROGRAMMER *pgm) {
    */
   pgm->paged_write    = jtagmkII_paged_write;
   pgm->paged_load     = jtagmkII_paged_load;
+  pgm->max_read_chunk = 4096;
   pgm->page_erase     = jtagmkII_page_erase;
   pgm->print_parms    = jtagmkII_print_parms;
   pgm->set_sck_period = jtagmkII_set_sck_period;
@@ -3964,6 +3969,7 @@ void jtagmkII_dragon_dw_initpgm(PROGRAMMER *pgm) {
    */
   pgm->paged_write    = jtagmkII_paged_write;
   pgm->paged_load     = jtagmkII_paged_load;
+  pgm->max_read_chunk = 4096;
   pgm->print_parms    = jtagmkII_print_parms;
   pgm->setup          = jtagmkII_setup;
   pgm->teardown       = jtagmkII_teardown;
@@ -4028,6 +4034,7 @@ void jtagmkII_dragon_pdi_initpgm(PROGRAMMER *pgm) {
    */
   pgm->paged_write    = jtagmkII_paged_write;
   pgm->paged_load     = jtagmkII_paged_load;
+  pgm->max_read_chunk = 4096;
   pgm->page_erase     = jtagmkII_page_erase;
   pgm->print_parms    = jtagmkII_print_parms;
   pgm->setup          = jtagmkII_setup;
@@ -179,8 +179,27 @@ typedef struct cmdbit {
   int          value; /* bit value if type == AVR_CMDBIT_VALUD */
 } CMDBIT;
 
+/*
+ * Compiled form of the opcode bit specs: the 32-bit command word (byte 0 of
+ * the command in bits 31..24) is assembled with masks and grouped shifts
+ * instead of walking bit[], see avr_compile_opcode(). Input and output bits
+ * never need more than one group per command byte; address bits that need
+ * more than OPSHIFT_MAX groups set n to -1 and fall back to walking bit[].
+ */
+#define OPSHIFT_MAX 4
+
+typedef struct opshift {
+  int           n;         /* number of shift groups, -1 if too many */
+  signed char   shift[OPSHIFT_MAX]; /* command bit position minus source bit number */
+  uint32_t      mask[OPSHIFT_MAX];  /* source (address or data) bits of each group */
+} OPSHIFT;
+
 typedef struct opcode {
   CMDBIT        bit[32]; /* opcode bit specs */
+  uint32_t      fixmask; /* command bits of type value or ignore */
+  uint32_t      fixbits; /* the values of those bits */
+  uint32_t      amask, imask, omask; /* address, input and output bits */
+  OPSHIFT       addr, in, out;
 } OPCODE;
 
 
@@ -214,7 +233,7 @@ typedef struct opcode {
 #define FLASH_INSTR_SIZE 3
 #define EEPROM_INSTR_SIZE 20
 
-#define TAG_ALLOCATED          1    /* memory byte is allocated */
+#define TAG_ALLOCATED          1    /* memory byte is allocated; set with avr_mem_set_allocated() */
 
 /*
  * Any changes in AVRPART or AVRMEM, please also ensure changes are made in
@@ -299,6 +318,16 @@ typedef struct avrpart {
   int           lineno;             /* config file line number */
 } AVRPART;
 
+/*
+ * Contiguous run of bytes tagged TAG_ALLOCATED in a memory buffer; the
+ * extents of a memory let callers plan reads and writes in time
+ * proportional to the data rather than to the size of the memory
+ */
+typedef struct avrmem_extent {
+  int addr;                   /* first allocated byte */
+  int len;                    /* number of allocated bytes */
+} AVRMEM_EXTENT;
+
 typedef struct avrmem {
   const char *desc;           /* memory description ("flash", "eeprom", etc) */
   LISTID comments;            // Used by developer options -p*/[ASsr...]
@@ -323,6 +352,10 @@ typedef struct avrmem {
 
   unsigned char * buf;        /* pointer to memory buffer */
   unsigned char * tags;       /* allocation tags */
+  AVRMEM_EXTENT * extents;    /* sorted, disjoint runs of allocated bytes */
+  int nextents;               /* number of extents in use */
+  int maxextents;             /* number of extents allocated */
+  unsigned char * dirty;      /* one bit per page with data not known to be on chip */
   OPCODE * op[AVR_OP_MAX];    /* opcodes */
 } AVRMEM;
 
@@ -341,6 +374,7 @@ int intlog2(unsigned int n);
 /* Functions for OPCODE structures */
 OPCODE * avr_new_opcode(void);
 void     avr_free_opcode(OPCODE * op);
+void     avr_compile_opcode(OPCODE *op);
 int avr_set_bits(const OPCODE *op, unsigned char *cmd);
 int avr_set_addr(const OPCODE *op, unsigned char *cmd, unsigned long addr);
 int avr_set_addr_mem(const AVRMEM *mem, int opnum, unsigned char *cmd, unsigned long addr);
@@ -358,6 +392,15 @@ AVRMEM_ALIAS * avr_new_memalias(void);
 int avr_initmem(const AVRPART *p);
 AVRMEM * avr_dup_mem(const AVRMEM *m);
 void     avr_free_mem(AVRMEM * m);
+void     avr_mem_set_allocated(AVRMEM *m, int addr, int len);
+void     avr_mem_clear_allocated(AVRMEM *m);
+int      avr_mem_next_allocated(const AVRMEM *m, int addr);
+int      avr_mem_next_page(const AVRMEM *m, int addr, int end, int pgsize);
+int      avr_mem_count_pages(const AVRMEM *m, int end, int pgsize);
+int      avr_mem_page_dirty(const AVRMEM *m, int addr);
+void     avr_mem_set_page_clean(AVRMEM *m, int addr);
+int      avr_mem_next_dirty_page(const AVRMEM *m, int addr, int end, int pgsize);
+int      avr_mem_count_dirty_pages(const AVRMEM *m, int end, int pgsize);
 void     avr_free_memalias(AVRMEM_ALIAS * m);
 AVRMEM * avr_locate_mem(const AVRPART *p, const char *desc);
 AVRMEM * avr_locate_mem_noalias(const AVRPART *p, const char *desc);
@@ -374,6 +417,7 @@ AVRPART * locate_part(const LISTID parts, const char *partdesc);
 AVRPART * locate_part_by_avr910_devcode(const LISTID parts, int devcode);
 AVRPART * locate_part_by_signature(const LISTID parts, unsigned char *sig,
                                    int sigsize);
+void      avr_index_parts(LISTID parts);
 void avr_display(FILE *f, const AVRPART *p, const char *prefix, int verbose);
 
 typedef void (*walk_avrparts_cb)(const char *name, const char *desc,
@@ -647,20 +691,20 @@ struct serial_device {
 #define SERDEV_FL_CANSETSPEED  0x0001 /* device can change speed */
 };
 
-extern struct serial_device *serdev;
 extern struct serial_device serial_serdev;
 extern struct serial_device usb_serdev;
 extern struct serial_device usb_serdev_frame;
 extern struct serial_device avrdoper_serdev;
 extern struct serial_device usbhid_serdev;
 
-#define serial_open (serdev->open)
-#define serial_setparams (serdev->setparams)
-#define serial_close (serdev->close)
-#define serial_send (serdev->send)
-#define serial_recv (serdev->recv)
-#define serial_drain (serdev->drain)
-#define serial_set_dtr_rts (serdev->set_dtr_rts)
+// Serial calls go through the transport of the given programmer
+#define serial_open(pgm, ...) ((pgm)->serdev->open(__VA_ARGS__))
+#define serial_setparams(pgm, ...) ((pgm)->serdev->setparams(__VA_ARGS__))
+#define serial_close(pgm, ...) ((pgm)->serdev->close(__VA_ARGS__))
+#define serial_send(pgm, ...) ((pgm)->serdev->send(__VA_ARGS__))
+#define serial_recv(pgm, ...) ((pgm)->serdev->recv(__VA_ARGS__))
+#define serial_drain(pgm, ...) ((pgm)->serdev->drain(__VA_ARGS__))
+#define serial_set_dtr_rts(pgm, ...) ((pgm)->serdev->set_dtr_rts(__VA_ARGS__))
 
 /* formerly pgm.h */
 
@@ -723,6 +767,7 @@ typedef struct programmer_t {
 
   // Values below are not set by config_gram.y; ensure fd is first for dev_pgm_raw()
   union filedescriptor fd;
+  struct serial_device *serdev; // Transport of fd, serial_serdev unless the backend selects another
   char type[PGM_TYPELEN];
   char port[PGM_PORTLEN];
   unsigned int pinno[N_PINS];   // TODO to be removed if old pin data no longer needed
@@ -733,6 +778,7 @@ typedef struct programmer_t {
   int ppictrl;
   int ispdelay;                 // ISP clock delay
   int page_size;                // Page size if the programmer supports paged write/load
+  int max_read_chunk;           // Max bytes paged_load() reads in one call, 0: one page
   double bitclock;              // JTAG ICE clock period in microseconds
 
   int  (*rdy_led)        (const struct programmer_t *pgm, int value);
@@ -764,6 +810,13 @@ typedef struct programmer_t {
                           unsigned int n_bytes);
   int  (*page_erase)     (const struct programmer_t *pgm, const AVRPART *p, const AVRMEM *m,
                           unsigned int baseaddr);
+  /*
+   * Optional: CRC-32 (see avr_crc32()) of len bytes of memory m from addr
+   * computed by target or tool; returns the number of valid low-order
+   * bits in *crc, or < 0 if the range is not supported
+   */
+  int  (*mem_crc)        (const struct programmer_t *pgm, const AVRPART *p, const AVRMEM *m,
+                          unsigned int addr, unsigned int len, unsigned long *crc);
   void (*write_setup)    (const struct programmer_t *pgm, const AVRPART *p, const AVRMEM *m);
   int  (*write_byte)     (const struct programmer_t *pgm, const AVRPART *p, const AVRMEM *m,
                           unsigned long addr, unsigned char value);
@@ -810,6 +863,7 @@ void pgm_display_generic_mask(const PROGRAMMER *pgm, const char *p, unsigned int
 void pgm_display_generic(const PROGRAMMER *pgm, const char *p);
 
 PROGRAMMER *locate_programmer(const LISTID programmers, const char *configid);
+void pgm_index_programmers(LISTID programmers);
 
 typedef void (*walk_programmers_cb)(const char *name, const char *desc,
                                     const char *cfgname, int cfglineno,
@@ -852,13 +906,32 @@ int avr_write_byte(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *mem,
 int avr_write_byte_default(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *mem,
 			   unsigned long addr, unsigned char data);
 
+int avr_spi_poll_ready(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *mem,
+                       unsigned long addr, unsigned int n);
+
+int avr_spi_paged_load(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *mem,
+                       unsigned int page_size, unsigned int addr, unsigned int n_bytes);
+
+int avr_spi_paged_write(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *mem,
+                        unsigned int page_size, unsigned int addr, unsigned int n_bytes);
+
 int avr_write(const PROGRAMMER *pgm, const AVRPART *p, const char *memtype, int size,
               int auto_erase);
 
+int avr_write_diff(const PROGRAMMER *pgm, const AVRPART *p, const char *memtype, int size,
+                   int auto_erase, int *nskipped);
+
+int avr_write_diff_needs_erase(const PROGRAMMER *pgm, const AVRPART *p, const char *memtype,
+                               int size);
+
 int avr_signature(const PROGRAMMER *pgm, const AVRPART *p);
 
 int avr_verify(const AVRPART * p, const AVRPART * v, const char * memtype, int size);
 
+unsigned long avr_crc32(unsigned long crc, const unsigned char *buf, unsigned int len);
+
+int avr_verify_crc(const PROGRAMMER *pgm, const AVRPART *p, const char *memtype, int size);
+
 int avr_get_cycle_count(const PROGRAMMER *pgm, const AVRPART *p, int *cycles);
 
 int avr_put_cycle_count(const PROGRAMMER *pgm, const AVRPART *p, int cycles);
@@ -946,6 +1019,7 @@ enum updateflags {
   UF_NOWRITE = 1,
   UF_AUTO_ERASE = 2,
   UF_VERIFY = 4,
+  UF_DIFFERENTIAL = 8,
 };
 
 
@@ -981,6 +1055,8 @@ extern int do_op(PROGRAMMER * pgm, struct avrpart * p, UPDATE * upd,
 
 extern int memstats(struct avrpart *p, char *memtype, int size, Filestats *fsp);
 
+extern int update_diff_needs_erase(PROGRAMMER * pgm, struct avrpart * p, LISTID updates);
+
 // Convenience functions for printing
 const char *update_plural(int x);
 const char *update_inname(const char *fn);
@@ -1035,6 +1111,7 @@ extern const char *default_parallel;
 extern const char *default_serial;
 extern const char *default_spi;
 extern double       default_bitclock;
+extern bool         cfg_keep_comments;
 
 /* This name is fixed, it's only here for symmetry with
  * default_parallel and default_serial. */
@@ -1046,16 +1123,33 @@ extern "C" {
 
 void *cfg_malloc(const char *funcname, size_t n);
 
+void *cfg_realloc(const char *funcname, void *p, size_t n);
+
 char *cfg_strdup(const char *funcname, const char *s);
 
+void *cfg_arena_malloc(const char *funcname, size_t n);
+
+char *cfg_arena_strdup(const char *funcname, const char *s);
+
+void cfg_free(void *p);
+
 int init_config(void);
 
 void cleanup_config(void);
 
 int read_config(const char * file);
 
+int read_config_cache(const char *cachefile, const LISTID cfgfiles, const char *partdesc,
+  const LISTID pgmids);
+
+void complete_config(void);
+
+int write_config_cache(const char *cachefile, const LISTID cfgfiles);
+
 const char *cache_string(const char *file);
 
+unsigned strcasehash(const char *str);
+
 unsigned char *cfg_unescapeu(unsigned char *d, const unsigned char *s);
 
 char *cfg_unescape(char *d, const char *s);
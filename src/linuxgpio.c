@@ -27,6 +27,7 @@
 #include <fcntl.h>
 #include <unistd.h>
 #include <errno.h>
+#include <sys/ioctl.h>
 
 #include "avrdude.h"
 #include "libavrdude.h"
@@ -35,6 +36,8 @@
 
 #if HAVE_LINUXGPIO
 
+#include <linux/gpio.h>
+
 /*
  * GPIO user space helpers
  *
@@ -139,9 +142,245 @@ static int linuxgpio_dir_in(unsigned int gpio)
 #define N_GPIO (PIN_MAX + 1)
 
 /*
-* an array which holds open FDs to /sys/class/gpio/gpioXX/value for all needed pins
-*/
-static int linuxgpio_fds[N_GPIO] ;
+ * Private data for this programmer
+ */
+struct pdata {
+  int fds[N_GPIO];              // Open FDs to /sys/class/gpio/gpioXX/value for all needed pins
+#ifdef GPIO_V2_GET_LINE_IOCTL
+  int cdev_fd;                  // Line request fd, -1 if sysfs backend
+  int cdev_idx[N_PINS];         // Index of each pin function in the line request, -1 if unused
+  int cdev_nlines;
+  char cdev_chip[64];
+#endif
+};
+
+#define PDATA(pgm) ((struct pdata *)(pgm->cookie))
+
+#ifdef GPIO_V2_GET_LINE_IOCTL
+
+/*
+ * GPIO character device backend, selected with -P /dev/gpiochipN: all
+ * programmer pins are requested as lines of a single line request, so
+ * that several pins can be changed with one GPIO_V2_LINE_SET_VALUES_IOCTL
+ */
+
+static int linuxgpio_cdev_set(const PROGRAMMER *pgm, unsigned long long mask, unsigned long long bits) {
+  struct gpio_v2_line_values val;
+
+  val.mask = mask;
+  val.bits = bits;
+  return ioctl(PDATA(pgm)->cdev_fd, GPIO_V2_LINE_SET_VALUES_IOCTL, &val);
+}
+
+// Line mask and value bits for setting pin function pinfunc to value
+static unsigned long long linuxgpio_cdev_bits(const PROGRAMMER *pgm, int pinfunc, int value,
+                                              unsigned long long *mask) {
+  int idx = PDATA(pgm)->cdev_idx[pinfunc];
+
+  if (idx < 0)
+    return 0;
+  if (pgm->pinno[pinfunc] & PIN_INVERSE)
+    value = !value;
+  *mask |= 1ULL << idx;
+
+  return (unsigned long long) !!value << idx;
+}
+
+static int linuxgpio_cdev_setpin(const PROGRAMMER *pgm, int pinfunc, int value) {
+  unsigned long long mask = 0, bits;
+
+  bits = linuxgpio_cdev_bits(pgm, pinfunc, value, &mask);
+  if (!mask)
+    return -1;
+
+  if (linuxgpio_cdev_set(pgm, mask, bits) < 0)
+    return -1;
+
+  if (pgm->ispdelay > 1)
+    bitbang_delay(pgm->ispdelay);
+
+  return 0;
+}
+
+static int linuxgpio_cdev_getpin(const PROGRAMMER *pgm, int pinfunc) {
+  struct gpio_v2_line_values val;
+  int idx = PDATA(pgm)->cdev_idx[pinfunc];
+
+  if (idx < 0)
+    return -1;
+
+  val.mask = 1ULL << idx;
+  if (ioctl(PDATA(pgm)->cdev_fd, GPIO_V2_LINE_GET_VALUES_IOCTL, &val) < 0)
+    return -1;
+
+  return !!(val.bits & val.mask) ^ !!(pgm->pinno[pinfunc] & PIN_INVERSE);
+}
+
+static int linuxgpio_cdev_highpulsepin(const PROGRAMMER *pgm, int pinfunc) {
+  if (PDATA(pgm)->cdev_idx[pinfunc] < 0)
+    return -1;
+
+  linuxgpio_cdev_setpin(pgm, pinfunc, 1);
+  linuxgpio_cdev_setpin(pgm, pinfunc, 0);
+
+  return 0;
+}
+
+/*
+ * Transmit and receive a byte on SPI mode 0; MOSI changes together with
+ * the falling SCK edge of the previous bit, so each bit costs two set
+ * and one get ioctl
+ */
+static unsigned char linuxgpio_cdev_txrx(const PROGRAMMER *pgm, unsigned char byte) {
+  unsigned long long mask, bits, sckmask = 0, sckhi;
+  unsigned char rbyte = 0;
+  int i, r;
+
+  sckhi = linuxgpio_cdev_bits(pgm, PIN_AVR_SCK, 1, &sckmask);
+  for (i = 7; i >= 0; i--) {
+    mask = 0;
+    bits = linuxgpio_cdev_bits(pgm, PIN_AVR_SCK, 0, &mask);
+    bits |= linuxgpio_cdev_bits(pgm, PIN_AVR_MOSI, (byte >> i) & 1, &mask);
+    linuxgpio_cdev_set(pgm, mask, bits);
+    if (pgm->ispdelay > 1)
+      bitbang_delay(pgm->ispdelay);
+
+    linuxgpio_cdev_set(pgm, sckmask, sckhi);
+    if (pgm->ispdelay > 1)
+      bitbang_delay(pgm->ispdelay);
+
+    r = linuxgpio_cdev_getpin(pgm, PIN_AVR_MISO);
+    rbyte |= (r > 0) << i;
+  }
+  linuxgpio_cdev_setpin(pgm, PIN_AVR_SCK, 0);
+
+  return rbyte;
+}
+
+static int linuxgpio_cdev_spi(const PROGRAMMER *pgm, const unsigned char *cmd,
+                              unsigned char *res, int count) {
+  int i;
+
+  pgm->setpin(pgm, PIN_LED_PGM, 0);
+  for (i = 0; i < count; i++)
+    res[i] = linuxgpio_cdev_txrx(pgm, cmd[i]);
+  pgm->setpin(pgm, PIN_LED_PGM, 1);
+
+  return 0;
+}
+
+static int linuxgpio_cdev_cmd(const PROGRAMMER *pgm, const unsigned char *cmd,
+                              unsigned char *res) {
+  int i;
+
+  for (i = 0; i < 4; i++)
+    res[i] = linuxgpio_cdev_txrx(pgm, cmd[i]);
+
+  avrdude_message(MSG_NOTICE2, "linuxgpio_cdev_cmd(): [ %02X %02X %02X %02X ] [ %02X %02X %02X %02X ]\n",
+                  cmd[0], cmd[1], cmd[2], cmd[3], res[0], res[1], res[2], res[3]);
+
+  return 0;
+}
+
+static int linuxgpio_cdev_open(PROGRAMMER *pgm, const char *port) {
+  struct gpio_v2_line_request req;
+  int i, j, fd, ret, pin;
+
+  if (strncmp(port, "/dev/", 5) == 0)
+    snprintf(PDATA(pgm)->cdev_chip, sizeof PDATA(pgm)->cdev_chip, "%s", port);
+  else
+    snprintf(PDATA(pgm)->cdev_chip, sizeof PDATA(pgm)->cdev_chip, "/dev/%s", port);
+
+  if ((fd = open(PDATA(pgm)->cdev_chip, O_RDWR)) < 0) {
+    avrdude_message(MSG_INFO, "%s: error: unable to open %s: %s\n",
+                    progname, PDATA(pgm)->cdev_chip, strerror(errno));
+    return -1;
+  }
+
+  memset(&req, 0, sizeof req);
+  strncpy(req.consumer, progname, sizeof req.consumer - 1);
+  req.config.flags = GPIO_V2_LINE_FLAG_OUTPUT;
+  req.config.num_attrs = 1;
+  req.config.attrs[0].attr.id = GPIO_V2_LINE_ATTR_ID_FLAGS;
+  req.config.attrs[0].attr.flags = GPIO_V2_LINE_FLAG_INPUT;
+
+  // Same pin selection as the sysfs backend, see linuxgpio_open()
+  PDATA(pgm)->cdev_nlines = 0;
+  for (i = 0; i < N_PINS; i++) {
+    PDATA(pgm)->cdev_idx[i] = -1;
+    if ((pgm->pinno[i] & PIN_MASK) == 0 && i != PIN_AVR_RESET && i != PIN_AVR_SCK &&
+        i != PIN_AVR_MOSI && i != PIN_AVR_MISO)
+      continue;
+
+    pin = pgm->pinno[i] & PIN_MASK;
+    for (j = 0; j < PDATA(pgm)->cdev_nlines; j++)
+      if (req.offsets[j] == (unsigned) pin)
+        break;
+    if (j == PDATA(pgm)->cdev_nlines) {
+      if (j >= GPIO_V2_LINES_MAX) {
+        avrdude_message(MSG_INFO, "%s: error: too many GPIO lines\n", progname);
+        close(fd);
+        return -1;
+      }
+      req.offsets[PDATA(pgm)->cdev_nlines++] = pin;
+    }
+    PDATA(pgm)->cdev_idx[i] = j;
+    if (i == PIN_AVR_MISO)
+      req.config.attrs[0].mask |= 1ULL << j;
+  }
+  req.num_lines = PDATA(pgm)->cdev_nlines;
+
+  ret = ioctl(fd, GPIO_V2_GET_LINE_IOCTL, &req);
+  close(fd);
+  if (ret < 0) {
+    avrdude_message(MSG_INFO, "%s: error: unable to request GPIO lines of %s, already busy?: %s\n",
+                    progname, PDATA(pgm)->cdev_chip, strerror(errno));
+    return -1;
+  }
+  PDATA(pgm)->cdev_fd = req.fd;
+
+  return 0;
+}
+
+static void linuxgpio_cdev_close(PROGRAMMER *pgm) {
+  struct gpio_v2_line_config cfg;
+  unsigned long long all = (1ULL << PDATA(pgm)->cdev_nlines) - 1, rstmask = 0, rstbits;
+  int rst = PDATA(pgm)->cdev_idx[PIN_AVR_RESET];
+
+  // First release all pins as input except RESET, which keeps its level; then RESET
+  memset(&cfg, 0, sizeof cfg);
+  cfg.flags = GPIO_V2_LINE_FLAG_INPUT;
+  if (rst >= 0) {
+    struct gpio_v2_line_values val;
+
+    val.mask = rstmask = 1ULL << rst;
+    rstbits = ioctl(PDATA(pgm)->cdev_fd, GPIO_V2_LINE_GET_VALUES_IOCTL, &val) < 0? 0: val.bits;
+    cfg.num_attrs = 2;
+    cfg.attrs[0].attr.id = GPIO_V2_LINE_ATTR_ID_FLAGS;
+    cfg.attrs[0].attr.flags = GPIO_V2_LINE_FLAG_OUTPUT;
+    cfg.attrs[0].mask = rstmask;
+    cfg.attrs[1].attr.id = GPIO_V2_LINE_ATTR_ID_OUTPUT_VALUES;
+    cfg.attrs[1].attr.values = rstbits;
+    cfg.attrs[1].mask = rstmask;
+    if (all != rstmask)
+      ioctl(PDATA(pgm)->cdev_fd, GPIO_V2_LINE_SET_CONFIG_IOCTL, &cfg);
+  }
+  memset(&cfg, 0, sizeof cfg);
+  cfg.flags = GPIO_V2_LINE_FLAG_INPUT;
+  ioctl(PDATA(pgm)->cdev_fd, GPIO_V2_LINE_SET_CONFIG_IOCTL, &cfg);
+
+  close(PDATA(pgm)->cdev_fd);
+  PDATA(pgm)->cdev_fd = -1;
+}
+
+// Port names the character device backend
+static int linuxgpio_is_cdev(const char *port) {
+  const char *p = strncmp(port, "/dev/", 5) == 0? port + 5: port;
+
+  return strncmp(p, "gpiochip", 8) == 0;
+}
+
+#endif /* GPIO_V2_GET_LINE_IOCTL */
 
 
 static int linuxgpio_setpin(const PROGRAMMER *pgm, int pinfunc, int value) {
@@ -154,13 +393,13 @@ static int linuxgpio_setpin(const PROGRAMMER *pgm, int pinfunc, int value) {
     pin   &= PIN_MASK;
   }
 
-  if ( linuxgpio_fds[pin] < 0 )
+  if ( PDATA(pgm)->fds[pin] < 0 )
     return -1;
 
   if (value)
-    r = write(linuxgpio_fds[pin], "1", 1);
+    r = write(PDATA(pgm)->fds[pin], "1", 1);
   else
-    r = write(linuxgpio_fds[pin], "0", 1);
+    r = write(PDATA(pgm)->fds[pin], "0", 1);
 
   if (r!=1) return -1;
 
@@ -181,13 +420,13 @@ static int linuxgpio_getpin(const PROGRAMMER *pgm, int pinfunc) {
     pin   &= PIN_MASK;
   }
 
-  if ( linuxgpio_fds[pin] < 0 )
+  if ( PDATA(pgm)->fds[pin] < 0 )
     return -1;
 
-  if (lseek(linuxgpio_fds[pin], 0, SEEK_SET)<0)
+  if (lseek(PDATA(pgm)->fds[pin], 0, SEEK_SET)<0)
     return -1;
 
-  if (read(linuxgpio_fds[pin], &c, 1)!=1)
+  if (read(PDATA(pgm)->fds[pin], &c, 1)!=1)
     return -1;
 
   if (c=='0')
@@ -201,7 +440,7 @@ static int linuxgpio_getpin(const PROGRAMMER *pgm, int pinfunc) {
 static int linuxgpio_highpulsepin(const PROGRAMMER *pgm, int pinfunc) {
   int pin = pgm->pinno[pinfunc]; // TODO
   
-  if ( linuxgpio_fds[pin & PIN_MASK] < 0 )
+  if ( PDATA(pgm)->fds[pin & PIN_MASK] < 0 )
     return -1;
 
   linuxgpio_setpin(pgm, pinfunc, 1);
@@ -212,8 +451,28 @@ static int linuxgpio_highpulsepin(const PROGRAMMER *pgm, int pinfunc) {
 
 
 
+static void linuxgpio_setup(PROGRAMMER *pgm) {
+  pgm->cookie = cfg_malloc("linuxgpio_setup()", sizeof(struct pdata));
+  for (int i = 0; i < N_GPIO; i++)
+    PDATA(pgm)->fds[i] = -1;
+#ifdef GPIO_V2_GET_LINE_IOCTL
+  PDATA(pgm)->cdev_fd = -1;
+#endif
+}
+
+static void linuxgpio_teardown(PROGRAMMER *pgm) {
+  free(pgm->cookie);
+  pgm->cookie = NULL;
+}
+
 static void linuxgpio_display(const PROGRAMMER *pgm, const char *p) {
-    avrdude_message(MSG_INFO, "%sPin assignment  : /sys/class/gpio/gpio{n}\n",p);
+#ifdef GPIO_V2_GET_LINE_IOCTL
+    if (PDATA(pgm)->cdev_fd >= 0)
+      avrdude_message(MSG_INFO, "%sPin assignment  : %s line {n}\n", p, PDATA(pgm)->cdev_chip);
+    else
+#endif
+      avrdude_message(MSG_INFO, "%sPin assignment  : /sys/class/gpio/gpio{n}\n",p);
+
     pgm_display_generic_mask(pgm, p, SHOW_AVR_PINS);
 }
 
@@ -239,9 +498,21 @@ static int linuxgpio_open(PROGRAMMER *pgm, const char *port) {
   if (bitbang_check_prerequisites(pgm) < 0)
     return -1;
 
+#ifdef GPIO_V2_GET_LINE_IOCTL
+  if (linuxgpio_is_cdev(port)) {
+    if (linuxgpio_cdev_open(pgm, port) < 0)
+      return -1;
+    pgm->setpin = linuxgpio_cdev_setpin;
+    pgm->getpin = linuxgpio_cdev_getpin;
+    pgm->highpulsepin = linuxgpio_cdev_highpulsepin;
+    pgm->cmd    = linuxgpio_cdev_cmd;
+    pgm->spi    = linuxgpio_cdev_spi;
+    return 0;
+  }
+#endif
 
   for (i=0; i<N_GPIO; i++)
-    linuxgpio_fds[i] = -1;
+    PDATA(pgm)->fds[i] = -1;
   //Avrdude assumes that if a pin number is 0 it means not used/available
   //this causes a problem because 0 is a valid GPIO number in Linux sysfs.
   //To avoid annoying off by one pin numbering we assume SCK, MOSI, MISO 
@@ -270,8 +541,8 @@ static int linuxgpio_open(PROGRAMMER *pgm, const char *port) {
         if (r < 0)
             return r;
 
-        if ((linuxgpio_fds[pin]=linuxgpio_openfd(pin)) < 0)
-            return linuxgpio_fds[pin];
+        if ((PDATA(pgm)->fds[pin]=linuxgpio_openfd(pin)) < 0)
+            return PDATA(pgm)->fds[pin];
     }
   }
 
@@ -282,20 +553,27 @@ static void linuxgpio_close(PROGRAMMER *pgm)
 {
   int i, reset_pin;
 
+#ifdef GPIO_V2_GET_LINE_IOCTL
+  if (PDATA(pgm)->cdev_fd >= 0) {
+    linuxgpio_cdev_close(pgm);
+    return;
+  }
+#endif
+
   reset_pin = pgm->pinno[PIN_AVR_RESET] & PIN_MASK;
 
   //first configure all pins as input, except RESET
   //this should avoid possible conflicts when AVR firmware starts
   for (i=0; i<N_GPIO; i++) {
-    if (linuxgpio_fds[i] >= 0 && i != reset_pin) {
-       close(linuxgpio_fds[i]);
+    if (PDATA(pgm)->fds[i] >= 0 && i != reset_pin) {
+       close(PDATA(pgm)->fds[i]);
        linuxgpio_dir_in(i);
        linuxgpio_unexport(i);
     }
   }
   //configure RESET as input, if there's external pull up it will go high
-  if (linuxgpio_fds[reset_pin] >= 0) {
-    close(linuxgpio_fds[reset_pin]);
+  if (PDATA(pgm)->fds[reset_pin] >= 0) {
+    close(PDATA(pgm)->fds[reset_pin]);
     linuxgpio_dir_in(reset_pin);
     linuxgpio_unexport(reset_pin);
   }
@@ -320,6 +598,7 @@ void linuxgpio_initpgm(PROGRAMMER *pgm) {
   pgm->chip_erase     = bitbang_chip_erase;
   pgm->cmd            = bitbang_cmd;
   pgm->cmd_tpi        = bitbang_cmd_tpi;
+  pgm->spi            = bitbang_spi;
   pgm->open           = linuxgpio_open;
   pgm->close          = linuxgpio_close;
   pgm->setpin         = linuxgpio_setpin;
@@ -327,9 +606,13 @@ void linuxgpio_initpgm(PROGRAMMER *pgm) {
   pgm->highpulsepin   = linuxgpio_highpulsepin;
   pgm->read_byte      = avr_read_byte_default;
   pgm->write_byte     = avr_write_byte_default;
+  pgm->paged_load     = avr_spi_paged_load;
+  pgm->paged_write    = avr_spi_paged_write;
+  pgm->setup          = linuxgpio_setup;
+  pgm->teardown       = linuxgpio_teardown;
 }
 
-const char linuxgpio_desc[] = "GPIO bitbanging using the Linux sysfs interface";
+const char linuxgpio_desc[] = "GPIO bitbanging using the Linux sysfs or GPIO chardev interface";
 
 #else  /* !HAVE_LINUXGPIO */
 
@@ -62,7 +62,23 @@
 
 #define LINUXSPI "linuxspi"
 
-static int fd_spidev, fd_gpiochip, fd_linehandle;
+/*
+ * spidev rejects messages whose total length exceeds its bufsiz module
+ * parameter; the number of segments is bounded by the ioctl size field
+ */
+#define LINUXSPI_BUFSIZ_PARAM "/sys/module/spidev/parameters/bufsiz"
+#define LINUXSPI_BUFSIZ_DEFAULT 4096
+#define LINUXSPI_MAX_SEGS (((1 << _IOC_SIZEBITS) - 1) / sizeof(struct spi_ioc_transfer))
+
+/*
+ * Private data for this programmer
+ */
+struct pdata {
+    int fd_spidev, fd_gpiochip, fd_linehandle;
+    unsigned int spidev_bufsiz;
+};
+
+#define PDATA(pgm) ((struct pdata *)(pgm->cookie))
 
 /**
  * @brief Sends/receives a message in full duplex mode
@@ -81,17 +97,69 @@ static int linuxspi_spi_duplex(const PROGRAMMER *pgm, const unsigned char *tx, u
         .bits_per_word = 8,
     };
 
-    ret = ioctl(fd_spidev, SPI_IOC_MESSAGE(1), &tr);
+    ret = ioctl(PDATA(pgm)->fd_spidev, SPI_IOC_MESSAGE(1), &tr);
     if (ret != len)
         avrdude_message(MSG_INFO, "\n%s: error: Unable to send SPI message\n", progname);
 
     return (ret == -1) ? -1 : 0;
 }
 
+/**
+ * @brief Sends/receives nseg 4-byte ISP commands as one multi-segment message
+ * @return -1 on failure, otherwise 0
+ */
+static int linuxspi_spi_segments(const PROGRAMMER *pgm, const unsigned char *tx, unsigned char *rx, int nseg) {
+    struct spi_ioc_transfer *tr;
+    int i, ret;
+
+    tr = cfg_malloc("linuxspi_spi_segments()", nseg * sizeof(*tr));
+    for (i = 0; i < nseg; i++)
+        tr[i] = (struct spi_ioc_transfer) {
+            .tx_buf = (unsigned long)(tx + 4*i),
+            .rx_buf = (unsigned long)(rx + 4*i),
+            .len = 4,
+            .delay_usecs = 1,
+            .speed_hz = 1.0 / pgm->bitclock, // seconds to Hz
+            .bits_per_word = 8,
+        };
+
+    ret = ioctl(PDATA(pgm)->fd_spidev, SPI_IOC_MESSAGE(nseg), tr);
+    if (ret != 4*nseg)
+        avrdude_message(MSG_INFO, "\n%s: error: Unable to send SPI message\n", progname);
+    free(tr);
+
+    return (ret == -1) ? -1 : 0;
+}
+
+/* Max number of 4-byte commands in one message */
+static unsigned int linuxspi_max_cmds(const PROGRAMMER *pgm) {
+    unsigned int n = PDATA(pgm)->spidev_bufsiz / 4;
+
+    return n < LINUXSPI_MAX_SEGS? n: LINUXSPI_MAX_SEGS;
+}
+
+static void linuxspi_read_bufsiz(const PROGRAMMER *pgm) {
+    FILE *f = fopen(LINUXSPI_BUFSIZ_PARAM, "r");
+    unsigned int n;
+
+    PDATA(pgm)->spidev_bufsiz = LINUXSPI_BUFSIZ_DEFAULT;
+    if (f) {
+        if (fscanf(f, "%u", &n) == 1 && n >= 16)
+            PDATA(pgm)->spidev_bufsiz = n;
+        fclose(f);
+    }
+    avrdude_message(MSG_DEBUG, "%s: spidev max message size %u bytes\n", progname, PDATA(pgm)->spidev_bufsiz);
+}
+
 static void linuxspi_setup(PROGRAMMER *pgm) {
+    pgm->cookie = cfg_malloc("linuxspi_setup()", sizeof(struct pdata));
+    PDATA(pgm)->fd_spidev = PDATA(pgm)->fd_gpiochip = PDATA(pgm)->fd_linehandle = -1;
+    PDATA(pgm)->spidev_bufsiz = LINUXSPI_BUFSIZ_DEFAULT;
 }
 
 static void linuxspi_teardown(PROGRAMMER* pgm) {
+    free(pgm->cookie);
+    pgm->cookie = NULL;
 }
 
 static int linuxspi_reset_mcu(const PROGRAMMER *pgm, bool active) {
@@ -103,7 +171,7 @@ static int linuxspi_reset_mcu(const PROGRAMMER *pgm, bool active) {
      * its initial value, once the fd_gpiochip is closed.
      */
     data.values[0] = active ^ !(pgm->pinno[PIN_AVR_RESET] & PIN_INVERSE);
-    ret = ioctl(fd_linehandle, GPIOHANDLE_SET_LINE_VALUES_IOCTL, &data);
+    ret = ioctl(PDATA(pgm)->fd_linehandle, GPIOHANDLE_SET_LINE_VALUES_IOCTL, &data);
 #ifdef GPIO_V2_LINE_SET_VALUES_IOCTL
     if (ret == -1) {
         struct gpio_v2_line_values val;
@@ -111,7 +179,7 @@ static int linuxspi_reset_mcu(const PROGRAMMER *pgm, bool active) {
         val.mask = 1;
         val.bits = active ^ !(pgm->pinno[PIN_AVR_RESET] & PIN_INVERSE);
 
-        ret = ioctl(fd_linehandle, GPIO_V2_LINE_SET_VALUES_IOCTL, &val);
+        ret = ioctl(PDATA(pgm)->fd_linehandle, GPIO_V2_LINE_SET_VALUES_IOCTL, &val);
     }
 #endif
     if (ret == -1) {
@@ -156,21 +224,23 @@ static int linuxspi_open(PROGRAMMER *pgm, const char *pt) {
         pgm->pinno[PIN_AVR_RESET] = strtoul(reset_pin, NULL, 0);
 
     strcpy(pgm->port, port);
-    fd_spidev = open(pgm->port, O_RDWR);
-    if (fd_spidev < 0) {
+    PDATA(pgm)->fd_spidev = open(pgm->port, O_RDWR);
+    if (PDATA(pgm)->fd_spidev < 0) {
         avrdude_message(MSG_INFO, "\n%s: error: Unable to open the spidev device %s", progname, pgm->port);
         return -1;
     }
 
+    linuxspi_read_bufsiz(pgm);
+
     uint32_t mode = SPI_MODE_0 | SPI_NO_CS;
-    ret = ioctl(fd_spidev, SPI_IOC_WR_MODE32, &mode);
+    ret = ioctl(PDATA(pgm)->fd_spidev, SPI_IOC_WR_MODE32, &mode);
     if (ret == -1) {
         avrdude_message(MSG_INFO, "%s: error: Unable to set SPI mode %0X on %s\n",
                         progname, mode, spidev);
         goto close_spidev;
     }
-    fd_gpiochip = open(gpiochip, 0);
-    if (fd_gpiochip < 0) {
+    PDATA(pgm)->fd_gpiochip = open(gpiochip, 0);
+    if (PDATA(pgm)->fd_gpiochip < 0) {
         avrdude_message(MSG_INFO, "\n%s error: Unable to open the gpiochip %s", progname, gpiochip);
         ret = -1;
         goto close_spidev;
@@ -182,9 +252,9 @@ static int linuxspi_open(PROGRAMMER *pgm, const char *pt) {
     req.default_values[0] = !!(pgm->pinno[PIN_AVR_RESET] & PIN_INVERSE);
     req.flags = GPIOHANDLE_REQUEST_OUTPUT;
 
-    ret = ioctl(fd_gpiochip, GPIO_GET_LINEHANDLE_IOCTL, &req);
+    ret = ioctl(PDATA(pgm)->fd_gpiochip, GPIO_GET_LINEHANDLE_IOCTL, &req);
     if (ret != -1)
-        fd_linehandle = req.fd;
+        PDATA(pgm)->fd_linehandle = req.fd;
 #ifdef GPIO_V2_GET_LINE_IOCTL
     if (ret == -1) {
         struct gpio_v2_line_request reqv2;
@@ -199,9 +269,9 @@ static int linuxspi_open(PROGRAMMER *pgm, const char *pt) {
         reqv2.config.attrs[0].mask = 1;
         reqv2.num_lines = 1;
 
-        ret = ioctl(fd_gpiochip, GPIO_V2_GET_LINE_IOCTL, &reqv2);
+        ret = ioctl(PDATA(pgm)->fd_gpiochip, GPIO_V2_GET_LINE_IOCTL, &reqv2);
         if (ret != -1)
-            fd_linehandle = reqv2.fd;
+            PDATA(pgm)->fd_linehandle = reqv2.fd;
     }
 #endif
     if (ret == -1) {
@@ -231,11 +301,11 @@ static int linuxspi_open(PROGRAMMER *pgm, const char *pt) {
     return 0;
 
 close_out:
-    close(fd_linehandle);
+    close(PDATA(pgm)->fd_linehandle);
 close_gpiochip:
-    close(fd_gpiochip);
+    close(PDATA(pgm)->fd_gpiochip);
 close_spidev:
-    close(fd_spidev);
+    close(PDATA(pgm)->fd_spidev);
     return ret;
 }
 
@@ -253,9 +323,9 @@ static void linuxspi_close(PROGRAMMER *pgm) {
         break;
     }
 
-    close(fd_linehandle);
-    close(fd_spidev);
-    close(fd_gpiochip);
+    close(PDATA(pgm)->fd_linehandle);
+    close(PDATA(pgm)->fd_spidev);
+    close(PDATA(pgm)->fd_gpiochip);
 }
 
 static void linuxspi_disable(const PROGRAMMER* pgm) {
@@ -296,6 +366,154 @@ static int linuxspi_cmd(const PROGRAMMER *pgm, const unsigned char *cmd, unsigne
     return linuxspi_spi_duplex(pgm, cmd, res, 4);
 }
 
+static int linuxspi_spi(const PROGRAMMER *pgm, const unsigned char *cmd, unsigned char *res, int count)
+{
+    return linuxspi_spi_duplex(pgm, cmd, res, count);
+}
+
+/*
+ * Set up a LOAD_EXT_ADDR command in cmd if the memory needs one;
+ * returns the number of commands set up (0 or 1)
+ */
+static int linuxspi_ext_addr_cmd(const AVRMEM *mem, unsigned char *cmd, unsigned long addr) {
+    OPCODE *lext = mem->op[AVR_OP_LOAD_EXT_ADDR];
+
+    if (lext == NULL)
+        return 0;
+
+    memset(cmd, 0, 4);
+    avr_set_bits(lext, cmd);
+    avr_set_addr(lext, cmd, addr);
+    return 1;
+}
+
+/*
+ * Read n_bytes with one SPI message per chunk: the extended address
+ * command (if any) followed by one READ command per byte
+ */
+static int linuxspi_paged_load(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *mem,
+                               unsigned int page_size, unsigned int addr, unsigned int n_bytes) {
+    unsigned char *cmd, *res;
+    unsigned int i, n, chunk;
+    int wordaddr, rc = 0;
+    OPCODE *readop;
+
+    wordaddr = mem->op[AVR_OP_READ_LO] != NULL;
+    if (wordaddr? !mem->op[AVR_OP_READ_HI]: !mem->op[AVR_OP_READ])
+        return -1;
+
+    if (n_bytes == 0)
+        return 0;
+
+    chunk = linuxspi_max_cmds(pgm) - 1;
+    if (chunk > n_bytes)
+        chunk = n_bytes;
+    cmd = cfg_malloc("linuxspi_paged_load()", 4*chunk + 4);
+    res = cfg_malloc("linuxspi_paged_load()", 4*chunk + 4);
+
+    pgm->pgm_led(pgm, ON);
+    pgm->err_led(pgm, OFF);
+
+    for (i = 0; i < n_bytes; i += n) {
+        unsigned long a = addr + i;
+        int ne;
+
+        n = n_bytes - i < chunk? n_bytes - i: chunk;
+        // A chunk shares one extended address, so never straddles a 64 k word boundary
+        if (wordaddr && (a + n-1)/2 >> 16 != a/2 >> 16)
+            n = 2*(((a/2 >> 16) + 1) << 16) - a;
+
+        ne = linuxspi_ext_addr_cmd(mem, cmd, wordaddr? a/2: a);
+        memset(cmd + 4*ne, 0, 4*n);
+        for (unsigned int k = 0; k < n; k++) {
+            readop = !wordaddr? mem->op[AVR_OP_READ]: (a+k) & 1? mem->op[AVR_OP_READ_HI]: mem->op[AVR_OP_READ_LO];
+            avr_set_bits(readop, cmd + 4*(ne+k));
+            avr_set_addr(readop, cmd + 4*(ne+k), wordaddr? (a+k)/2: a+k);
+        }
+        if ((rc = linuxspi_spi_segments(pgm, cmd, res, ne + n)) < 0)
+            break;
+        for (unsigned int k = 0; k < n; k++) {
+            readop = !wordaddr? mem->op[AVR_OP_READ]: (a+k) & 1? mem->op[AVR_OP_READ_HI]: mem->op[AVR_OP_READ_LO];
+            mem->buf[a+k] = 0;
+            avr_get_output(readop, res + 4*(ne+k), mem->buf + a+k);
+        }
+    }
+
+    pgm->pgm_led(pgm, OFF);
+    free(cmd);
+    free(res);
+
+    return rc < 0? -1: (int) n_bytes;
+}
+
+/*
+ * Write n_bytes page by page, each page as a single SPI message of the
+ * LOADPAGE commands, the extended address command (if any) and WRITEPAGE;
+ * pages too large for one spidev message go through the generic routine
+ */
+static int linuxspi_paged_write(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *mem,
+                                unsigned int page_size, unsigned int addr, unsigned int n_bytes) {
+    unsigned char *cmd, *res;
+    unsigned int i, n;
+    int wordaddr, rc = 0;
+    OPCODE *loadop, *wp = mem->op[AVR_OP_WRITEPAGE];
+
+    if (wp == NULL || !mem->op[AVR_OP_LOADPAGE_LO])
+        return -1;
+
+    wordaddr = mem->op[AVR_OP_READ_LO] != NULL;
+    if (wordaddr && (!mem->paged || !mem->op[AVR_OP_LOADPAGE_HI]))
+        return -1;
+
+    if (page_size == 0 || page_size > (unsigned) mem->page_size)
+        page_size = mem->page_size;
+    if (page_size + 2 > linuxspi_max_cmds(pgm))
+        return avr_spi_paged_write(pgm, p, mem, page_size, addr, n_bytes);
+    if (n_bytes == 0)
+        return 0;
+
+    cmd = cfg_malloc("linuxspi_paged_write()", 4*page_size + 8);
+    res = cfg_malloc("linuxspi_paged_write()", 4*page_size + 8);
+
+    pgm->pgm_led(pgm, ON);
+    pgm->err_led(pgm, OFF);
+
+    for (i = 0; i < n_bytes; i += n) {
+        unsigned long a = addr + i, pageaddr = a - a % page_size;
+        int nc;
+
+        n = pageaddr + page_size - a;
+        if (n > n_bytes - i)
+            n = n_bytes - i;
+
+        memset(cmd, 0, 4*n);
+        for (unsigned int k = 0; k < n; k++) {
+            loadop = !wordaddr? mem->op[AVR_OP_LOADPAGE_LO]:
+                (a+k) & 1? mem->op[AVR_OP_LOADPAGE_HI]: mem->op[AVR_OP_LOADPAGE_LO];
+            avr_set_bits(loadop, cmd + 4*k);
+            avr_set_addr(loadop, cmd + 4*k, wordaddr? (a+k)/2: a+k);
+            avr_set_input(loadop, cmd + 4*k, mem->buf[a+k]);
+        }
+        nc = n + linuxspi_ext_addr_cmd(mem, cmd + 4*n, wordaddr? pageaddr/2: pageaddr);
+        memset(cmd + 4*nc, 0, 4);
+        avr_set_bits(wp, cmd + 4*nc);
+        avr_set_addr(wp, cmd + 4*nc, wordaddr? pageaddr/2: pageaddr);
+        if ((rc = linuxspi_spi_segments(pgm, cmd, res, nc + 1)) < 0)
+            break;
+
+        if ((rc = avr_spi_poll_ready(pgm, p, mem, a, n)) < 0)
+            break;
+    }
+
+    pgm->pgm_led(pgm, OFF);
+    if (rc < 0)
+        pgm->err_led(pgm, ON);
+    free(cmd);
+    free(res);
+
+    return rc < 0? -1: (int) n_bytes;
+}
+
 static int linuxspi_program_enable(const PROGRAMMER *pgm, const AVRPART *p) {
     unsigned char cmd[4], res[4];
 
@@ -391,10 +609,13 @@ void linuxspi_initpgm(PROGRAMMER *pgm) {
     pgm->program_enable = linuxspi_program_enable;
     pgm->chip_erase     = linuxspi_chip_erase;
     pgm->cmd            = linuxspi_cmd;
+    pgm->spi            = linuxspi_spi;
     pgm->open           = linuxspi_open;
     pgm->close          = linuxspi_close;
     pgm->read_byte      = avr_read_byte_default;
     pgm->write_byte     = avr_write_byte_default;
+    pgm->paged_load     = linuxspi_paged_load;
+    pgm->paged_write    = linuxspi_paged_write;
 
     /* optional functions */
     pgm->setup          = linuxspi_setup;
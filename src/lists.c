@@ -1282,7 +1282,8 @@ lsrch ( LISTID lid, void * p, int (* compare)(void * p1, void * p2) )
 /*----------------------------------------------------------------------
 |  lsort
 |
-|  sort list - sorts list inplace (using bubble sort)
+|  sort list - sorts list inplace (using a stable merge sort of the
+|  data pointers, or a bubble sort if no memory is available for that)
 |
  ----------------------------------------------------------------------*/
 void
@@ -1292,11 +1293,41 @@ lsort ( LISTID lid, int (* compare)(void * p1, void * p2) )
   LISTNODE * lt; /* this */
   LISTNODE * ln; /* next */
   int unsorted = 1;
+  void ** a, ** b, ** t;
+  int n, w, i, lo, mid, hi, j, k;
 
   l = (LIST *)lid;
 
   CKLMAGIC(l);
 
+  n = l->num;
+  a = n > 1 ? MALLOC(2 * n * sizeof(void *), "lsort") : NULL;
+  if (a != NULL) {
+    b = a + n;
+    for (i = 0, lt = l->top; lt != NULL; lt = lt->next) {
+      CKMAGIC(lt);
+      a[i++] = lt->data;
+    }
+
+    /* bottom-up merge of runs of width w from a into b */
+    for (w = 1; w < n; w *= 2) {
+      for (lo = 0; lo < n; lo += 2 * w) {
+        mid = lo + w < n ? lo + w : n;
+        hi = lo + 2 * w < n ? lo + 2 * w : n;
+        for (i = lo, j = lo, k = mid; i < hi; i++)
+          b[i] = k >= hi || (j < mid && compare(a[j], a[k]) <= 0) ? a[j++] : a[k++];
+      }
+      t = a; a = b; b = t;
+    }
+
+    for (i = 0, lt = l->top; lt != NULL; lt = lt->next)
+      lt->data = a[i++];
+
+    FREE(a < b ? a : b);
+    CKLMAGIC(l);
+    return;
+  }
+
   while(unsorted){
     lt = l->top;
     unsorted = 0;
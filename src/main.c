@@ -45,6 +45,9 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <sys/time.h>
+#if !defined(WIN32)
+#include <sys/wait.h>
+#endif
 
 #include "avrdude.h"
 #include "libavrdude.h"
@@ -85,6 +88,17 @@ static LISTID extended_params = NULL;
 
 static LISTID additional_config_files = NULL;
 
+/*
+ * -c/-P pairs of the command line; with -g (gang mode) the same
+ * operations are carried out on every target, otherwise the last -P wins
+ */
+typedef struct {
+  char *programmer;             /* -c in force for this -P, NULL for the default */
+  char *port;
+} GANG_TARGET;
+
+static LISTID gang_targets = NULL;
+
 static PROGRAMMER * pgm;
 
 /*
@@ -111,9 +125,11 @@ static void usage(void)
  "  -C <config-file>           Specify location of configuration file.\n"
  "  -c <programmer>            Specify programmer type.\n"
  "  -A                         Disable trailing-0xff removal from file and AVR read.\n"
+ "  -d                         Only write pages that differ from the device; implies -A.\n"
  "  -D                         Disable auto erase for flash memory; implies -A.\n"
  "  -i <delay>                 ISP Clock Delay [in microseconds]\n"
  "  -P <port>                  Specify connection port.\n"
+ "  -g                         Gang mode: program the targets of all -P in parallel.\n"
  "  -F                         Override invalid signature check.\n"
  "  -e                         Perform a chip erase.\n"
  "  -O                         Perform RC oscillator calibration (see AVR053). \n"
@@ -160,6 +176,7 @@ static void list_programmers(FILE * f, const char *prefix, LISTID programmers)
     c.f = f;
     c.prefix = prefix;
 
+    complete_config();
     sort_programmers(programmers);
 
     walk_programmers(programmers, list_programmers_callback, &c);
@@ -209,6 +226,7 @@ static void list_parts(FILE * f, const char *prefix, LISTID avrparts)
     c.f = f;
     c.prefix = prefix;
 
+    complete_config();
     sort_avrparts(avrparts);
 
     walk_avrparts(avrparts, list_avrparts_callback, &c);
@@ -234,6 +252,10 @@ static void cleanup_main(void)
         ldestroy(additional_config_files);
         additional_config_files = NULL;
     }
+    if (gang_targets) {
+        ldestroy_cb(gang_targets, free);
+        gang_targets = NULL;
+    }
 
     cleanup_config();
 }
@@ -256,6 +278,72 @@ static int dev_opt(char *str) {
     !!strchr(str, '/');
 }
 
+/*
+ * Gang mode: once the configuration has been parsed, fork one avrdude
+ * process per -c/-P target; each child carries on with the usual
+ * programming sequence on its own programmer, while the parent waits for
+ * all of them and reports the outcome per target. Timeouts, progress
+ * reporting and some backends still use process-wide variables, which
+ * rules out threads. Returns only in a child, with *programmer and *port
+ * set for its target; the parent exits with 1 if any target failed.
+ */
+#if !defined(WIN32)
+static void gang_run(char **programmer, char **port) {
+  static char gangname[PATH_MAX/2]; // Leaves room for the progbuf margin
+  int n = lsize(gang_targets), i, nfail = 0, status;
+  pid_t *pids = cfg_malloc("gang_run()", n*sizeof*pids);
+  GANG_TARGET *gt;
+  LNODEID ln;
+
+  for (ln = lfirst(gang_targets), i = 0; ln; ln = lnext(ln), i++) {
+    gt = ldata(ln);
+    fflush(stdout);
+    fflush(stderr);
+    if ((pids[i] = fork()) == 0) {
+      if (gt->programmer)
+        *programmer = gt->programmer;
+      *port = gt->port;
+      // Tag all messages of this target with its port
+      snprintf(gangname, sizeof gangname, "%s[%s]", progname, gt->port);
+      progname = gangname;
+      memset(progbuf, ' ', strlen(progname) + 2);
+      progbuf[strlen(progname) + 2] = 0;
+      free(pids);
+      return;
+    }
+    if (pids[i] < 0)
+      avrdude_message(MSG_INFO, "%s: cannot start gang target %s: %s\n",
+                      progname, gt->port, strerror(errno));
+  }
+
+  for (ln = lfirst(gang_targets), i = 0; ln; ln = lnext(ln), i++) {
+    gt = ldata(ln);
+    status = -1;
+    if (pids[i] > 0)
+      while (waitpid(pids[i], &status, 0) < 0 && errno == EINTR)
+        continue;
+    if (status != 0)
+      nfail++;
+    avrdude_message(MSG_INFO, "%s: gang target %d (-c %s -P %s): %s",
+                    progname, i+1, gt->programmer? gt->programmer: *programmer, gt->port,
+                    status == 0? "OK\n": "FAILED");
+    if (status != 0) {
+      if (status == -1)
+        avrdude_message(MSG_INFO, " (not started)\n");
+      else if (WIFEXITED(status))
+        avrdude_message(MSG_INFO, " (exit code %d)\n", WEXITSTATUS(status));
+      else
+        avrdude_message(MSG_INFO, " (signal %d)\n", WIFSIGNALED(status)? WTERMSIG(status): 0);
+    }
+  }
+
+  avrdude_message(MSG_INFO, "%s: %d of %d gang target%s programmed successfully\n",
+                  progname, n - nfail, n, update_plural(n));
+  free(pids);
+  exit(nfail? 1: 0);
+}
+#endif
+
 
 /*
  * main routine
@@ -279,11 +367,17 @@ int main(int argc, char * argv [])
   int     calibrate;   /* 1=calibrate RC oscillator, 0=don't */
   char  * port;        /* device port (/dev/xxx) */
   int     terminal;    /* 1=enter terminal mode, 0=don't */
+  int     gang;        /* 1=program all -P targets in parallel, 0=last -P wins */
   const char *exitspecs; /* exit specs string from command line */
   char  * programmer;  /* programmer id */
+  char  * cmdline_programmer = NULL; /* last -c so far, for gang mode -P */
   char  * partdesc;    /* part id */
   char    sys_config[PATH_MAX]; /* system wide config file */
   char    usr_config[PATH_MAX]; /* per-user config file */
+  char    cache_file[PATH_MAX]; /* binary cache of the parsed config files */
+  LISTID  cfgfiles;    /* config files in the order they are read */
+  LISTID  pgmids;      /* programmer ids needed from the config files */
+  bool    cache_ok;    /* configuration was loaded from cache_file */
   char    executable_abspath[PATH_MAX]; /* absolute path to avrdude executable */
   char    executable_dirpath[PATH_MAX]; /* absolute path to folder with executable */
   bool    executable_abspath_found = false; /* absolute path to executable found */
@@ -354,6 +448,12 @@ int main(int argc, char * argv [])
     exit(1);
   }
 
+  gang_targets = lcreat(NULL, 0);
+  if (gang_targets == NULL) {
+    avrdude_message(MSG_INFO, "%s: cannot initialize gang target list\n", progname);
+    exit(1);
+  }
+
   partdesc      = NULL;
   port          = NULL;
   erase         = 0;
@@ -361,6 +461,7 @@ int main(int argc, char * argv [])
   p             = NULL;
   ovsigck       = 0;
   terminal      = 0;
+  gang          = 0;
   quell_progress = 0;
   exitspecs     = NULL;
   pgm           = NULL;
@@ -389,7 +490,7 @@ int main(int argc, char * argv [])
   /*
    * process command line arguments
    */
-  while ((ch = getopt(argc,argv,"?Ab:B:c:C:DeE:Fi:l:np:OP:qstU:uvVx:yY:")) != -1) {
+  while ((ch = getopt(argc,argv,"?Ab:B:c:C:dDeE:Fgi:l:np:OP:qstU:uvVx:yY:")) != -1) {
 
     switch (ch) {
       case 'b': /* override default programmer baud rate */
@@ -461,7 +562,11 @@ int main(int argc, char * argv [])
         break;
 
       case 'c': /* programmer id */
-        programmer = optarg;
+        programmer = cmdline_programmer = optarg;
+        /* -P options that preceded the first -c use it, too */
+        for (ln = lfirst(gang_targets); ln; ln = lnext(ln))
+          if (((GANG_TARGET *) ldata(ln))->programmer == NULL)
+            ((GANG_TARGET *) ldata(ln))->programmer = optarg;
         break;
 
       case 'C': /* system wide configuration file */
@@ -473,6 +578,11 @@ int main(int argc, char * argv [])
         }
         break;
 
+      case 'd': /* differential write, skip unchanged pages */
+        uflags |= UF_DIFFERENTIAL;
+        disable_trailing_ff_removal();
+        break;
+
       case 'D': /* disable auto erase */
         uflags &= ~UF_AUTO_ERASE;
         /* fall through */
@@ -494,6 +604,10 @@ int main(int argc, char * argv [])
         ovsigck = 1;
         break;
 
+      case 'g': /* gang mode */
+        gang = 1;
+        break;
+
       case 'l':
 	logfile = optarg;
 	break;
@@ -510,9 +624,13 @@ int main(int argc, char * argv [])
         partdesc = optarg;
         break;
 
-      case 'P':
-        port = optarg;
+      case 'P': {
+        GANG_TARGET *gt = cfg_malloc("main()", sizeof *gt);
+        gt->programmer = cmdline_programmer;
+        gt->port = port = optarg;
+        ladd(gang_targets, gt);
         break;
+      }
 
       case 'q' : /* Quell progress output */
         quell_progress++ ;
@@ -686,6 +804,7 @@ int main(int argc, char * argv [])
    * -----------
    * Determine the location of '.avrduderc'.
    */
+  cache_file[0] = 0;
 #if defined(WIN32)
   win_usr_config_set(usr_config);
 #else
@@ -696,7 +815,9 @@ int main(int argc, char * argv [])
     i = strlen(usr_config);
     if (i && (usr_config[i - 1] != '/'))
       strcat(usr_config, "/");
+    strcpy(cache_file, usr_config);
     strcat(usr_config, USER_CONF_FILE);
+    strcat(cache_file, CONFIG_CACHE_FILE);
   }
 #endif
 
@@ -714,7 +835,33 @@ int main(int argc, char * argv [])
   avrdude_message(MSG_NOTICE, "%sSystem wide configuration file is \"%s\"\n",
             progbuf, sys_config);
 
-  rc = read_config(sys_config);
+  /*
+   * Use the cached result of parsing the config files if it is up to
+   * date, loading only the part and programmers asked for; developer
+   * options need all entries with their comments, which are not cached
+   */
+  cfgfiles = lcreat(NULL, 0);
+  ladd(cfgfiles, sys_config);
+  if (usr_config[0] != 0 && stat(usr_config, &sb) == 0 && (sb.st_mode & S_IFREG))
+    ladd(cfgfiles, usr_config);
+  for (LNODEID ln1 = lfirst(additional_config_files); ln1; ln1 = lnext(ln1))
+    ladd(cfgfiles, ldata(ln1));
+  pgmids = lcreat(NULL, 0);
+  ladd(pgmids, programmer);
+  for (LNODEID ln1 = lfirst(gang_targets); gang && ln1; ln1 = lnext(ln1))
+    if (((GANG_TARGET *) ldata(ln1))->programmer)
+      ladd(pgmids, ((GANG_TARGET *) ldata(ln1))->programmer);
+  cfg_keep_comments = dev_opt(programmer) || dev_opt(partdesc);
+  if (cfg_keep_comments)
+    cache_file[0] = 0;
+  // Without -p no part is needed: main() lists them all via complete_config()
+  cache_ok = cache_file[0] != 0 &&
+    read_config_cache(cache_file, cfgfiles, partdesc? partdesc: "", pgmids) == 0;
+  if (cache_ok)
+    avrdude_message(MSG_NOTICE2, "%sUsing configuration cache \"%s\"\n", progbuf, cache_file);
+  ldestroy(pgmids);
+
+  rc = cache_ok? 0: read_config(sys_config);
   if (rc) {
     avrdude_message(MSG_INFO, "%s: error reading system wide configuration file \"%s\"\n",
                     progname, sys_config);
@@ -731,7 +878,7 @@ int main(int argc, char * argv [])
                       "regular file, skipping\n",
                       progbuf);
     }
-    else {
+    else if (!cache_ok) {
       rc = read_config(usr_config);
       if (rc) {
         avrdude_message(MSG_INFO, "%s: error reading user configuration file \"%s\"\n",
@@ -750,7 +897,7 @@ int main(int argc, char * argv [])
       avrdude_message(MSG_NOTICE, "%sAdditional configuration file is \"%s\"\n",
                       progbuf, p);
 
-      rc = read_config(p);
+      rc = cache_ok? 0: read_config(p);
       if (rc) {
         avrdude_message(MSG_INFO, "%s: error reading additional configuration file \"%s\"\n",
                         progname, p);
@@ -759,6 +906,14 @@ int main(int argc, char * argv [])
     }
   }
 
+  if (!cache_ok && cache_file[0] != 0)
+    write_config_cache(cache_file, cfgfiles);
+  ldestroy(cfgfiles);
+
+  // Hash indexes for locate_part(), locate_programmer() etc.
+  avr_index_parts(part_list);
+  pgm_index_programmers(programmers);
+
   // set bitclock from configuration files unless changed by command line
   if (default_bitclock > 0 && bitclock == 0.0) {
     bitclock = default_bitclock;
@@ -812,6 +967,32 @@ int main(int argc, char * argv [])
     exit(1);
   }
 
+  if (gang) {
+#if defined(WIN32)
+    avrdude_message(MSG_INFO, "%s: gang mode (-g) needs fork() and is not supported on Windows\n",
+                    progname);
+    exit(1);
+#else
+    if (lsize(gang_targets) == 0) {
+      avrdude_message(MSG_INFO, "%s: gang mode (-g) requires at least one -P option\n",
+                      progname);
+      exit(1);
+    }
+    if (terminal) {
+      avrdude_message(MSG_INFO, "%s: terminal mode cannot be used in gang mode (-g)\n",
+                      progname);
+      exit(1);
+    }
+    for (ln=lfirst(updates); ln; ln=lnext(ln))
+      if (((UPDATE *) ldata(ln))->op == DEVICE_READ) {
+        avrdude_message(MSG_INFO, "%s: -U read operations cannot be used in gang mode (-g)\n",
+                        progname);
+        exit(1);
+      }
+    gang_run(&programmer, &port);
+#endif
+  }
+
   pgm = locate_programmer(programmers, programmer);
   if (pgm == NULL) {
     avrdude_message(MSG_INFO, "\n");
@@ -1146,6 +1327,7 @@ int main(int argc, char * argv [])
       if (quell_progress < 2) {
         AVRPART * part;
 
+        complete_config();
         part = locate_part_by_signature(part_list, sig->buf, sig->size);
         if (part) {
           avrdude_message(MSG_INFO, " (probably %s)", signature_matches ? p->id : part->id);
@@ -1200,6 +1382,26 @@ int main(int argc, char * argv [])
                         "%sTo disable page erases, specify the -D option; for a chip-erase, use the -e option.\n",
                         progname, progbuf, progbuf);
       }
+    } else if (uflags & UF_DIFFERENTIAL) {
+      if (quell_progress < 2 && lsize(updates) > 0) {
+        avrdude_message(MSG_INFO, "%s: NOTE: differential write requested, pages that already match the input\n"
+                        "%sare skipped and the chip is only erased if changed pages need it\n",
+                        progname, progbuf);
+      }
+      // Decide on a chip erase once before any update is carried out
+      if (init_ok && !(uflags & UF_NOWRITE) && lsize(updates) > 0) {
+        rc = update_diff_needs_erase(pgm, p, updates);
+        if (rc < 0) {
+          exitrc = 1;
+          goto main_exit;
+        }
+        if (rc > 0) {
+          erase = 1;
+          if (quell_progress < 2)
+            avrdude_message(MSG_INFO, "%s: NOTE: changed pages need erasing, an erase cycle will be performed\n",
+                            progname);
+        }
+      }
     } else {
       AVRMEM * m;
       const char *memname = p->prog_modes & PM_PDI? "application": "flash";
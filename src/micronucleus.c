@@ -45,6 +45,7 @@
 #include <errno.h>
 #include <unistd.h>
 #include <time.h>
+#include <sys/time.h>
 #include "avrdude.h"
 #include "micronucleus.h"
 #include "usbdevs.h"
@@ -65,6 +66,7 @@
 #define MICRONUCLEUS_PID 0x0753
 
 #define MICRONUCLEUS_CONNECT_WAIT 100
+#define MICRONUCLEUS_POLL_INTERVAL 10
 
 #define MICRONUCLEUS_CMD_INFO 0
 #define MICRONUCLEUS_CMD_TRANSFER 1
@@ -102,6 +104,14 @@ typedef struct pdata
     uint16_t user_reset_vector; // reset vector of user program
     bool write_last_page;       // last page already programmed
     bool start_program;         // require start after flash
+    bool write_pending;         // page write in progress until write_done
+    struct timeval write_done;
+    bool erased;                // device erased, all-0xFF pages need not be written
+    // Statistics
+    uint16_t pages_written;
+    uint16_t pages_skipped;
+    long transfer_us;           // time spent transferring page data
+    long wait_us;               // time spent waiting for page writes and erase
 } pdata_t;
 
 //-----------------------------------------------------------------------------
@@ -111,6 +121,30 @@ static void delay_ms(uint32_t duration)
     usleep(duration * 1000);
 }
 
+static long usec_since(const struct timeval* start)
+{
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    return (now.tv_sec - start->tv_sec) * 1000000L + (now.tv_usec - start->tv_usec);
+}
+
+// The device does not respond on USB while it programs a page; wait for the last write to finish
+static void micronucleus_wait_write(pdata_t* pdata)
+{
+    if (!pdata->write_pending)
+        return;
+    pdata->write_pending = false;
+
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    long remaining = (pdata->write_done.tv_sec - now.tv_sec) * 1000000L + (pdata->write_done.tv_usec - now.tv_usec);
+    if (remaining > 0)
+    {
+        usleep(remaining);
+        pdata->wait_us += remaining;
+    }
+}
+
 static int micronucleus_check_connection(pdata_t* pdata)
 {
     if (pdata->major_version >= 2)
@@ -139,6 +173,25 @@ static int micronucleus_check_connection(pdata_t* pdata)
     }
 }
 
+// The device does not answer USB requests while it erases; ask for its info until it does
+static int micronucleus_poll_ready(pdata_t* pdata, uint32_t max_duration)
+{
+    struct timeval start;
+    gettimeofday(&start, NULL);
+
+    do
+    {
+        delay_ms(MICRONUCLEUS_POLL_INTERVAL);
+        if (micronucleus_check_connection(pdata) >= 0)
+        {
+            avrdude_message(MSG_DEBUG, "%s: Device ready after %ldms\n", progname, usec_since(&start) / 1000);
+            return 0;
+        }
+    } while (usec_since(&start) < max_duration * 1000L);
+
+    return -1;
+}
+
 static bool micronucleus_is_device_responsive(pdata_t* pdata, struct usb_device* device)
 {
     pdata->usb_handle = usb_open(device);
@@ -316,6 +369,12 @@ static int micronucleus_erase_device(pdata_t* pdata)
 {
     avrdude_message(MSG_DEBUG, "%s: micronucleus_erase_device()\n", progname);
 
+    micronucleus_wait_write(pdata);
+    pdata->erased = false;
+
+    struct timeval start;
+    gettimeofday(&start, NULL);
+
     int result = usb_control_msg(
         pdata->usb_handle,
         USB_ENDPOINT_OUT | USB_TYPE_VENDOR | USB_RECIP_DEVICE,
@@ -337,9 +396,17 @@ static int micronucleus_erase_device(pdata_t* pdata)
         }
     }
 
-    delay_ms(pdata->erase_sleep);
-
-    result = micronucleus_check_connection(pdata);
+    if (pdata->major_version >= 2)
+    {
+        // Protocol v2 acknowledges the command before erasing and answers again once done
+        result = micronucleus_poll_ready(pdata, pdata->erase_sleep);
+    }
+    else
+    {
+        delay_ms(pdata->erase_sleep);
+        result = micronucleus_check_connection(pdata);
+    }
+    pdata->wait_us += usec_since(&start);
     if (result < 0)
     {
         avrdude_message(MSG_NOTICE, "%s: Connection dropped, trying to reconnect...\n", progname);
@@ -352,6 +419,7 @@ static int micronucleus_erase_device(pdata_t* pdata)
         }
     }
 
+    pdata->erased = true;
     return 0;
 }
 
@@ -478,6 +546,8 @@ static int micronucleus_write_page(pdata_t* pdata, uint32_t address, uint8_t* bu
 {
     avrdude_message(MSG_DEBUG, "%s: micronucleus_write_page(address=0x%04X, size=%d)\n", progname, address, size);
 
+    micronucleus_wait_write(pdata);
+
     if (address == 0)
     {
         if (pdata->major_version >= 2)
@@ -506,6 +576,9 @@ static int micronucleus_write_page(pdata_t* pdata, uint32_t address, uint8_t* bu
         pdata->write_last_page = false;
     }
 
+    struct timeval start;
+    gettimeofday(&start, NULL);
+
     int result;
     if (pdata->major_version >= 2)
     {
@@ -516,12 +589,23 @@ static int micronucleus_write_page(pdata_t* pdata, uint32_t address, uint8_t* bu
         result = micronucleus_write_page_v1(pdata, address, buffer, size);
     }
 
+    pdata->transfer_us += usec_since(&start);
     if (result < 0)
     {
         return result;
     }
+    pdata->pages_written++;
 
-    delay_ms(pdata->write_sleep);
+    // Completes in the background, see micronucleus_wait_write()
+    gettimeofday(&pdata->write_done, NULL);
+    pdata->write_done.tv_sec += pdata->write_sleep / 1000;
+    pdata->write_done.tv_usec += pdata->write_sleep % 1000 * 1000L;
+    if (pdata->write_done.tv_usec >= 1000000L)
+    {
+        pdata->write_done.tv_sec++;
+        pdata->write_done.tv_usec -= 1000000L;
+    }
+    pdata->write_pending = true;
 
     return 0;
 }
@@ -530,6 +614,8 @@ static int micronucleus_start(pdata_t* pdata)
 {
     avrdude_message(MSG_DEBUG, "%s: micronucleus_start()\n", progname);
 
+    micronucleus_wait_write(pdata);
+
     int result = usb_control_msg(
         pdata->usb_handle,
         USB_ENDPOINT_OUT | USB_TYPE_VENDOR | USB_RECIP_DEVICE,
@@ -602,6 +688,7 @@ static void micronucleus_powerdown(const PROGRAMMER *pgm) {
         {
             memset(buffer, 0xFF, pdata->page_size);
             micronucleus_write_page(pdata, pdata->bootloader_start - pdata->page_size, buffer, pdata->page_size);
+            micronucleus_wait_write(pdata);
             free(buffer);
         }
     }
@@ -812,6 +899,13 @@ static void micronucleus_close(PROGRAMMER* pgm)
     avrdude_message(MSG_DEBUG, "%s: micronucleus_close()\n", progname);
 
     pdata_t* pdata = PDATA(pgm);
+    micronucleus_wait_write(pdata);
+    if (pdata->pages_written > 0 || pdata->pages_skipped > 0)
+    {
+        avrdude_message(MSG_NOTICE, "%s: %u pages written, %u erased pages skipped, %ldms transferring, %ldms waiting for device\n",
+            progname, pdata->pages_written, pdata->pages_skipped, pdata->transfer_us / 1000, pdata->wait_us / 1000);
+    }
+
     if (pdata->usb_handle != NULL)
     {
         usb_close(pdata->usb_handle);
@@ -857,13 +951,23 @@ static int micronucleus_paged_load(const PROGRAMMER *pgm, const AVRPART *p, cons
     return -1;
 }
 
-static int micronucleus_paged_write(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *mem,
+static bool micronucleus_is_blank(const uint8_t* buffer, size_t size)
+{
+    for (size_t i = 0; i < size; i++)
+    {
+        if (buffer[i] != 0xFF)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Write pages; the write of the last page is still in progress on return
+static int micronucleus_write_pages(const PROGRAMMER *pgm, const AVRMEM *mem,
     unsigned int page_size,
     unsigned int addr, unsigned int n_bytes)
 {
-    avrdude_message(MSG_DEBUG, "%s: micronucleus_paged_write(page_size=0x%X, addr=0x%X, n_bytes=0x%X)\n",
-        progname, page_size, addr, n_bytes);
-
     if (strcmp(mem->desc, "flash") == 0)
     {
         pdata_t* pdata = PDATA(pgm);
@@ -896,6 +1000,17 @@ static int micronucleus_paged_write(const PROGRAMMER *pgm, const AVRPART *p, con
             memcpy(page_buffer, mem->buf + addr, chunk_size);
             memset(page_buffer + chunk_size, 0xFF, pdata->page_size - chunk_size);
 
+            // Pages left blank after an erase need not be sent, except the first
+            // and last ones that carry the patched reset and user vectors.
+            if (pdata->erased && addr != 0 && addr < pdata->bootloader_start - pdata->page_size &&
+                micronucleus_is_blank(page_buffer, pdata->page_size))
+            {
+                pdata->pages_skipped++;
+                addr += chunk_size;
+                n_bytes -= chunk_size;
+                continue;
+            }
+
             result = micronucleus_write_page(pdata, addr, page_buffer, pdata->page_size);
             if (result < 0)
             {
@@ -916,6 +1031,18 @@ static int micronucleus_paged_write(const PROGRAMMER *pgm, const AVRPART *p, con
     }
 }
 
+static int micronucleus_paged_write(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *mem,
+    unsigned int page_size,
+    unsigned int addr, unsigned int n_bytes)
+{
+    avrdude_message(MSG_DEBUG, "%s: micronucleus_paged_write(page_size=0x%X, addr=0x%X, n_bytes=0x%X)\n",
+        progname, page_size, addr, n_bytes);
+
+    // The write_sleep of the last page runs out while avrdude prepares the
+    // next one; it is waited for only before the next USB request
+    return micronucleus_write_pages(pgm, mem, page_size, addr, n_bytes);
+}
+
 static int micronucleus_parseextparams(const PROGRAMMER *pgm, const LISTID xparams) {
     avrdude_message(MSG_DEBUG, "%s: micronucleus_parseextparams()\n", progname);
 
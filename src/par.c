@@ -386,6 +386,8 @@ void par_initpgm(PROGRAMMER *pgm) {
   pgm->parseexitspecs = par_parseexitspecs;
   pgm->read_byte      = avr_read_byte_default;
   pgm->write_byte     = avr_write_byte_default;
+  pgm->paged_load     = avr_spi_paged_load;
+  pgm->paged_write    = avr_spi_paged_write;
 }
 
 #else  /* !HAVE_PARPORT */
@@ -82,6 +82,7 @@ PROGRAMMER *pgm_new(void) {
   pgm->initpgm = NULL;
   pgm->lineno = 0;
   pgm->baudrate = 0;
+  pgm->serdev = &serial_serdev;
 
   // Clear pin array
   for(int i=0; i<N_PINS; i++) {
@@ -127,6 +128,7 @@ PROGRAMMER *pgm_new(void) {
   pgm->paged_write    = NULL;
   pgm->paged_load     = NULL;
   pgm->page_erase     = NULL;
+  pgm->mem_crc        = NULL;
   pgm->write_setup    = NULL;
   pgm->read_sig_bytes = NULL;
   pgm->read_sib       = NULL;
@@ -267,10 +269,76 @@ void pgm_display_generic(const PROGRAMMER *pgm, const char *p) {
   pgm_display_generic_mask(pgm, p, SHOW_ALL_PINS);
 }
 
+/*
+ * Hash index of a programmer list for locate_programmer(): one entry per
+ * programmer id, chained in list order so that lookups return the same
+ * (first) match as a list walk
+ */
+static struct {
+  LISTID list;                  // Indexed list, NULL if none
+  int n, nb;                    // Number of entries, number of buckets
+  PROGRAMMER **pgm;             // Programmer of each entry
+  const char **id;              // Id of each entry
+  int *head, *next;             // Hash chains of entries
+} gidx;
+
+/*
+ * Build the hash index of the programmer list programmers, replacing any
+ * previous index; a NULL list drops the index. The list must not change
+ * while it is indexed: call again after modifying or sorting it.
+ */
+void pgm_index_programmers(LISTID programmers) {
+  LNODEID ln, ln2;
+  int e;
+
+  free(gidx.pgm);
+  free(gidx.id);
+  free(gidx.head);
+  free(gidx.next);
+  memset(&gidx, 0, sizeof gidx);
+
+  if(!programmers)
+    return;
+
+  gidx.list = programmers;
+  for(ln = lfirst(programmers); ln; ln = lnext(ln))
+    gidx.n += lsize(((PROGRAMMER *) ldata(ln))->id);
+  for(gidx.nb = 16; gidx.nb < 2*gidx.n; gidx.nb *= 2)
+    continue;
+
+  gidx.pgm = cfg_malloc("pgm_index_programmers()", (gidx.n+1)*sizeof*gidx.pgm);
+  gidx.id = cfg_malloc("pgm_index_programmers()", (gidx.n+1)*sizeof*gidx.id);
+  gidx.head = cfg_malloc("pgm_index_programmers()", gidx.nb*sizeof(int));
+  gidx.next = cfg_malloc("pgm_index_programmers()", (gidx.n+1)*sizeof(int));
+  for(int h = 0; h < gidx.nb; h++)
+    gidx.head[h] = -1;
+
+  e = 0;
+  for(ln = lfirst(programmers); ln; ln = lnext(ln))
+    for(ln2 = lfirst(((PROGRAMMER *) ldata(ln))->id); ln2; ln2 = lnext(ln2)) {
+      gidx.pgm[e] = ldata(ln);
+      gidx.id[e++] = ldata(ln2);
+    }
+
+  // Add in reverse order so that chains are in list order
+  while(--e >= 0) {
+    unsigned h = strcasehash(gidx.id[e]) & (gidx.nb-1);
+    gidx.next[e] = gidx.head[h];
+    gidx.head[h] = e;
+  }
+}
+
 PROGRAMMER *locate_programmer(const LISTID programmers, const char *configid) {
   PROGRAMMER *p = NULL;
   int found = 0;
 
+  if(programmers && programmers == gidx.list) {
+    for(int e = gidx.head[strcasehash(configid) & (gidx.nb-1)]; e >= 0; e = gidx.next[e])
+      if(strcasecmp(configid, gidx.id[e]) == 0)
+        return gidx.pgm[e];
+    return NULL;
+  }
+
   for(LNODEID ln1=lfirst(programmers); ln1 && !found; ln1=lnext(ln1)) {
     p = ldata(ln1);
     for(LNODEID ln2=lfirst(p->id); ln2 && !found; ln2=lnext(ln2))
@@ -321,5 +389,7 @@ static int sort_programmer_compare(const PROGRAMMER *p1, const PROGRAMMER *p2) {
 void sort_programmers(LISTID programmers)
 {
   lsort(programmers,(int (*)(void*, void*)) sort_programmer_compare);
+  if(programmers == gidx.list)  // Keep first-match order of the index
+    pgm_index_programmers(programmers);
 }
 
@@ -774,6 +774,4 @@ struct serial_device serial_serdev =
   .flags = SERDEV_FL_CANSETSPEED,
 };
 
-struct serial_device *serdev = &serial_serdev;
-
 #endif /* WIN32 */
@@ -344,6 +344,7 @@ void serbb_initpgm(PROGRAMMER *pgm) {
   pgm->chip_erase     = bitbang_chip_erase;
   pgm->cmd            = bitbang_cmd;
   pgm->cmd_tpi        = bitbang_cmd_tpi;
+  pgm->spi            = bitbang_spi;
   pgm->open           = serbb_open;
   pgm->close          = serbb_close;
   pgm->setpin         = serbb_setpin;
@@ -351,6 +352,8 @@ void serbb_initpgm(PROGRAMMER *pgm) {
   pgm->highpulsepin   = serbb_highpulsepin;
   pgm->read_byte      = avr_read_byte_default;
   pgm->write_byte     = avr_write_byte_default;
+  pgm->paged_load     = avr_spi_paged_load;
+  pgm->paged_write    = avr_spi_paged_write;
 }
 
 #endif  /* WIN32 */
@@ -178,6 +178,8 @@ static void serialupdi_close(PROGRAMMER * pgm)
 {
   avrdude_message(MSG_INFO, "%s: Leaving NVM programming mode\n", progname);
 
+  updi_nvm_report_timing(pgm);
+
   if (serialupdi_leave_progmode(pgm) < 0) {
     avrdude_message(MSG_INFO, "%s: Unable to leave NVM programming mode\n", progname);
   }
@@ -645,6 +647,15 @@ static int serialupdi_initialize(const PROGRAMMER *pgm, const AVRPART *p) {
     return -1;
   }
 
+  if (updi_get_turbo_baud(pgm)) {
+    long baud = updi_link_turbo(pgm, updi_get_turbo_baud(pgm));
+    if (baud < 0) {
+      avrdude_message(MSG_INFO, "%s: UPDI link speed negotiation failed\n", progname);
+      return -1;
+    }
+    avrdude_message(MSG_INFO, "%s: UPDI link running at %ld baud\n", progname, baud);
+  }
+
   avrdude_message(MSG_INFO, "%s: Entering NVM programming mode\n", progname);
     /* try, but ignore failure */
   serialupdi_enter_progmode(pgm);
@@ -885,8 +896,12 @@ static int serialupdi_chip_erase(const PROGRAMMER *pgm, const AVRPART *p) {
 static int serialupdi_page_erase(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *m,
                                  unsigned int baseaddr)
 {
-  avrdude_message(MSG_INFO, "%s: error: page erase not implemented yet\n",
-    	    progname);
+  if (strcmp(m->desc, "flash") == 0)
+    return updi_nvm_erase_flash_page(pgm, p, m->offset + baseaddr);
+  if (strcmp(m->desc, "eeprom") == 0)
+    return 0;             /* page writes to EEPROM erase the page, nothing to do */
+  avrdude_message(MSG_INFO, "%s: error: page erase not implemented for memory \"%s\"\n",
+    	    progname, m->desc);
   return -1;
 }
 
@@ -925,6 +940,8 @@ static int serialupdi_parseextparms(const PROGRAMMER *pgm, const LISTID extparms
   LNODEID ln;
   const char *extended_param;
   char rts_mode[5];
+  long turbo_baud;
+  int updi_clock;
   int rv = 0;
 
   for (ln = lfirst(extparms); ln; ln = lnext(ln)) {
@@ -942,6 +959,29 @@ static int serialupdi_parseextparms(const PROGRAMMER *pgm, const LISTID extparms
       continue;
     }
 
+    if (strcmp(extended_param, "turbo") == 0) {
+      updi_set_turbo_baud(pgm, 460800);
+      continue;
+    }
+
+    if (sscanf(extended_param, "turbo=%ld", &turbo_baud) == 1) {
+      if (turbo_baud <= 0) {
+        avrdude_message(MSG_INFO, "%s: turbo baud rate must be positive\n", progname);
+        return -1;
+      }
+      updi_set_turbo_baud(pgm, turbo_baud);
+      continue;
+    }
+
+    if (sscanf(extended_param, "updiclk=%d", &updi_clock) == 1) {
+      if (updi_clock != 4 && updi_clock != 8 && updi_clock != 16) {
+        avrdude_message(MSG_INFO, "%s: UPDI clock must be 4, 8 or 16 MHz\n", progname);
+        return -1;
+      }
+      updi_set_updi_clock(pgm, updi_clock);
+      continue;
+    }
+
     avrdude_message(MSG_INFO, "%s: serialupdi_parseextparms(): invalid extended parameter '%s'\n",
                     progname, extended_param);
     rv = -1;
@@ -51,14 +51,14 @@ static void stk500_print_parms1(const PROGRAMMER *pgm, const char *p);
 
 
 static int stk500_send(const PROGRAMMER *pgm, unsigned char *buf, size_t len) {
-  return serial_send(&pgm->fd, buf, len);
+  return serial_send(pgm, &pgm->fd, buf, len);
 }
 
 
 static int stk500_recv(const PROGRAMMER *pgm, unsigned char *buf, size_t len) {
   int rv;
 
-  rv = serial_recv(&pgm->fd, buf, len);
+  rv = serial_recv(pgm, &pgm->fd, buf, len);
   if (rv < 0) {
     avrdude_message(MSG_INFO, "%s: stk500_recv(): programmer is not responding\n",
                     progname);
@@ -69,7 +69,7 @@ static int stk500_recv(const PROGRAMMER *pgm, unsigned char *buf, size_t len) {
 
 
 int stk500_drain(const PROGRAMMER *pgm, int display) {
-  return serial_drain(&pgm->fd, display);
+  return serial_drain(pgm, &pgm->fd, display);
 }
 
 
@@ -98,9 +98,9 @@ int stk500_getsync(const PROGRAMMER *pgm) {
   for (attempt = 0; attempt < max_sync_attempts; attempt++) {
     // Restart Arduino bootloader for every sync attempt
     if (strcmp(pgm->type, "Arduino") == 0 && attempt > 0) {
-      serial_set_dtr_rts(&pgm->fd, 0); // Set DTR and RTS low
+      serial_set_dtr_rts(pgm, &pgm->fd, 0); // Set DTR and RTS low
       usleep(250*1000);
-      serial_set_dtr_rts(&pgm->fd, 1); // Set DTR and RTS back to high
+      serial_set_dtr_rts(pgm, &pgm->fd, 1); // Set DTR and RTS back to high
       usleep(50*1000);
       stk500_drain(pgm, 0);
     }
@@ -675,7 +675,7 @@ static int stk500_open(PROGRAMMER *pgm, const char *port) {
   strcpy(pgm->port, port);
   pinfo.serialinfo.baud = pgm->baudrate? pgm->baudrate: 115200;
   pinfo.serialinfo.cflags = SERIAL_8N1;
-  if (serial_open(port, pinfo, &pgm->fd)==-1) {
+  if (serial_open(pgm, port, pinfo, &pgm->fd)==-1) {
     return -1;
   }
 
@@ -702,7 +702,7 @@ static void stk500_close(PROGRAMMER * pgm)
   if (strcmp(ldata(lfirst(pgm->id)), "mib510") == 0)
     (void)mib510_isp(pgm, 0);
 
-  serial_close(&pgm->fd);
+  serial_close(pgm, &pgm->fd);
   pgm->fd.ifd = -1;
 }
 
@@ -381,7 +381,7 @@ b2_to_u16(unsigned char *b)
 }
 
 static int stk500v2_send_mk2(const PROGRAMMER *pgm, unsigned char *data, size_t len) {
-  if (serial_send(&pgm->fd, data, len) != 0) {
+  if (serial_send(pgm, &pgm->fd, data, len) != 0) {
     avrdude_message(MSG_INFO, "%s: stk500_send_mk2(): failed to send command to serial port\n",progname);
     return -1;
   }
@@ -500,7 +500,7 @@ static int stk500v2_send(const PROGRAMMER *pgm, unsigned char *data, size_t len)
     DEBUG("0x%02x ", buf[i]);
   DEBUG(", %d)\n", (int) len+6);
 
-  if (serial_send(&pgm->fd, buf, len+6) != 0) {
+  if (serial_send(pgm, &pgm->fd, buf, len+6) != 0) {
     avrdude_message(MSG_INFO, "%s: stk500_send(): failed to send command to serial port\n",progname);
     return -1;
   }
@@ -510,7 +510,7 @@ static int stk500v2_send(const PROGRAMMER *pgm, unsigned char *data, size_t len)
 
 
 int stk500v2_drain(const PROGRAMMER *pgm, int display) {
-  return serial_drain(&pgm->fd, display);
+  return serial_drain(pgm, &pgm->fd, display);
 }
 
 static int stk500v2_recv_mk2(const PROGRAMMER *pgm, unsigned char *msg,
@@ -518,7 +518,7 @@ static int stk500v2_recv_mk2(const PROGRAMMER *pgm, unsigned char *msg,
 {
   int rv;
 
-  rv = serial_recv(&pgm->fd, msg, maxsize);
+  rv = serial_recv(pgm, &pgm->fd, msg, maxsize);
   if (rv < 0) {
     avrdude_message(MSG_INFO, "%s: stk500v2_recv_mk2: error in USB receive\n", progname);
     return -1;
@@ -604,12 +604,17 @@ static int stk500v2_jtag3_recv(const PROGRAMMER *pgm, unsigned char *msg,
   return rv;
 }
 
+/*
+ * Receive a message framed as MESSAGE_START, sequence number, two size
+ * bytes (MSB first), TOKEN, data and an XOR checksum over all of these.
+ * The five header bytes and then the data plus checksum are each read
+ * with one serial_recv() call rather than one call per byte; bytes are
+ * only dropped one by one while hunting for the start of a frame.
+ */
 static int stk500v2_recv(const PROGRAMMER *pgm, unsigned char *msg, size_t maxsize) {
-  enum states { sINIT, sSTART, sSEQNUM, sSIZE1, sSIZE2, sTOKEN, sDATA, sCSUM, sDONE }  state = sSTART;
-  unsigned int msglen = 0;
-  unsigned int curlen = 0;
-  int timeout = 0;
-  unsigned char c, checksum = 0;
+  unsigned char hdr[5], csum, checksum;
+  unsigned int msglen, i;
+  int n, f;
 
   /*
    * The entire timeout handling here is not very consistent, see
@@ -633,91 +638,78 @@ static int stk500v2_recv(const PROGRAMMER *pgm, unsigned char *msg, size_t maxsi
   gettimeofday(&tv, NULL);
   tstart = tv.tv_sec;
 
-  while ( (state != sDONE ) && (!timeout) ) {
-    if (serial_recv(&pgm->fd, &c, 1) < 0)
+  for (n = 0; ; ) {             // n bytes of a candidate header are in hdr[]
+    if (serial_recv(pgm, &pgm->fd, hdr + n, sizeof hdr - n) < 0)
       goto timedout;
-    DEBUG("0x%02x ",c);
-    checksum ^= c;
-
-    switch (state) {
-      case sSTART:
-        DEBUGRECV("hoping for start token...");
-        if (c == MESSAGE_START) {
-          DEBUGRECV("got it\n");
-          checksum = MESSAGE_START;
-          state = sSEQNUM;
-        } else
-          DEBUGRECV("sorry\n");
-        break;
-      case sSEQNUM:
-        DEBUGRECV("hoping for sequence...\n");
-        if (c == PDATA(pgm)->command_sequence) {
-          DEBUGRECV("got it, incrementing\n");
-          state = sSIZE1;
-          PDATA(pgm)->command_sequence++;
-        } else {
-          DEBUGRECV("sorry\n");
-          state = sSTART;
-        }
-        break;
-      case sSIZE1:
-        DEBUGRECV("hoping for size LSB\n");
-        msglen = (unsigned)c * 256;
-        state = sSIZE2;
-        break;
-      case sSIZE2:
-        DEBUGRECV("hoping for size MSB...");
-        msglen += (unsigned)c;
-        DEBUG(" msg is %u bytes\n",msglen);
-        state = sTOKEN;
-        break;
-      case sTOKEN:
-        if (c == TOKEN) state = sDATA;
-        else state = sSTART;
-        break;
-      case sDATA:
-        if (curlen < maxsize) {
-          msg[curlen] = c;
-        } else {
-          avrdude_message(MSG_INFO, "%s: stk500v2_recv(): buffer too small, received %d byte into %u byte buffer\n",
-                  progname,curlen,(unsigned int)maxsize);
-          return -2;
-        }
-        if ((curlen == 0) && (msg[0] == ANSWER_CKSUM_ERROR)) {
-          avrdude_message(MSG_INFO, "%s: stk500v2_recv(): previous packet sent with wrong checksum\n",
-                  progname);
-          return -3;
-        }
-        curlen++;
-        if (curlen == msglen) state = sCSUM;
-        break;
-      case sCSUM:
-        if (checksum == 0) {
-          state = sDONE;
-        } else {
-          state = sSTART;
-          avrdude_message(MSG_INFO, "%s: stk500v2_recv(): checksum error\n",
-                  progname);
-          return -4;
-        }
+    n = sizeof hdr;
+
+    // f is the position of the first byte that does not fit the header
+    if (hdr[0] != MESSAGE_START)
+      f = 0;
+    else if (hdr[1] != PDATA(pgm)->command_sequence)
+      f = 1;
+    else {
+      PDATA(pgm)->command_sequence++;
+      if (hdr[4] == TOKEN)
         break;
-      default:
-        avrdude_message(MSG_INFO, "%s: stk500v2_recv(): unknown state\n",
-                progname);
-        return -5;
-     } /* switch */
+      f = 4;
+    }
+    DEBUGRECV("no frame header at 0x%02x, resyncing\n", hdr[f]);
+
+    // Keep what follows from the next MESSAGE_START on
+    for (f++; f < n && hdr[f] != MESSAGE_START; f++)
+      continue;
+    memmove(hdr, hdr + f, n - f);
+    n -= f;
+
+    gettimeofday(&tv, NULL);
+    tnow = tv.tv_sec;
+    if (tnow-tstart > timeoutval) {		// wuff - signed/unsigned/overflow
+     timedout:
+      avrdude_message(MSG_INFO, "%s: stk500v2_ReceiveMessage(): timeout\n",
+              progname);
+      return -1;
+    }
+  }
+
+  msglen = (unsigned) hdr[2] * 256 + hdr[3];
+  DEBUG("0x%02x 0x%02x 0x%02x 0x%02x 0x%02x msg is %u bytes\n",
+        hdr[0], hdr[1], hdr[2], hdr[3], hdr[4], msglen);
+
+  if (msglen > maxsize) {
+    if (serial_recv(pgm, &pgm->fd, msg, maxsize) < 0)
+      goto timedout;
+    avrdude_message(MSG_INFO, "%s: stk500v2_recv(): buffer too small, received %d byte into %u byte buffer\n",
+            progname, (int) maxsize, (unsigned int) maxsize);
+    return -2;
+  }
+
+  // Fetch data and checksum in one go if the checksum fits into msg
+  if (msglen < maxsize) {
+    if (serial_recv(pgm, &pgm->fd, msg, msglen + 1) < 0)
+      goto timedout;
+    csum = msg[msglen];
+  } else if (serial_recv(pgm, &pgm->fd, msg, msglen) < 0 || serial_recv(pgm, &pgm->fd, &csum, 1) < 0)
+    goto timedout;
 
-     gettimeofday(&tv, NULL);
-     tnow = tv.tv_sec;
-     if (tnow-tstart > timeoutval) {			// wuff - signed/unsigned/overflow
-      timedout:
-       avrdude_message(MSG_INFO, "%s: stk500v2_ReceiveMessage(): timeout\n",
-               progname);
-       return -1;
-     }
+  if (msglen > 0 && msg[0] == ANSWER_CKSUM_ERROR) {
+    avrdude_message(MSG_INFO, "%s: stk500v2_recv(): previous packet sent with wrong checksum\n",
+            progname);
+    return -3;
+  }
 
-  } /* while */
-  DEBUG("\n");
+  checksum = hdr[0] ^ hdr[1] ^ hdr[2] ^ hdr[3] ^ hdr[4] ^ csum;
+  for (i = 0; i < msglen; i++) {
+    DEBUG("0x%02x ", msg[i]);
+    checksum ^= msg[i];
+  }
+  DEBUG("0x%02x\n", csum);
+
+  if (checksum != 0) {
+    avrdude_message(MSG_INFO, "%s: stk500v2_recv(): checksum error\n",
+            progname);
+    return -4;
+  }
 
   return (int)(msglen+6);
 }
@@ -1593,7 +1585,7 @@ static int stk500v2_open(PROGRAMMER *pgm, const char *port) {
 
   if(strcasecmp(port, "avrdoper") == 0){
 #if defined(HAVE_LIBHIDAPI)
-    serdev = &avrdoper_serdev;
+    pgm->serdev = &avrdoper_serdev;
     PDATA(pgm)->pgmtype = PGMTYPE_STK500;
 #else
     avrdude_message(MSG_INFO, "avrdoper requires avrdude with libhidapi support.\n");
@@ -1609,7 +1601,7 @@ static int stk500v2_open(PROGRAMMER *pgm, const char *port) {
    */
   if (strncmp(port, "usb", 3) == 0) {
 #if defined(HAVE_LIBUSB)
-    serdev = &usb_serdev_frame;
+    pgm->serdev = &usb_serdev_frame;
     pinfo.usbinfo.vid = USB_VENDOR_ATMEL;
     pinfo.usbinfo.flags = 0;
     pinfo.usbinfo.pid = USB_DEVICE_AVRISPMKII;
@@ -1626,7 +1618,7 @@ static int stk500v2_open(PROGRAMMER *pgm, const char *port) {
   }
 
   strcpy(pgm->port, port);
-  if (serial_open(port, pinfo, &pgm->fd)==-1) {
+  if (serial_open(pgm, port, pinfo, &pgm->fd)==-1) {
     return -1;
   }
 
@@ -1666,7 +1658,7 @@ static int stk600_open(PROGRAMMER *pgm, const char *port) {
    */
   if (strncmp(port, "usb", 3) == 0) {
 #if defined(HAVE_LIBUSB)
-    serdev = &usb_serdev_frame;
+    pgm->serdev = &usb_serdev_frame;
     pinfo.usbinfo.vid = USB_VENDOR_ATMEL;
     pinfo.usbinfo.flags = 0;
     pinfo.usbinfo.pid = USB_DEVICE_STK600;
@@ -1683,7 +1675,7 @@ static int stk600_open(PROGRAMMER *pgm, const char *port) {
   }
 
   strcpy(pgm->port, port);
-  if (serial_open(port, pinfo, &pgm->fd)==-1) {
+  if (serial_open(pgm, port, pinfo, &pgm->fd)==-1) {
     return -1;
   }
 
@@ -1708,7 +1700,7 @@ static int stk600_open(PROGRAMMER *pgm, const char *port) {
 static void stk500v2_close(PROGRAMMER *pgm) {
   DEBUG("STK500V2: stk500v2_close()\n");
 
-  serial_close(&pgm->fd);
+  serial_close(pgm, &pgm->fd);
   pgm->fd.ifd = -1;
 }
 
@@ -3369,7 +3361,7 @@ static int stk500v2_jtagmkII_open(PROGRAMMER *pgm, const char *port) {
    */
   if (strncmp(port, "usb", 3) == 0) {
 #if defined(HAVE_LIBUSB)
-    serdev = &usb_serdev;
+    pgm->serdev = &usb_serdev;
     pinfo.usbinfo.vid = USB_VENDOR_ATMEL;
     pinfo.usbinfo.flags = 0;
     pinfo.usbinfo.pid = USB_DEVICE_JTAGICEMKII;
@@ -3384,7 +3376,7 @@ static int stk500v2_jtagmkII_open(PROGRAMMER *pgm, const char *port) {
   }
 
   strcpy(pgm->port, port);
-  if (serial_open(port, pinfo, &pgm->fd)==-1) {
+  if (serial_open(pgm, port, pinfo, &pgm->fd)==-1) {
     return -1;
   }
 
@@ -3480,7 +3472,7 @@ static int stk500v2_dragon_isp_open(PROGRAMMER *pgm, const char *port) {
    */
   if (strncmp(port, "usb", 3) == 0) {
 #if defined(HAVE_LIBUSB)
-    serdev = &usb_serdev;
+    pgm->serdev = &usb_serdev;
     pinfo.usbinfo.vid = USB_VENDOR_ATMEL;
     pinfo.usbinfo.flags = 0;
     pinfo.usbinfo.pid = USB_DEVICE_AVRDRAGON;
@@ -3495,7 +3487,7 @@ static int stk500v2_dragon_isp_open(PROGRAMMER *pgm, const char *port) {
   }
 
   strcpy(pgm->port, port);
-  if (serial_open(port, pinfo, &pgm->fd)==-1) {
+  if (serial_open(pgm, port, pinfo, &pgm->fd)==-1) {
     return -1;
   }
 
@@ -3557,7 +3549,7 @@ static int stk500v2_dragon_hv_open(PROGRAMMER *pgm, const char *port) {
    */
   if (strncmp(port, "usb", 3) == 0) {
 #if defined(HAVE_LIBUSB)
-    serdev = &usb_serdev;
+    pgm->serdev = &usb_serdev;
     pinfo.usbinfo.vid = USB_VENDOR_ATMEL;
     pinfo.usbinfo.flags = 0;
     pinfo.usbinfo.pid = USB_DEVICE_AVRDRAGON;
@@ -3572,7 +3564,7 @@ static int stk500v2_dragon_hv_open(PROGRAMMER *pgm, const char *port) {
   }
 
   strcpy(pgm->port, port);
-  if (serial_open(port, pinfo, &pgm->fd)==-1) {
+  if (serial_open(pgm, port, pinfo, &pgm->fd)==-1) {
     return -1;
   }
 
@@ -217,42 +217,27 @@ int memstats(struct avrpart *p, char *memtype, int size, Filestats *fsp) {
   }
 
   ret.lastaddr = -1;
-  int firstset = 0, insection = 0;
-  // Scan all memory
-  for(int addr = 0; addr < mem->size; ) {
-    int pageset = 0;
-    // Go page by page
-    for(int pgi = 0; pgi < pgsize; pgi++, addr++) {
-      if(mem->tags[addr] & TAG_ALLOCATED) {
-        if(!firstset) {
-          firstset = 1;
-          ret.firstaddr = addr;
-        }
-        ret.lastaddr = addr;
-        // size can be smaller than tags suggest owing to flash trailing-0xff
-        if(addr < size) {
-          ret.nbytes++;
-          if(!pageset) {
-            pageset = 1;
-            ret.nfill += pgi;
-            ret.npages++;
-          }
-          if(!insection) {
-            insection = 1;
-            ret.nsections++;
-          }
-        } else {                // Now beyond size returned by input file read
-          ret.ntrailing++;
-          if(pageset)
-            ret.nfill++;
-        }
-      } else {                  // In a hole or beyond input file
-        insection = 0;
-        if(pageset)
-          ret.nfill++;
-      }
+  if(mem->nextents) {
+    AVRMEM_EXTENT *last = mem->extents + mem->nextents - 1;
+
+    ret.firstaddr = mem->extents[0].addr;
+    ret.lastaddr = last->addr + last->len - 1;
+  }
+
+  // Walk the sections set by the file read rather than all of memory
+  for(int i = 0; i < mem->nextents; i++) {
+    int addr = mem->extents[i].addr, end = addr + mem->extents[i].len;
+
+    if(addr < size) {
+      ret.nsections++;
+      ret.nbytes += (end < size? end: size) - addr;
     }
+    // size can be smaller than tags suggest owing to flash trailing-0xff
+    if(end > size)
+      ret.ntrailing += end - (addr > size? addr: size);
   }
+  ret.npages = avr_mem_count_pages(mem, size, pgsize);
+  ret.nfill = ret.npages*pgsize - ret.nbytes;
 
   if(fsp)
     *fsp = ret;
@@ -433,12 +418,52 @@ int update_dryrun(struct avrpart *p, UPDATE *upd) {
 }
 
 
+/*
+ * Differential mode: read the input files of all write operations and
+ * compare them with the device to decide whether a chip erase is needed.
+ * This has to happen before the first update is carried out as a chip
+ * erase in the middle of the -U list would clear memories already
+ * written. Returns 1 if a chip erase is needed, 0 if not, or < 0 on error.
+ */
+int update_diff_needs_erase(PROGRAMMER * pgm, struct avrpart * p, LISTID updates) {
+  LNODEID ln;
+  int rc, needs_erase = 0;
+
+  for (ln = lfirst(updates); ln && !needs_erase; ln = lnext(ln)) {
+    UPDATE *upd = ldata(ln);
+    AVRMEM *mem;
+
+    if (upd->op != DEVICE_WRITE || !(mem = avr_locate_mem(p, upd->memtype)) ||
+        !avr_mem_is_flash_type(mem))
+      continue;
+
+    rc = fileio(FIO_READ, upd->filename, upd->format, p, upd->memtype, -1);
+    if (rc < 0) {
+      avrdude_message(MSG_INFO, "%s: read from file %s failed\n",
+        progname, update_inname(upd->filename));
+      return LIBAVRDUDE_GENERAL_FAILURE;
+    }
+
+    if (quell_progress < 2)
+      avrdude_message(MSG_INFO, "%s: comparing %s memory with input file %s\n",
+        progname, mem->desc, update_inname(upd->filename));
+    report_progress(0, 1, "Reading");
+    rc = avr_write_diff_needs_erase(pgm, p, upd->memtype, rc);
+    report_progress(1, 1, NULL);
+    if (rc < 0)
+      return rc;
+    needs_erase = rc;
+  }
+
+  return needs_erase;
+}
+
 int do_op(PROGRAMMER * pgm, struct avrpart * p, UPDATE * upd, enum updateflags flags)
 {
   struct avrpart * v;
   AVRMEM * mem;
   int size;
-  int rc;
+  int rc, nskipped = 0;
   Filestats fs;
 
   mem = avr_locate_mem(p, upd->memtype);
@@ -537,7 +562,10 @@ int do_op(PROGRAMMER * pgm, struct avrpart * p, UPDATE * upd, enum updateflags f
 
     if (!(flags & UF_NOWRITE)) {
       report_progress(0, 1, "Writing");
-      rc = avr_write(pgm, p, upd->memtype, size, (flags & UF_AUTO_ERASE) != 0);
+      if (flags & UF_DIFFERENTIAL)
+        rc = avr_write_diff(pgm, p, upd->memtype, size, (flags & UF_AUTO_ERASE) != 0, &nskipped);
+      else
+        rc = avr_write(pgm, p, upd->memtype, size, (flags & UF_AUTO_ERASE) != 0);
       report_progress(1, 1, NULL);
     } else {
       // Test mode: write to stdout in intel hex rather than to the chip
@@ -553,6 +581,9 @@ int do_op(PROGRAMMER * pgm, struct avrpart * p, UPDATE * upd, enum updateflags f
     if (quell_progress < 2)
       avrdude_message(MSG_INFO, "%s: %d byte%s of %s%s written\n",
         progname, fs.nbytes, update_plural(fs.nbytes), mem->desc, alias_mem_desc);
+    if (quell_progress < 2 && (flags & UF_DIFFERENTIAL) && !(flags & UF_NOWRITE))
+      avrdude_message(MSG_INFO, "%s: %d page%s of %s%s unchanged and skipped\n",
+        progname, nskipped, update_plural(nskipped), mem->desc, alias_mem_desc);
 
     // Fall through for (default) auto verify, ie, unless -V was specified
     if (!(flags & UF_VERIFY))
@@ -591,12 +622,24 @@ int do_op(PROGRAMMER * pgm, struct avrpart * p, UPDATE * upd, enum updateflags f
       size = fs.lastaddr+1;
     }
 
+    if (quell_progress < 2 && userverify)
+      avrdude_message(MSG_NOTICE, "%s: input file %s contains %d byte%s\n",
+        progname, update_inname(upd->filename), fs.nbytes, update_plural(fs.nbytes));
+
+    // Let the target or programmer check a CRC first; read back only if that fails
+    if (avr_verify_crc(pgm, p, upd->memtype, size) > 0) {
+      if (quell_progress < 2) {
+        int verified = fs.nbytes+fs.ntrailing;
+        avrdude_message(MSG_INFO, "%s: %d byte%s of %s%s verified by CRC\n",
+          progname, verified, update_plural(verified), mem->desc, alias_mem_desc);
+      }
+      pgm->vfy_led(pgm, OFF);
+      break;
+    }
+
     v = avr_dup_part(p);
 
     if (quell_progress < 2) {
-      if (userverify)
-        avrdude_message(MSG_NOTICE, "%s: input file %s contains %d byte%s\n",
-          progname, update_inname(upd->filename), fs.nbytes, update_plural(fs.nbytes));
       avrdude_message(MSG_NOTICE2, "%s: reading on-chip %s%s data ...\n",
         progname, mem->desc, alias_mem_desc);
     }
@@ -82,6 +82,7 @@
 #define UPDI_ASI_CRC_STATUS 0x0C
 
 #define UPDI_CTRLA_IBDLY_BIT    7
+#define UPDI_CTRLA_GTVAL_2      0x06 // guard time of 2 cycles
 #define UPDI_CTRLB_CCDETDIS_BIT 3
 #define UPDI_CTRLB_UPDIDIS_BIT  2
 
@@ -104,6 +105,10 @@
 
 #define UPDI_ASI_SYS_CTRLA_UROW_FINAL  1
 
+#define UPDI_ASI_CTRLA_UPDICLKSEL_16M  0x01
+#define UPDI_ASI_CTRLA_UPDICLKSEL_8M   0x02
+#define UPDI_ASI_CTRLA_UPDICLKSEL_4M   0x03
+
 #define UPDI_RESET_REQ_VALUE  0x59
 
 // FLASH CONTROLLER
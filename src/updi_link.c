@@ -46,8 +46,8 @@ static void updi_set_rtsdtr_mode(const PROGRAMMER *pgm) {
     return;
   }
 
-  serial_set_dtr_rts(&pgm->fd, 0);
-  serial_set_dtr_rts(&pgm->fd, rts_mode == RTS_MODE_LOW ? 1 : 0);
+  serial_set_dtr_rts(pgm, &pgm->fd, 0);
+  serial_set_dtr_rts(pgm, &pgm->fd, rts_mode == RTS_MODE_LOW ? 1 : 0);
 }
 
 static int updi_physical_open(PROGRAMMER* pgm, int baudrate, unsigned long cflags)
@@ -60,7 +60,7 @@ static int updi_physical_open(PROGRAMMER* pgm, int baudrate, unsigned long cflag
 
   avrdude_message(MSG_DEBUG, "%s: Opening serial port...\n", progname);
 
-  if (serial_open(pgm->port, pinfo, &pgm->fd)==-1) {
+  if (serial_open(pgm, pgm->port, pinfo, &pgm->fd)==-1) {
 
     avrdude_message(MSG_DEBUG, "%s: Serial port open failed!\n", progname);
     return -1;
@@ -69,7 +69,7 @@ static int updi_physical_open(PROGRAMMER* pgm, int baudrate, unsigned long cflag
   /*
    * drain any extraneous input
    */
-  serial_drain(&pgm->fd, 0);
+  serial_drain(pgm, &pgm->fd, 0);
 
   /*
    * set RTS/DTR mode if needed
@@ -81,8 +81,8 @@ static int updi_physical_open(PROGRAMMER* pgm, int baudrate, unsigned long cflag
 
 static void updi_physical_close(PROGRAMMER* pgm)
 {
-  serial_set_dtr_rts(&pgm->fd, 0);
-  serial_close(&pgm->fd);
+  serial_set_dtr_rts(pgm, &pgm->fd, 0);
+  serial_close(pgm, &pgm->fd);
   pgm->fd.ifd = -1;
 }
 
@@ -99,8 +99,8 @@ static int updi_physical_send(const PROGRAMMER *pgm, unsigned char *buf, size_t
   }
   avrdude_message(MSG_DEBUG, "]\n");
 
-  rv = serial_send(&pgm->fd, buf, len);
-  serial_recv(&pgm->fd, buf, len);
+  rv = serial_send(pgm, &pgm->fd, buf, len);
+  serial_recv(pgm, &pgm->fd, buf, len);
   return rv;
 }
 
@@ -108,7 +108,7 @@ static int updi_physical_recv(const PROGRAMMER *pgm, unsigned char *buf, size_t
   size_t i;
   int rv;
 
-  rv = serial_recv(&pgm->fd, buf, len);
+  rv = serial_recv(pgm, &pgm->fd, buf, len);
   if (rv < 0) {
     avrdude_message(MSG_DEBUG,
       "%s: serialupdi_recv(): programmer is not responding\n",
@@ -133,7 +133,7 @@ static int updi_physical_send_double_break(const PROGRAMMER *pgm) {
 
   avrdude_message(MSG_DEBUG, "%s: Sending double break\n", progname);
 
-  if (serial_setparams(&pgm->fd, 300, SERIAL_8E1) < 0) {
+  if (serial_setparams(pgm, &pgm->fd, 300, SERIAL_8E1) < 0) {
     return -1;
   }
 
@@ -141,19 +141,19 @@ static int updi_physical_send_double_break(const PROGRAMMER *pgm) {
 
   buffer[0] = UPDI_BREAK;
 
-  serial_send(&pgm->fd, buffer, 1);
-  serial_recv(&pgm->fd, buffer, 1);
+  serial_send(pgm, &pgm->fd, buffer, 1);
+  serial_recv(pgm, &pgm->fd, buffer, 1);
 
   usleep(100*1000);
 
   buffer[0] = UPDI_BREAK;
 
-  serial_send(&pgm->fd, buffer, 1);
-  serial_recv(&pgm->fd, buffer, 1);
+  serial_send(pgm, &pgm->fd, buffer, 1);
+  serial_recv(pgm, &pgm->fd, buffer, 1);
 
-  serial_drain(&pgm->fd, 0);
+  serial_drain(pgm, &pgm->fd, 0);
 
-  if (serial_setparams(&pgm->fd, pgm->baudrate? pgm->baudrate: 115200, SERIAL_8E2) < 0) {
+  if (serial_setparams(pgm, &pgm->fd, pgm->baudrate? pgm->baudrate: 115200, SERIAL_8E2) < 0) {
     return -1;
   }
 
@@ -162,7 +162,7 @@ static int updi_physical_send_double_break(const PROGRAMMER *pgm) {
   /*
    * drain any extraneous input
    */
-  serial_drain(&pgm->fd, 0);
+  serial_drain(pgm, &pgm->fd, 0);
 
   return 0;
 }
@@ -194,6 +194,8 @@ int updi_physical_sib(const PROGRAMMER *pgm, unsigned char *buffer, uint8_t size
 int updi_link_open(PROGRAMMER *pgm)  {
   unsigned char init_buffer[1];
 
+  /* a new connection starts at the initial baud rate */
+  updi_set_link_baud(pgm, 0);
   if (updi_physical_open(pgm, pgm->baudrate? pgm->baudrate: 115200, SERIAL_8E2) < 0) {
     return -1;
   }
@@ -219,7 +221,7 @@ static int updi_link_init_session_parameters(const PROGRAMMER *pgm)  {
     return -1;
   }
 
-  if (updi_link_stcs(pgm, UPDI_CS_CTRLA, 1 << UPDI_CTRLA_IBDLY_BIT) < 0) {
+  if (updi_link_stcs(pgm, UPDI_CS_CTRLA, (1 << UPDI_CTRLA_IBDLY_BIT) | updi_get_guard_time(pgm)) < 0) {
     return -1;
   }
 
@@ -260,6 +262,71 @@ static int updi_link_check(const PROGRAMMER *pgm) {
 }
 
 
+/*
+ * UPDI clock in MHz used for a link at baud: the UPDI receives at up to
+ * about fUPDI/16. 16 MHz is only valid at VDD >= 4.5 V on most parts, so
+ * it has to be requested explicitly with -x updiclk=16.
+ */
+static int updi_link_turbo_mhz(const PROGRAMMER *pgm, long baud) {
+  if (updi_get_updi_clock(pgm))
+    return updi_get_updi_clock(pgm);
+  return baud > 250000? 8: 4;
+}
+
+/*
+ * Raise the UPDI clock and shorten the guard time for a fast link
+ */
+static int updi_link_fast_clock(const PROGRAMMER *pgm, int mhz) {
+  uint8_t clksel = mhz >= 16? UPDI_ASI_CTRLA_UPDICLKSEL_16M:
+    mhz >= 8? UPDI_ASI_CTRLA_UPDICLKSEL_8M: UPDI_ASI_CTRLA_UPDICLKSEL_4M;
+
+  avrdude_message(MSG_DEBUG, "%s: Setting UPDI clock to %d MHz and short guard time\n", progname, mhz);
+  if (updi_link_stcs(pgm, UPDI_ASI_CTRLA, clksel) < 0)
+    return -1;
+  updi_set_guard_time(pgm, UPDI_CTRLA_GTVAL_2);
+  return updi_link_stcs(pgm, UPDI_CS_CTRLA, (1 << UPDI_CTRLA_IBDLY_BIT) | UPDI_CTRLA_GTVAL_2);
+}
+
+/*
+ * Start over at the initial baud rate with the default guard time
+ */
+static int updi_link_restart(const PROGRAMMER *pgm) {
+  updi_set_link_baud(pgm, 0);
+  updi_set_guard_time(pgm, 0);
+  if (updi_physical_send_double_break(pgm) < 0 ||
+      updi_link_init_session_parameters(pgm) < 0 ||
+      updi_link_check(pgm) < 0) {
+    avrdude_message(MSG_INFO, "%s: Restoring datalink failed\n", progname);
+    return -1;
+  }
+  return 0;
+}
+
+/*
+ * A double break leaves the host at the initial baud rate; switch back
+ * to the negotiated rate, or stay at the initial one if that fails
+ */
+static int updi_link_resume(const PROGRAMMER *pgm) {
+  long base = pgm->baudrate? pgm->baudrate: 115200;
+  long baud = updi_get_link_baud(pgm);
+
+  if (!baud)
+    return 0;
+
+  if (updi_link_fast_clock(pgm, updi_link_turbo_mhz(pgm, baud)) < 0 ||
+      serial_setparams(pgm, &pgm->fd, baud, SERIAL_8E2) < 0)
+    return -1;
+  serial_drain(pgm, &pgm->fd, 0);
+  if (updi_link_check(pgm) == 0)
+    return 0;
+
+  avrdude_message(MSG_NOTICE, "%s: Link check failed at %ld baud, falling back to %ld baud\n",
+                  progname, baud, base);
+  if (serial_setparams(pgm, &pgm->fd, base, SERIAL_8E2) < 0)
+    return -1;
+  return updi_link_restart(pgm);
+}
+
 int updi_link_init(const PROGRAMMER *pgm) {
 /*
     def init_datalink(self):
@@ -294,10 +361,73 @@ int updi_link_init(const PROGRAMMER *pgm) {
       avrdude_message(MSG_DEBUG, "%s: Restoring datalink failed\n", progname);
       return -1;
     }
+    if (updi_link_resume(pgm) < 0) {
+      avrdude_message(MSG_DEBUG, "%s: Restoring link speed failed\n", progname);
+      return -1;
+    }
   }
   return 0;
 }
 
+/*
+ * Step the link up to the highest baud rate not above maxbaud at which
+ * it still works.  The UPDI clock is raised and the guard time reduced
+ * first; the host baud rate is then increased step by step, checking
+ * the link after each step, and reverted to the last good rate on the
+ * first failure.  If even that does not work, the link is reset to the
+ * initial baud rate.  The rate in use is remembered so that later link
+ * resets return to it.  Returns the baud rate in use, or -1 on error.
+ */
+long updi_link_turbo(const PROGRAMMER *pgm, long maxbaud) {
+  static const long rates[] = { 230400, 460800, 500000, 921600, 1000000 };
+  long base = pgm->baudrate? pgm->baudrate: 115200;
+  long good = base;
+  int mhz;
+  size_t i;
+  int n;
+
+  mhz = updi_link_turbo_mhz(pgm, maxbaud);
+  if (maxbaud > mhz*1000000L/16)
+    maxbaud = mhz*1000000L/16;
+  if (maxbaud <= base)
+    return base;
+
+  if (updi_link_fast_clock(pgm, mhz) < 0)
+    return -1;
+
+  for (i = 0; i < sizeof rates/sizeof *rates && rates[i] <= maxbaud; i++) {
+    if (rates[i] <= good)
+      continue;
+    avrdude_message(MSG_NOTICE2, "%s: Trying %ld baud\n", progname, rates[i]);
+    if (serial_setparams(pgm, &pgm->fd, rates[i], SERIAL_8E2) < 0)
+      break;
+    serial_drain(pgm, &pgm->fd, 0);
+    for (n = 0; n < 3 && updi_link_check(pgm) == 0; n++)
+      continue;
+    if (n < 3)
+      break;
+    good = rates[i];
+  }
+
+  if (i < sizeof rates/sizeof *rates && rates[i] <= maxbaud) {
+    /* last step failed, fall back */
+    avrdude_message(MSG_NOTICE, "%s: Link check failed at %ld baud, falling back to %ld baud\n",
+                    progname, rates[i], good);
+    if (serial_setparams(pgm, &pgm->fd, good, SERIAL_8E2) < 0)
+      return -1;
+    serial_drain(pgm, &pgm->fd, 0);
+    if (updi_link_check(pgm) < 0) {
+      /* start over from the initial baud rate */
+      if (updi_link_restart(pgm) < 0)
+        return -1;
+      good = base;
+    }
+  }
+
+  updi_set_link_baud(pgm, good > base? good: 0);
+  return good;
+}
+
 int updi_link_ldcs(const PROGRAMMER *pgm, uint8_t address, uint8_t *value)  {
 /*
     def ldcs(self, address):
@@ -534,55 +664,27 @@ int updi_link_st_ptr_inc16(const PROGRAMMER *pgm, unsigned char *buffer, uint16_
   return 0;
 }
 
-int updi_link_st_ptr_inc16_RSD(const PROGRAMMER *pgm, unsigned char *buffer, uint16_t words, int blocksize) {
 /*
-    def st_ptr_inc16_RSD(self, data, blocksize):
-        """
-        Store a 16-bit word value to the pointer location with pointer post-increment
-        :param data: data to store
-        :blocksize: max number of bytes being sent -1 for all.
-                    Warning: This does not strictly honor blocksize for values < 6
-                    We always glob together the STCS(RSD) and REP commands.
-                    But this should pose no problems for compatibility, because your serial adapter can't deal with 6b chunks,
-                    none of pymcuprog would work!
-        """
-        self.logger.debug("ST16 to *ptr++ with RSD, data length: 0x%03X in blocks of:  %d", len(data), blocksize)
-
-        #for performance we glob everything together into one USB transfer....
-        repnumber= ((len(data) >> 1) -1)
-        data = [*data, *[constants.UPDI_PHY_SYNC, constants.UPDI_STCS | constants.UPDI_CS_CTRLA, 0x06]]
-
-        if blocksize == -1 :
-            # Send whole thing at once stcs + repeat + st + (data + stcs)
-            blocksize = 3 + 3 + 2 + len(data)
-        num = 0
-        firstpacket = []
-        if blocksize < 10 :
-            # very small block size - we send pair of 2-byte commands first.
-            firstpacket = [*[constants.UPDI_PHY_SYNC, constants.UPDI_STCS | constants.UPDI_CS_CTRLA, 0x0E],
-                            *[constants.UPDI_PHY_SYNC, constants.UPDI_REPEAT | constants.UPDI_REPEAT_BYTE, (repnumber & 0xFF)]]
-            data = [*[constants.UPDI_PHY_SYNC, constants.UPDI_ST | constants.UPDI_PTR_INC |constants.UPDI_DATA_16], *data]
-            num = 0
-        else:
-            firstpacket = [*[constants.UPDI_PHY_SYNC, constants.UPDI_STCS | constants.UPDI_CS_CTRLA , 0x0E],
-                            *[constants.UPDI_PHY_SYNC, constants.UPDI_REPEAT | constants.UPDI_REPEAT_BYTE, (repnumber & 0xFF)],
-                            *[constants.UPDI_PHY_SYNC, constants.UPDI_ST | constants.UPDI_PTR_INC | constants.UPDI_DATA_16],
-                            *data[:blocksize - 8]]
-            num = blocksize - 8
-        self.updi_phy.send( firstpacket )
-
-        # if finite block size, this is used.
-        while num < len(data):
-            data_slice = data[num:num+blocksize]
-            self.updi_phy.send(data_slice)
-            num += len(data_slice)
-*/
-  avrdude_message(MSG_DEBUG, "%s: ST16 to *ptr++ with RSD, data length: 0x%03X in blocks of: %d\n", progname, words * 2, blocksize);
-
-  unsigned int temp_buffer_size = 3 + 3 + 2 + (words * 2) + 3;
+ * Store count units of datasize (UPDI_DATA_8 or UPDI_DATA_16) to the
+ * pointer location with post-increment, with the response signature
+ * disabled.  RSD mode, the REPEAT prefix, the ST instruction, the data
+ * and the switch back to normal mode go out as one burst in chunks of
+ * blocksize bytes (-1 for all at once), so the only read-back is the
+ * echo of each chunk.
+ */
+static int updi_link_st_ptr_inc_burst(const PROGRAMMER *pgm, unsigned char *buffer, uint16_t count,
+                                      unsigned char datasize, int blocksize) {
+  unsigned int nbytes = datasize == UPDI_DATA_16? count * 2: count;
+  unsigned int temp_buffer_size = 3 + 3 + 2 + nbytes + 3;
   unsigned int num=0;
-  unsigned char* temp_buffer = malloc(temp_buffer_size);
+  unsigned char* temp_buffer;
 
+  if (count == 0 || count > UPDI_MAX_REPEAT_SIZE) {
+    avrdude_message(MSG_DEBUG, "%s: Invalid repeat count of %d\n", progname, count);
+    return -1;
+  }
+
+  temp_buffer = malloc(temp_buffer_size);
   if (temp_buffer == 0) {
     avrdude_message(MSG_DEBUG, "%s: Allocating temporary buffer failed\n", progname);
     return -1;
@@ -597,15 +699,16 @@ int updi_link_st_ptr_inc16_RSD(const PROGRAMMER *pgm, unsigned char *buffer, uin
   temp_buffer[2] = 0x0E;
   temp_buffer[3] = UPDI_PHY_SYNC;
   temp_buffer[4] = UPDI_REPEAT | UPDI_REPEAT_BYTE;
-  temp_buffer[5] = (words - 1) & 0xFF;
+  temp_buffer[5] = (count - 1) & 0xFF;
   temp_buffer[6] = UPDI_PHY_SYNC;
-  temp_buffer[7] = UPDI_ST | UPDI_PTR_INC | UPDI_DATA_16;
+  temp_buffer[7] = UPDI_ST | UPDI_PTR_INC | datasize;
 
-  memcpy(temp_buffer + 8, buffer, words * 2);
+  memcpy(temp_buffer + 8, buffer, nbytes);
 
   temp_buffer[temp_buffer_size-3] = UPDI_PHY_SYNC;
   temp_buffer[temp_buffer_size-2] = UPDI_STCS | UPDI_CS_CTRLA;
-  temp_buffer[temp_buffer_size-1] = 0x06;
+  /* leave RSD mode, restoring the session's inter-byte delay and guard time */
+  temp_buffer[temp_buffer_size-1] = (1 << UPDI_CTRLA_IBDLY_BIT) | updi_get_guard_time(pgm);
 
   if (blocksize < 10) {
     if (updi_physical_send(pgm, temp_buffer, 6) < 0) {
@@ -637,6 +740,60 @@ int updi_link_st_ptr_inc16_RSD(const PROGRAMMER *pgm, unsigned char *buffer, uin
   return 0;
 }
 
+int updi_link_st_ptr_inc16_RSD(const PROGRAMMER *pgm, unsigned char *buffer, uint16_t words, int blocksize) {
+/*
+    def st_ptr_inc16_RSD(self, data, blocksize):
+        """
+        Store a 16-bit word value to the pointer location with pointer post-increment
+        :param data: data to store
+        :blocksize: max number of bytes being sent -1 for all.
+                    Warning: This does not strictly honor blocksize for values < 6
+                    We always glob together the STCS(RSD) and REP commands.
+                    But this should pose no problems for compatibility, because your serial adapter can't deal with 6b chunks,
+                    none of pymcuprog would work!
+        """
+        self.logger.debug("ST16 to *ptr++ with RSD, data length: 0x%03X in blocks of:  %d", len(data), blocksize)
+
+        #for performance we glob everything together into one USB transfer....
+        repnumber= ((len(data) >> 1) -1)
+        data = [*data, *[constants.UPDI_PHY_SYNC, constants.UPDI_STCS | constants.UPDI_CS_CTRLA, 0x06]]
+
+        if blocksize == -1 :
+            # Send whole thing at once stcs + repeat + st + (data + stcs)
+            blocksize = 3 + 3 + 2 + len(data)
+        num = 0
+        firstpacket = []
+        if blocksize < 10 :
+            # very small block size - we send pair of 2-byte commands first.
+            firstpacket = [*[constants.UPDI_PHY_SYNC, constants.UPDI_STCS | constants.UPDI_CS_CTRLA, 0x0E],
+                            *[constants.UPDI_PHY_SYNC, constants.UPDI_REPEAT | constants.UPDI_REPEAT_BYTE, (repnumber & 0xFF)]]
+            data = [*[constants.UPDI_PHY_SYNC, constants.UPDI_ST | constants.UPDI_PTR_INC |constants.UPDI_DATA_16], *data]
+            num = 0
+        else:
+            firstpacket = [*[constants.UPDI_PHY_SYNC, constants.UPDI_STCS | constants.UPDI_CS_CTRLA , 0x0E],
+                            *[constants.UPDI_PHY_SYNC, constants.UPDI_REPEAT | constants.UPDI_REPEAT_BYTE, (repnumber & 0xFF)],
+                            *[constants.UPDI_PHY_SYNC, constants.UPDI_ST | constants.UPDI_PTR_INC | constants.UPDI_DATA_16],
+                            *data[:blocksize - 8]]
+            num = blocksize - 8
+        self.updi_phy.send( firstpacket )
+
+        # if finite block size, this is used.
+        while num < len(data):
+            data_slice = data[num:num+blocksize]
+            self.updi_phy.send(data_slice)
+            num += len(data_slice)
+*/
+  avrdude_message(MSG_DEBUG, "%s: ST16 to *ptr++ with RSD, data length: 0x%03X in blocks of: %d\n", progname, words * 2, blocksize);
+
+  return updi_link_st_ptr_inc_burst(pgm, buffer, words, UPDI_DATA_16, blocksize);
+}
+
+int updi_link_st_ptr_inc_RSD(const PROGRAMMER *pgm, unsigned char *buffer, uint16_t size, int blocksize) {
+  avrdude_message(MSG_DEBUG, "%s: ST8 to *ptr++ with RSD, data length: 0x%03X in blocks of: %d\n", progname, size, blocksize);
+
+  return updi_link_st_ptr_inc_burst(pgm, buffer, size, UPDI_DATA_8, blocksize);
+}
+
 int updi_link_repeat(const PROGRAMMER *pgm, uint16_t repeats) {
 /*
     def repeat(self, repeats):
@@ -36,12 +36,14 @@ extern "C" {
 int updi_link_open(PROGRAMMER * pgm);
 void updi_link_close(PROGRAMMER * pgm);
 int updi_link_init(const PROGRAMMER *pgm);
+long updi_link_turbo(const PROGRAMMER *pgm, long maxbaud);
 int updi_link_ldcs(const PROGRAMMER *pgm, uint8_t address, uint8_t *value);
 int updi_link_stcs(const PROGRAMMER *pgm, uint8_t address, uint8_t value);
 int updi_link_ld_ptr_inc(const PROGRAMMER *pgm, unsigned char *buffer, uint16_t size);
 int updi_link_ld_ptr_inc16(const PROGRAMMER *pgm, unsigned char *buffer, uint16_t words);
 int updi_link_st_ptr_inc(const PROGRAMMER *pgm, unsigned char *buffer, uint16_t size);
 int updi_link_st_ptr_inc16(const PROGRAMMER *pgm, unsigned char *buffer, uint16_t words);
+int updi_link_st_ptr_inc_RSD(const PROGRAMMER *pgm, unsigned char *buffer, uint16_t size, int blocksize);
 int updi_link_st_ptr_inc16_RSD(const PROGRAMMER *pgm, unsigned char *buffer, uint16_t words, int blocksize);
 int updi_link_repeat(const PROGRAMMER *pgm, uint16_t repeats);
 int updi_link_read_sib(const PROGRAMMER *pgm, unsigned char *buffer, uint16_t size);
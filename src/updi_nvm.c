@@ -1177,6 +1177,32 @@ int updi_nvm_write_fuse(const PROGRAMMER *pgm, const AVRPART *p, uint32_t addres
   }
 }
 
+static unsigned long updi_nvm_time_us(void) {
+  struct timeval tv;
+
+  gettimeofday(&tv, NULL);
+  return (tv.tv_sec * 1000000) + tv.tv_usec;
+}
+
+/*
+ * Timing statistics of an NVM command; creates an entry on first use,
+ * returns NULL if the table is full
+ */
+static updi_nvm_cmd_timing *updi_nvm_timing_slot(updi_nvm_timing *timing, uint8_t command) {
+  int i;
+
+  for (i = 0; i < timing->nslots; i++)
+    if (timing->slot[i].command == command)
+      return &timing->slot[i];
+  if (timing->nslots == UPDI_NVM_TIMING_SLOTS)
+    return NULL;
+  memset(&timing->slot[i], 0, sizeof timing->slot[i]);
+  timing->slot[i].command = command;
+  timing->nslots++;
+
+  return &timing->slot[i];
+}
+
 int updi_nvm_wait_ready(const PROGRAMMER *pgm, const AVRPART *p) {
 /*
     def wait_nvm_ready(self):
@@ -1199,31 +1225,100 @@ int updi_nvm_wait_ready(const PROGRAMMER *pgm, const AVRPART *p) {
         self.logger.error("Wait NVM ready timed out")
         return False
 */
-  unsigned long start_time;
-  unsigned long current_time;
-  struct timeval tv;
+  updi_nvm_timing *timing = updi_get_nvm_timing(pgm);
+  updi_nvm_cmd_timing *slot = NULL;
+  unsigned long start_time, current_time, poll_time, wake_time, sample;
+  unsigned long polls = 0, slept = 0;
   uint8_t status;
-  gettimeofday (&tv, NULL);
-  start_time = (tv.tv_sec * 1000000) + tv.tv_usec;
+
+  start_time = current_time = updi_nvm_time_us();
+
+  /*
+   * If the last command has been timed before, sleep until shortly
+   * before it is expected to finish rather than keep the link busy
+   * with status polls. Page writes are always waited for here before
+   * the next page is loaded, so each page write costs its full
+   * duration; the estimate only replaces most of the polling by a
+   * sleep.
+   */
+  if (timing->pending) {
+    slot = updi_nvm_timing_slot(timing, timing->command);
+    if (slot && slot->estimate > 2*timing->poll) {
+      wake_time = timing->start + slot->estimate - 2*timing->poll;
+      if ((long) (wake_time - current_time) > 0) {
+        slept = wake_time - current_time;
+        if (slept > 10000000)
+          slept = 10000000;
+        usleep(slept);
+        current_time = updi_nvm_time_us();
+      }
+    }
+  }
+
   do {
+    poll_time = current_time;
+    polls++;
     if (updi_read_byte(pgm, p->nvm_base + UPDI_NVMCTRL_STATUS, &status) >= 0) {
+      current_time = updi_nvm_time_us();
+      timing->poll = timing->poll? (3*timing->poll + current_time - poll_time)/4: current_time - poll_time;
       if (status & (1 << UPDI_NVM_STATUS_WRITE_ERROR)) {
         avrdude_message(MSG_INFO, "%s: NVM error\n", progname);
+        timing->pending = false;
         return -1;
       }
       if (!(status & ((1 << UPDI_NVM_STATUS_EEPROM_BUSY) | 
                       (1 << UPDI_NVM_STATUS_FLASH_BUSY)))) {
+        if (slot) {
+          /*
+           * Learn from this wait: a busy status seen means the time to
+           * the first ready poll is a fair measure; ready at the first
+           * poll means the estimate (if any) was too long, or that no
+           * wait was needed at all.
+           */
+          if (polls > 1)
+            sample = current_time - timing->start;
+          else if (slept)
+            sample = poll_time - timing->start > timing->poll? poll_time - timing->start - timing->poll: 0;
+          else
+            sample = 0;
+          slot->estimate = slot->waits? (3*slot->estimate + sample)/4: sample;
+          slot->waits++;
+          slot->polls += polls;
+          slot->slept += slept;
+          slot->total += current_time - start_time;
+        }
+        timing->pending = false;
         return 0;
       }
-    }
-    gettimeofday (&tv, NULL);
-    current_time = (tv.tv_sec * 1000000) + tv.tv_usec;
+    } else
+      current_time = updi_nvm_time_us();
   } while ((current_time - start_time) < 10000000);
 
+  timing->pending = false;
   avrdude_message(MSG_INFO, "%s: Wait NVM ready timed out\n", progname);
   return -1;
 }
 
+/*
+ * Report what was learnt about NVM command durations
+ */
+void updi_nvm_report_timing(const PROGRAMMER *pgm) {
+  updi_nvm_timing *timing = updi_get_nvm_timing(pgm);
+  updi_nvm_cmd_timing *slot;
+  int i;
+
+  for (i = 0; i < timing->nslots; i++) {
+    slot = &timing->slot[i];
+    if (slot->waits == 0)
+      continue;
+    avrdude_message(MSG_NOTICE, "%s: NVM command 0x%02x: %u waits, expected %lu us, "
+                    "%.1f ms per wait, %.1f polls per wait, %.1f ms slept\n",
+                    progname, slot->command, slot->waits, slot->estimate,
+                    slot->total/1000.0/slot->waits, (double) slot->polls/slot->waits,
+                    slot->slept/1000.0);
+  }
+}
+
 int updi_nvm_command(const PROGRAMMER *pgm, const AVRPART *p, uint8_t command) {
 /*
     def execute_nvm_command(self, command):
@@ -1235,7 +1330,15 @@ int updi_nvm_command(const PROGRAMMER *pgm, const AVRPART *p, uint8_t command) {
         self.logger.debug("NVMCMD %d executing", command)
         return self.readwrite.write_byte(self.device.nvmctrl_address + constants.UPDI_NVMCTRL_CTRLA, command)
 */
+  updi_nvm_timing *timing = updi_get_nvm_timing(pgm);
+  int rc;
+
   avrdude_message(MSG_DEBUG, "%s: NVMCMD %d executing\n", progname, command);
 
-  return updi_write_byte(pgm, p->nvm_base + UPDI_NVMCTRL_CTRLA, command);
+  rc = updi_write_byte(pgm, p->nvm_base + UPDI_NVMCTRL_CTRLA, command);
+  timing->pending = rc >= 0;
+  timing->command = command;
+  timing->start = updi_nvm_time_us();
+
+  return rc;
 }
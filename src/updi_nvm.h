@@ -42,6 +42,7 @@ int updi_nvm_write_user_row(const PROGRAMMER *pgm, const AVRPART *p, uint32_t ad
 int updi_nvm_write_eeprom(const PROGRAMMER *pgm, const AVRPART *p, uint32_t address, unsigned char *buffer, uint16_t size);
 int updi_nvm_write_fuse(const PROGRAMMER *pgm, const AVRPART *p, uint32_t address, uint8_t value);
 int updi_nvm_wait_ready(const PROGRAMMER *pgm, const AVRPART *p);
+void updi_nvm_report_timing(const PROGRAMMER *pgm);
 int updi_nvm_command(const PROGRAMMER *pgm, const AVRPART *p, uint8_t command);
 
 #ifdef __cplusplus
@@ -167,6 +167,26 @@ int updi_read_data(const PROGRAMMER *pgm, uint32_t address, uint8_t *buffer, uin
   return updi_link_ld_ptr_inc(pgm, buffer, size);
 }
 
+/*
+ * Burst writes run with the response signature disabled, so no ACK
+ * confirms the individual bytes.  Instead, check the UPDI error
+ * signature once the whole burst has been sent.
+ */
+static int updi_check_burst(const PROGRAMMER *pgm) {
+  uint8_t status;
+
+  if (updi_link_ldcs(pgm, UPDI_CS_STATUSB, &status) < 0) {
+    avrdude_message(MSG_DEBUG, "%s: Reading UPDI status after burst write failed\n", progname);
+    return -1;
+  }
+  if ((status >> UPDI_ASI_STATUSB_PESIG) & 0x07) {
+    avrdude_message(MSG_DEBUG, "%s: UPDI error signature %d after burst write\n", progname,
+                    (status >> UPDI_ASI_STATUSB_PESIG) & 0x07);
+    return -1;
+  }
+  return 0;
+}
+
 int updi_write_data(const PROGRAMMER *pgm, uint32_t address, uint8_t *buffer, uint16_t size) {
 /*
     def write_data(self, address, data):
@@ -213,11 +233,11 @@ int updi_write_data(const PROGRAMMER *pgm, uint32_t address, uint8_t *buffer, ui
     avrdude_message(MSG_DEBUG, "%s: ST_PTR operation failed\n", progname);
     return -1;
   }
-  if (updi_link_repeat(pgm, size) < 0) {
-    avrdude_message(MSG_DEBUG, "%s: Repeat operation failed\n", progname);
+  if (updi_link_st_ptr_inc_RSD(pgm, buffer, size, -1) < 0) {
+    avrdude_message(MSG_DEBUG, "%s: ST_PTR_INC burst operation failed\n", progname);
     return -1;
   }
-  return updi_link_st_ptr_inc(pgm, buffer, size);
+  return updi_check_burst(pgm);
 }
 
 int updi_read_data_words(const PROGRAMMER *pgm, uint32_t address, uint8_t *buffer, uint16_t size) {
@@ -302,5 +322,9 @@ int updi_write_data_words(const PROGRAMMER *pgm, uint32_t address, uint8_t *buff
     avrdude_message(MSG_DEBUG, "%s: ST_PTR operation failed\n", progname);
     return -1;
   }
-  return updi_link_st_ptr_inc16_RSD(pgm, buffer, size >> 1, -1);
+  if (updi_link_st_ptr_inc16_RSD(pgm, buffer, size >> 1, -1) < 0) {
+    avrdude_message(MSG_DEBUG, "%s: ST_PTR_INC16 burst operation failed\n", progname);
+    return -1;
+  }
+  return updi_check_burst(pgm);
 }
@@ -56,3 +56,39 @@ updi_rts_mode updi_get_rts_mode(const PROGRAMMER *pgm) {
 void updi_set_rts_mode(const PROGRAMMER *pgm, updi_rts_mode mode) {
   ((updi_state *)(pgm->cookie))->rts_mode = mode;
 }
+
+updi_nvm_timing* updi_get_nvm_timing(const PROGRAMMER *pgm) {
+  return &((updi_state *)(pgm->cookie))->nvm_timing;
+}
+
+long updi_get_turbo_baud(const PROGRAMMER *pgm) {
+  return ((updi_state *)(pgm->cookie))->turbo_baud;
+}
+
+void updi_set_turbo_baud(const PROGRAMMER *pgm, long baud) {
+  ((updi_state *)(pgm->cookie))->turbo_baud = baud;
+}
+
+uint8_t updi_get_updi_clock(const PROGRAMMER *pgm) {
+  return ((updi_state *)(pgm->cookie))->updi_clock;
+}
+
+void updi_set_updi_clock(const PROGRAMMER *pgm, uint8_t mhz) {
+  ((updi_state *)(pgm->cookie))->updi_clock = mhz;
+}
+
+long updi_get_link_baud(const PROGRAMMER *pgm) {
+  return ((updi_state *)(pgm->cookie))->link_baud;
+}
+
+void updi_set_link_baud(const PROGRAMMER *pgm, long baud) {
+  ((updi_state *)(pgm->cookie))->link_baud = baud;
+}
+
+uint8_t updi_get_guard_time(const PROGRAMMER *pgm) {
+  return ((updi_state *)(pgm->cookie))->guard_time;
+}
+
+void updi_set_guard_time(const PROGRAMMER *pgm, uint8_t gtval) {
+  ((updi_state *)(pgm->cookie))->guard_time = gtval;
+}
@@ -68,12 +68,39 @@ typedef enum
   RTS_MODE_HIGH
 } updi_rts_mode;
 
+#define UPDI_NVM_TIMING_SLOTS 8
+
+typedef struct
+{
+  uint8_t command;              /* NVM controller command */
+  unsigned int waits;           /* completed waits for this command */
+  unsigned long estimate;       /* learned duration in us */
+  unsigned long polls;          /* status polls issued */
+  unsigned long slept;          /* time spent sleeping in us */
+  unsigned long total;          /* total time waited in us */
+} updi_nvm_cmd_timing;
+
+typedef struct
+{
+  bool pending;                 /* a command is waiting for completion */
+  uint8_t command;              /* last NVM command issued */
+  unsigned long start;          /* when it was issued, in us */
+  unsigned long poll;           /* running average of one status poll in us */
+  int nslots;
+  updi_nvm_cmd_timing slot[UPDI_NVM_TIMING_SLOTS];
+} updi_nvm_timing;
+
 typedef struct
 {
   updi_sib_info sib_info;
   updi_datalink_mode datalink_mode;
   updi_nvm_mode nvm_mode;
   updi_rts_mode rts_mode;
+  updi_nvm_timing nvm_timing;
+  long turbo_baud;              /* max baud rate to negotiate, 0: off */
+  uint8_t updi_clock;           /* UPDI clock in MHz for turbo, 0: 4 or 8 MHz */
+  long link_baud;               /* negotiated baud rate, 0: initial rate */
+  uint8_t guard_time;           /* GTVAL for CS CTRLA */
 } updi_state;
 
 #ifdef __cplusplus
@@ -87,6 +114,15 @@ updi_nvm_mode updi_get_nvm_mode(const PROGRAMMER *pgm);
 void updi_set_nvm_mode(const PROGRAMMER *pgm, updi_nvm_mode mode);
 updi_rts_mode updi_get_rts_mode(const PROGRAMMER *pgm);
 void updi_set_rts_mode(const PROGRAMMER *pgm, updi_rts_mode mode);
+updi_nvm_timing* updi_get_nvm_timing(const PROGRAMMER *pgm);
+long updi_get_turbo_baud(const PROGRAMMER *pgm);
+void updi_set_turbo_baud(const PROGRAMMER *pgm, long baud);
+uint8_t updi_get_updi_clock(const PROGRAMMER *pgm);
+void updi_set_updi_clock(const PROGRAMMER *pgm, uint8_t mhz);
+long updi_get_link_baud(const PROGRAMMER *pgm);
+void updi_set_link_baud(const PROGRAMMER *pgm, long baud);
+uint8_t updi_get_guard_time(const PROGRAMMER *pgm);
+void updi_set_guard_time(const PROGRAMMER *pgm, uint8_t gtval);
 
 #ifdef __cplusplus
 }
@@ -35,12 +35,30 @@
 #include <sys/types.h>
 #include <sys/time.h>
 
-#if defined(HAVE_USB_H)
+/*
+ * The queued libusb-1.0 read path is opt-in (--enable-libusb-1-0-async
+ * or -D USE_LIBUSB_1_0_ASYNC=ON); otherwise libusb-0.1 is used as before.
+ * Windows installations commonly bind the programmers to the libusb-win32
+ * driver, which libusb-1.0 cannot always reach.
+ */
+#if defined(HAVE_LIBUSB_1_0) && defined(USE_LIBUSB_1_0_ASYNC)
+# define USE_LIBUSB_1_0
+#endif
+
+#if defined(USE_LIBUSB_1_0)
+# if defined(HAVE_LIBUSB_1_0_LIBUSB_H)
+#  include <libusb-1.0/libusb.h>
+# else
+#  include <libusb.h>
+# endif
+#else
+# if defined(HAVE_USB_H)
 #  include <usb.h>
-#elif defined(HAVE_LUSB0_USB_H)
+# elif defined(HAVE_LUSB0_USB_H)
 #  include <lusb0_usb.h>
-#else
+# else
 #  error "libusb needs either <usb.h> or <lusb0_usb.h>"
+# endif
 #endif
 
 #include "avrdude.h"
@@ -53,10 +71,528 @@
 #  undef interface
 #endif
 
-static char usbbuf[USBDEV_MAX_XFER_3];
-static int buflen = -1, bufptr;
+/* Time to wait for a read or write to complete, in milliseconds */
+#define USBDEV_TIMEOUT 10000
+
+#if defined(USE_LIBUSB_1_0)
+
+/*
+ * Number of read transfers kept queued on the read endpoint.  Each of
+ * them covers one packet, so the device can stream up to this many
+ * packets back-to-back without waiting for the host to ask for more.
+ */
+#define USBDEV_NXFER 8
+
+struct usbxfer {
+  struct libusb_transfer *t;
+  int busy;                     /* submitted and not yet collected */
+  int done;                     /* set by the completion callback */
+  unsigned char buf[USBDEV_MAX_XFER_3];
+};
+
+typedef libusb_device usblib_device;
+typedef libusb_device_handle usblib_handle;
+typedef struct libusb_device_descriptor usblib_device_descriptor;
+typedef struct libusb_config_descriptor usblib_config;
+typedef struct libusb_interface_descriptor usblib_altsetting;
+
+#define USBLIB_CLASS_HID LIBUSB_CLASS_HID
+#define USBLIB_ENDPOINT_DIR_MASK LIBUSB_ENDPOINT_DIR_MASK
+
+#else
+
+typedef struct usb_device usblib_device;
+typedef usb_dev_handle usblib_handle;
+typedef struct usb_device_descriptor usblib_device_descriptor;
+typedef struct usb_config_descriptor usblib_config;
+typedef struct usb_interface_descriptor usblib_altsetting;
+
+#define USBLIB_CLASS_HID USB_CLASS_HID
+#define USBLIB_ENDPOINT_DIR_MASK USB_ENDPOINT_DIR_MASK
+
+#endif
+
+/*
+ * Per-connection state; fd->usb.handle points to one of these so that
+ * several devices can be open at the same time
+ */
+struct usbdev {
+  usblib_handle *udev;
+  int interface;                /* claimed interface number */
+  int buflen, bufptr;           /* read buffer fill level and position */
+  unsigned char buf[USBDEV_MAX_XFER_3]; /* read buffer */
+#if defined(USE_LIBUSB_1_0)
+  libusb_context *ctx;
+  int started;                  /* read transfers have been queued */
+  int head;                     /* oldest queued transfer */
+  struct usbxfer xfer[USBDEV_NXFER];
+#endif
+};
+
+/*
+ * Thin wrappers around the libusb-1.0 and libusb-0.1 calls, so that
+ * opening, sending and frame handling below are written only once.
+ * Calls that can fail return < 0 on error; usblib_strerror() turns
+ * that into a message.
+ */
+#if defined(USE_LIBUSB_1_0)
+
+static const char *usblib_strerror(int rv) {
+  return libusb_error_name(rv);
+}
+
+static int usblib_init(struct usbdev *ud) {
+  return libusb_init(&ud->ctx);
+}
+
+static void usblib_exit(struct usbdev *ud) {
+  libusb_exit(ud->ctx);
+}
+
+static int usblib_devices(struct usbdev *ud, usblib_device ***devlist) {
+  return (int) libusb_get_device_list(ud->ctx, devlist);
+}
+
+static void usblib_free_devices(usblib_device **devlist) {
+  libusb_free_device_list(devlist, 1);
+}
+
+static int usblib_descriptor(usblib_device *dev, usblib_device_descriptor *desc) {
+  return libusb_get_device_descriptor(dev, desc);
+}
+
+static int usblib_open(usblib_device *dev, usblib_handle **udev) {
+  return libusb_open(dev, udev);
+}
+
+static void usblib_close(usblib_handle *udev) {
+  libusb_close(udev);
+}
+
+static int usblib_string(usblib_handle *udev, int index, char *buf, size_t len) {
+  return libusb_get_string_descriptor_ascii(udev, index, (unsigned char *) buf, len);
+}
+
+static int usblib_get_config(usblib_device *dev, usblib_config **config) {
+  return libusb_get_config_descriptor(dev, 0, config);
+}
+
+static void usblib_free_config(usblib_config *config) {
+  libusb_free_config_descriptor(config);
+}
+
+static int usblib_set_config(usblib_handle *udev, int value) {
+  return libusb_set_configuration(udev, value);
+}
+
+static void usblib_detach_driver(usblib_handle *udev, int interface) {
+  if (libusb_kernel_driver_active(udev, interface) == 1)
+    (void)libusb_detach_kernel_driver(udev, interface);
+}
+
+static int usblib_claim(usblib_handle *udev, int interface) {
+  return libusb_claim_interface(udev, interface);
+}
+
+static void usblib_release(usblib_handle *udev, int interface) {
+  (void)libusb_release_interface(udev, interface);
+}
+
+static void usblib_reset(usblib_handle *udev) {
+  (void)libusb_reset_device(udev);
+}
+
+static int usblib_set_idle(usblib_handle *udev) {
+  return libusb_control_transfer(udev, 0x21, 0x0a /* SET_IDLE */, 0, 0, NULL, 0, 100);
+}
+
+static int usblib_write(usblib_handle *udev, int ep, const unsigned char *buf, int len,
+                        int use_interrupt_xfer) {
+  int rv, xferred = 0;
+
+  if (use_interrupt_xfer)
+    rv = libusb_interrupt_transfer(udev, ep, (unsigned char *)buf, len, &xferred, USBDEV_TIMEOUT);
+  else
+    rv = libusb_bulk_transfer(udev, ep, (unsigned char *)buf, len, &xferred, USBDEV_TIMEOUT);
+
+  return rv < 0? rv: xferred;
+}
+
+static int usblib_read(usblib_handle *udev, int ep, unsigned char *buf, int len,
+                       int use_interrupt_xfer, int timeout) {
+  int rv, xferred = 0;
+
+  if (use_interrupt_xfer)
+    rv = libusb_interrupt_transfer(udev, ep, buf, len, &xferred, timeout);
+  else
+    rv = libusb_bulk_transfer(udev, ep, buf, len, &xferred, timeout);
+
+  return rv < 0? rv: xferred;
+}
+
+#else
+
+static const char *usblib_strerror(int rv) {
+  return usb_strerror();
+}
+
+static int usblib_init(struct usbdev *ud) {
+  usb_init();
+
+  usb_find_busses();
+  usb_find_devices();
+
+  return 0;
+}
+
+static void usblib_exit(struct usbdev *ud) {
+}
+
+static int usblib_devices(struct usbdev *ud, usblib_device ***devlist) {
+  struct usb_bus *bus;
+  struct usb_device *dev;
+  int n = 0;
+
+  for (bus = usb_get_busses(); bus; bus = bus->next)
+    for (dev = bus->devices; dev; dev = dev->next)
+      n++;
+  *devlist = cfg_malloc("usblib_devices()", (n + 1) * sizeof **devlist);
+  n = 0;
+  for (bus = usb_get_busses(); bus; bus = bus->next)
+    for (dev = bus->devices; dev; dev = dev->next)
+      (*devlist)[n++] = dev;
+
+  return n;
+}
+
+static void usblib_free_devices(usblib_device **devlist) {
+  free(devlist);
+}
+
+static int usblib_descriptor(usblib_device *dev, usblib_device_descriptor *desc) {
+  *desc = dev->descriptor;
+  return 0;
+}
+
+static int usblib_open(usblib_device *dev, usblib_handle **udev) {
+  return (*udev = usb_open(dev))? 0: -1;
+}
+
+static void usblib_close(usblib_handle *udev) {
+  usb_close(udev);
+}
+
+static int usblib_string(usblib_handle *udev, int index, char *buf, size_t len) {
+  return usb_get_string_simple(udev, index, buf, len);
+}
+
+static int usblib_get_config(usblib_device *dev, usblib_config **config) {
+  return (*config = dev->config)? 0: -1;
+}
+
+static void usblib_free_config(usblib_config *config) {
+}
+
+static int usblib_set_config(usblib_handle *udev, int value) {
+  return usb_set_configuration(udev, value)? -1: 0;
+}
+
+static void usblib_detach_driver(usblib_handle *udev, int interface) {
+#ifdef LIBUSB_HAS_GET_DRIVER_NP
+  (void)usb_detach_kernel_driver_np(udev, interface);
+#endif
+}
+
+static int usblib_claim(usblib_handle *udev, int interface) {
+  return usb_claim_interface(udev, interface)? -1: 0;
+}
+
+static void usblib_release(usblib_handle *udev, int interface) {
+  (void)usb_release_interface(udev, interface);
+}
+
+static void usblib_reset(usblib_handle *udev) {
+  usb_reset(udev);
+}
+
+static int usblib_set_idle(usblib_handle *udev) {
+  return usb_control_msg(udev, 0x21, 0x0a /* SET_IDLE */, 0, 0, NULL, 0, 100);
+}
+
+static int usblib_write(usblib_handle *udev, int ep, const unsigned char *buf, int len,
+                        int use_interrupt_xfer) {
+  if (use_interrupt_xfer)
+    return usb_interrupt_write(udev, ep, (char *)buf, len, USBDEV_TIMEOUT);
+  return usb_bulk_write(udev, ep, (char *)buf, len, USBDEV_TIMEOUT);
+}
+
+static int usblib_read(usblib_handle *udev, int ep, unsigned char *buf, int len,
+                       int use_interrupt_xfer, int timeout) {
+  if (use_interrupt_xfer)
+    return usb_interrupt_read(udev, ep, (char *)buf, len, timeout);
+  return usb_bulk_read(udev, ep, (char *)buf, len, timeout);
+}
+
+#endif
+
+/*
+ * Reading the next packet is where the two libraries differ: libusb-1.0
+ * keeps read transfers queued on the read endpoint, libusb-0.1 issues
+ * one synchronous read per packet.  Either way, usb_fill_buf() puts the
+ * next packet into ud->buf, from where the single-char read requests
+ * performed by the upper layers are served.
+ */
+#if defined(USE_LIBUSB_1_0)
+
+static void LIBUSB_CALL usb_xfer_done(struct libusb_transfer *t)
+{
+  struct usbxfer *x = (struct usbxfer *)t->user_data;
+
+  x->done = 1;
+}
+
+static int usb_submit_xfer(struct usbdev *ud, const union filedescriptor *fd, struct usbxfer *x)
+{
+  int rv;
+
+  x->done = 0;
+  if (fd->usb.use_interrupt_xfer)
+    libusb_fill_interrupt_transfer(x->t, ud->udev, fd->usb.rep, x->buf, fd->usb.max_xfer,
+                                   usb_xfer_done, x, 0);
+  else
+    libusb_fill_bulk_transfer(x->t, ud->udev, fd->usb.rep, x->buf, fd->usb.max_xfer,
+                              usb_xfer_done, x, 0);
+  if ((rv = libusb_submit_transfer(x->t)) < 0)
+    {
+      avrdude_message(MSG_INFO, "%s: usb_submit_xfer(): cannot submit %s transfer: %s\n",
+                      progname, (fd->usb.use_interrupt_xfer? "interrupt": "bulk"),
+                      libusb_error_name(rv));
+      return -1;
+    }
+  x->busy = 1;
+
+  return 0;
+}
+
+/*
+ * Cancel all queued read transfers and wait until libusb has given
+ * them back.  Data that were already received but not yet consumed
+ * are lost; the queue is restarted by the next read.
+ */
+static void usb_cancel_xfers(struct usbdev *ud)
+{
+  struct timeval tv;
+  int i, pending;
+
+  for (i = 0; i < USBDEV_NXFER; i++)
+    if (ud->xfer[i].busy && !ud->xfer[i].done)
+      (void)libusb_cancel_transfer(ud->xfer[i].t);
+
+  do
+    {
+      for (pending = 0, i = 0; i < USBDEV_NXFER; i++)
+        if (ud->xfer[i].busy && !ud->xfer[i].done)
+          pending++;
+      if (pending)
+        {
+          tv.tv_sec = 0;
+          tv.tv_usec = 100000;
+          if (libusb_handle_events_timeout_completed(ud->ctx, &tv, NULL) < 0)
+            break;
+        }
+    }
+  while (pending);
+
+  for (i = 0; i < USBDEV_NXFER; i++)
+    ud->xfer[i].busy = ud->xfer[i].done = 0;
+  ud->head = 0;
+  ud->started = 0;
+}
+
+/*
+ * Hand the oldest transfer back to libusb once its data have been
+ * copied out.  Transfers are requeued in the order they were taken
+ * from the queue, so the data keep arriving in order.
+ */
+static void usb_release_xfer(struct usbdev *ud, const union filedescriptor *fd, struct usbxfer *x)
+{
+  ud->head = (ud->head + 1) % USBDEV_NXFER;
+  if (usb_submit_xfer(ud, fd, x) < 0)
+    usb_cancel_xfers(ud);
+}
+
+static int usb_fill_buf(struct usbdev *ud, const union filedescriptor *fd, const char *caller)
+{
+  struct usbxfer *x;
+  struct timeval tv, now, deadline;
+  long usec;
+  int i, rv;
+
+  if (!ud->started)
+    {
+      for (i = 0; i < USBDEV_NXFER; i++)
+        if (usb_submit_xfer(ud, fd, &ud->xfer[i]) < 0)
+          {
+            usb_cancel_xfers(ud);
+            return -1;
+          }
+      ud->started = 1;
+    }
+
+  x = &ud->xfer[ud->head];
+  gettimeofday(&deadline, NULL);
+  deadline.tv_sec += USBDEV_TIMEOUT / 1000;
+  deadline.tv_usec += (USBDEV_TIMEOUT % 1000) * 1000;
+  while (!x->done)
+    {
+      gettimeofday(&now, NULL);
+      usec = (deadline.tv_sec - now.tv_sec) * 1000000L + (deadline.tv_usec - now.tv_usec);
+      if (usec <= 0)
+        {
+          avrdude_message(MSG_NOTICE2, "%s: %s(): read timed out\n",
+                          progname, caller);
+          return -1;
+        }
+      tv.tv_sec = usec / 1000000L;
+      tv.tv_usec = usec % 1000000L;
+      rv = libusb_handle_events_timeout_completed(ud->ctx, &tv, &x->done);
+      if (rv < 0 && rv != LIBUSB_ERROR_INTERRUPTED)
+        {
+          avrdude_message(MSG_NOTICE2, "%s: %s(): libusb_handle_events(): %s\n",
+                          progname, caller, libusb_error_name(rv));
+          return -1;
+        }
+    }
+  x->busy = 0;
+
+  if (x->t->status != LIBUSB_TRANSFER_COMPLETED)
+    {
+      avrdude_message(MSG_NOTICE2, "%s: %s(): %s transfer failed, status %d\n",
+                      progname, caller, (fd->usb.use_interrupt_xfer? "interrupt": "bulk"),
+                      (int)x->t->status);
+      usb_release_xfer(ud, fd, x);
+      return -1;
+    }
+
+  memcpy(ud->buf, x->buf, x->t->actual_length);
+  ud->buflen = x->t->actual_length;
+  ud->bufptr = 0;
+  usb_release_xfer(ud, fd, x);
+
+  return 0;
+}
+
+static int usb_alloc_xfers(struct usbdev *ud)
+{
+  int i;
+
+  for (i = 0; i < USBDEV_NXFER; i++)
+    if ((ud->xfer[i].t = libusb_alloc_transfer(0)) == NULL)
+      {
+        avrdude_message(MSG_INFO, "%s: usbdev_open(): out of memory allocating transfers\n",
+                        progname);
+        while (--i >= 0)
+          libusb_free_transfer(ud->xfer[i].t);
+        return -1;
+      }
+
+  return 0;
+}
+
+static void usb_free_xfers(struct usbdev *ud)
+{
+  int i;
+
+  usb_cancel_xfers(ud);
+  for (i = 0; i < USBDEV_NXFER; i++)
+    libusb_free_transfer(ud->xfer[i].t);
+}
+
+/*
+ * Read transfers that are still queued may already hold data the
+ * device sent before the last command.  Cancel and reap them, and
+ * throw away whatever they received; the queue is restarted by the
+ * next read.
+ */
+static int usbdev_drain(const union filedescriptor *fd, int display)
+{
+  struct usbdev *ud = (struct usbdev *)fd->usb.handle;
+  int i, j;
+
+  if (ud == NULL)
+    return -1;
+
+  if (display)
+    {
+      avrdude_message(MSG_INFO, "drain>");
+      for (j = ud->bufptr; j < ud->buflen; j++)
+        avrdude_message(MSG_INFO, "%02x ", ud->buf[j]);
+      for (i = 0; i < USBDEV_NXFER; i++)
+        {
+          struct usbxfer *x = &ud->xfer[(ud->head + i) % USBDEV_NXFER];
+
+          if (x->busy && x->done && x->t->status == LIBUSB_TRANSFER_COMPLETED)
+            for (j = 0; j < x->t->actual_length; j++)
+              avrdude_message(MSG_INFO, "%02x ", x->buf[j]);
+        }
+    }
+  ud->buflen = ud->bufptr = 0;
+  usb_cancel_xfers(ud);
+
+  if (display)
+    avrdude_message(MSG_INFO, "<drain\n");
+
+  return 0;
+}
+
+#else
+
+static int usb_fill_buf(struct usbdev *ud, const union filedescriptor *fd, const char *caller)
+{
+  int rv;
+
+  rv = usblib_read(ud->udev, fd->usb.rep, ud->buf, fd->usb.max_xfer,
+                   fd->usb.use_interrupt_xfer, USBDEV_TIMEOUT);
+  if (rv < 0)
+    {
+      avrdude_message(MSG_NOTICE2, "%s: %s(): usb_%s_read() error %s\n",
+		progname, caller, (fd->usb.use_interrupt_xfer? "interrupt": "bulk"),
+		usb_strerror());
+      return -1;
+    }
 
-static int usb_interface;
+  ud->buflen = rv;
+  ud->bufptr = 0;
+
+  return 0;
+}
+
+static int usb_alloc_xfers(struct usbdev *ud)
+{
+  return 0;
+}
+
+static void usb_free_xfers(struct usbdev *ud)
+{
+}
+
+static int usbdev_drain(const union filedescriptor *fd, int display)
+{
+  /*
+   * There is not much point in trying to flush any data
+   * on an USB endpoint, as the endpoint is supposed to
+   * start afresh after being configured from the host.
+   *
+   * As trying to flush the data here caused strange effects
+   * in some situations (see
+   * https://savannah.nongnu.org/bugs/index.php?43268 )
+   * better avoid it.
+   */
+
+  return 0;
+}
+
+#endif  /* USE_LIBUSB_1_0 */
 
 /*
  * The "baud" parameter is meaningless for USB devices, so we reuse it
@@ -65,12 +601,16 @@ static int usb_interface;
 static int usbdev_open(const char *port, union pinfo pinfo, union filedescriptor *fd) {
   char string[256];
   char product[256];
-  struct usb_bus *bus;
-  struct usb_device *dev;
-  usb_dev_handle *udev;
+  usblib_device **devlist;
+  usblib_device_descriptor desc;
+  usblib_config *config;
+  const usblib_altsetting *alt;
+  usblib_handle *udev;
   char *serno, *cp2;
-  int i;
+  struct usbdev *ud;
+  int i, j, rv, ndev;
   int iface;
+  int usb_interface = 0;
   size_t x;
 
   /*
@@ -106,213 +646,236 @@ static int usbdev_open(const char *port, union pinfo pinfo, union filedescriptor
   if (fd->usb.max_xfer == 0)
     fd->usb.max_xfer = USBDEV_MAX_XFER_MKII;
 
-  usb_init();
+  ud = cfg_malloc("usbdev_open()", sizeof *ud);
+  if ((rv = usblib_init(ud)) < 0)
+    {
+      avrdude_message(MSG_INFO, "%s: usbdev_open(): cannot initialize libusb: %s\n",
+                      progname, usblib_strerror(rv));
+      free(ud);
+      return -1;
+    }
 
-  usb_find_busses();
-  usb_find_devices();
+  if ((ndev = usblib_devices(ud, &devlist)) < 0)
+    {
+      avrdude_message(MSG_INFO, "%s: usbdev_open(): cannot get USB device list: %s\n",
+                      progname, usblib_strerror(ndev));
+      usblib_exit(ud);
+      free(ud);
+      return -1;
+    }
 
-  for (bus = usb_get_busses(); bus; bus = bus->next)
+  for (j = 0; j < ndev; j++)
     {
-      for (dev = bus->devices; dev; dev = dev->next)
-	{
-	  if (dev->descriptor.idVendor == pinfo.usbinfo.vid &&
-	      dev->descriptor.idProduct == pinfo.usbinfo.pid)
-	    {
-	      udev = usb_open(dev);
-	      if (udev)
-		{
-		  /* yeah, we found something */
-		  if (usb_get_string_simple(udev,
-					    dev->descriptor.iSerialNumber,
-					    string, sizeof(string)) < 0)
-		    {
-		      avrdude_message(MSG_INFO, "%s: usb_open(): cannot read serial number \"%s\"\n",
-                                      progname, usb_strerror());
-		      /*
-		       * On some systems, libusb appears to have
-		       * problems sending control messages.  Catch the
-		       * benign case where the user did not request a
-		       * particular serial number, so we could
-		       * continue anyway.
-		       */
-		      if (serno != NULL)
-			return -1; /* no chance */
-		      else
-			strcpy(string, "[unknown]");
-		    }
-
-		  if (usb_get_string_simple(udev,
-					    dev->descriptor.iProduct,
-					    product, sizeof(product)) < 0)
-		    {
-		      avrdude_message(MSG_INFO, "%s: usb_open(): cannot read product name \"%s\"\n",
-                                      progname, usb_strerror());
-		      strcpy(product, "[unnamed product]");
-		    }
-		  /*
-		   * The CMSIS-DAP specification mandates the string
-		   * "CMSIS-DAP" must be present somewhere in the
-		   * product name string for a device compliant to
-		   * that protocol.  Use this for the decisision
-		   * whether we have to search for a HID interface
-		   * below.
-		   */
-		  if(strstr(product, "CMSIS-DAP") != NULL)
-		  {
-		      pinfo.usbinfo.flags |= PINFO_FL_USEHID;
-		      /* The JTAGICE3 running the CMSIS-DAP firmware doesn't
-		       * use a separate endpoint for event reception. */
-		      fd->usb.eep = 0;
-		  }
-
-		  if(strstr(product, "mEDBG") != NULL)
-		  {
-		      /* The AVR Xplained Mini uses different endpoints. */
-		      fd->usb.rep = 0x81;
-		      fd->usb.wep = 0x02;
-		  }
-
-                  avrdude_message(MSG_NOTICE, "%s: usbdev_open(): Found %s, serno: %s\n",
-                                    progname, product, string);
-		  if (serno != NULL)
-		    {
-		      /*
-		       * See if the serial number requested by the
-		       * user matches what we found, matching
-		       * right-to-left.
-		       */
-		      x = strlen(string) - strlen(serno);
-		      if (strcasecmp(string + x, serno) != 0)
-			{
-                          avrdude_message(MSG_DEBUG, "%s: usbdev_open(): serial number doesn't match\n",
-                                            progname);
-			  usb_close(udev);
-			      continue;
-			}
-		    }
-
-		  if (dev->config == NULL)
-		    {
-		      avrdude_message(MSG_INFO, "%s: usbdev_open(): USB device has no configuration\n",
-                                      progname);
-		      goto trynext;
-		    }
-
-		  if (usb_set_configuration(udev, dev->config[0].bConfigurationValue))
-		    {
-		      avrdude_message(MSG_INFO, "%s: usbdev_open(): WARNING: failed to set configuration %d: %s\n",
-                                      progname, dev->config[0].bConfigurationValue,
-                                      usb_strerror());
-		      /* let's hope it has already been configured */
-		      // goto trynext;
-		    }
-
-		  for (iface = 0; iface < dev->config[0].bNumInterfaces; iface++)
-		    {
-		      usb_interface = dev->config[0].interface[iface].altsetting[0].bInterfaceNumber;
-#ifdef LIBUSB_HAS_GET_DRIVER_NP
-		      /*
-		       * Many Linux systems attach the usbhid driver
-		       * by default to any HID-class device.  On
-		       * those, the driver needs to be detached before
-		       * we can claim the interface.
-		       */
-		      (void)usb_detach_kernel_driver_np(udev, usb_interface);
-#endif
-		      if (usb_claim_interface(udev, usb_interface))
-			{
-			  avrdude_message(MSG_INFO, "%s: usbdev_open(): error claiming interface %d: %s\n",
-                                          progname, usb_interface, usb_strerror());
-			}
-		      else
-			{
-			  if (pinfo.usbinfo.flags & PINFO_FL_USEHID)
-			    {
-			      /* only consider an interface that is of class HID */
-			      if (dev->config[0].interface[iface].altsetting[0].bInterfaceClass !=
-				  USB_CLASS_HID)
-				continue;
-			      fd->usb.use_interrupt_xfer = 1;
-			    }
-			  break;
-			}
-		    }
-		  if (iface == dev->config[0].bNumInterfaces)
-		    {
-		      avrdude_message(MSG_INFO, "%s: usbdev_open(): no usable interface found\n",
-                                      progname);
-		      goto trynext;
-		    }
-
-		  fd->usb.handle = udev;
-		  if (fd->usb.rep == 0)
-		    {
-		      /* Try finding out what our read endpoint is. */
-		      for (i = 0; i < dev->config[0].interface[iface].altsetting[0].bNumEndpoints; i++)
-			{
-			  int possible_ep = dev->config[0].interface[iface].altsetting[0].
-			  endpoint[i].bEndpointAddress;
-
-			  if ((possible_ep & USB_ENDPOINT_DIR_MASK) != 0)
-			    {
-                              avrdude_message(MSG_NOTICE2, "%s: usbdev_open(): using read endpoint 0x%02x\n",
-                                                  progname, possible_ep);
-			      fd->usb.rep = possible_ep;
-			      break;
-			    }
-			}
-		      if (fd->usb.rep == 0)
-			{
-			  avrdude_message(MSG_INFO, "%s: usbdev_open(): cannot find a read endpoint, using 0x%02x\n",
-                                          progname, USBDEV_BULK_EP_READ_MKII);
-			  fd->usb.rep = USBDEV_BULK_EP_READ_MKII;
-			}
-		    }
-		  for (i = 0; i < dev->config[0].interface[iface].altsetting[0].bNumEndpoints; i++)
-		    {
-		      if ((dev->config[0].interface[iface].altsetting[0].endpoint[i].bEndpointAddress == fd->usb.rep ||
-			   dev->config[0].interface[iface].altsetting[0].endpoint[i].bEndpointAddress == fd->usb.wep) &&
-			  dev->config[0].interface[iface].altsetting[0].endpoint[i].wMaxPacketSize < fd->usb.max_xfer)
-			{
-                          avrdude_message(MSG_NOTICE, "%s: max packet size expected %d, but found %d due to EP 0x%02x's wMaxPacketSize\n",
-                                            progname,
-                                            fd->usb.max_xfer,
-                                            dev->config[0].interface[iface].altsetting[0].endpoint[i].wMaxPacketSize,
-                                            dev->config[0].interface[iface].altsetting[0].endpoint[i].bEndpointAddress);
-			  fd->usb.max_xfer = dev->config[0].interface[iface].altsetting[0].endpoint[i].wMaxPacketSize;
-			}
-		    }
-		  if (pinfo.usbinfo.flags & PINFO_FL_USEHID)
-		    {
-		      if (usb_control_msg(udev, 0x21, 0x0a /* SET_IDLE */, 0, 0, NULL, 0, 100) < 0)
-			avrdude_message(MSG_INFO, "%s: usbdev_open(): SET_IDLE failed\n", progname);
-		    }
-		  return 0;
-		  trynext:
-		  usb_close(udev);
-		}
-	      else
-		avrdude_message(MSG_INFO, "%s: usbdev_open(): cannot open device: %s\n",
-                                progname, usb_strerror());
-	    }
-	}
+      if (usblib_descriptor(devlist[j], &desc) < 0 ||
+          desc.idVendor != pinfo.usbinfo.vid ||
+          desc.idProduct != pinfo.usbinfo.pid)
+        continue;
+
+      if ((rv = usblib_open(devlist[j], &udev)) < 0)
+        {
+          avrdude_message(MSG_INFO, "%s: usbdev_open(): cannot open device: %s\n",
+                          progname, usblib_strerror(rv));
+          continue;
+        }
+
+      /* yeah, we found something */
+      if ((rv = usblib_string(udev, desc.iSerialNumber, string, sizeof(string))) < 0)
+        {
+          avrdude_message(MSG_INFO, "%s: usb_open(): cannot read serial number \"%s\"\n",
+                          progname, usblib_strerror(rv));
+          /*
+           * On some systems, libusb appears to have problems sending
+           * control messages.  Catch the benign case where the user
+           * did not request a particular serial number, so we could
+           * continue anyway.
+           */
+          if (serno != NULL)
+            {
+              usblib_close(udev);
+              break; /* no chance */
+            }
+          else
+            strcpy(string, "[unknown]");
+        }
+
+      if ((rv = usblib_string(udev, desc.iProduct, product, sizeof(product))) < 0)
+        {
+          avrdude_message(MSG_INFO, "%s: usb_open(): cannot read product name \"%s\"\n",
+                          progname, usblib_strerror(rv));
+          strcpy(product, "[unnamed product]");
+        }
+      /*
+       * The CMSIS-DAP specification mandates the string "CMSIS-DAP"
+       * must be present somewhere in the product name string for a
+       * device compliant to that protocol.  Use this for the
+       * decisision whether we have to search for a HID interface
+       * below.
+       */
+      if(strstr(product, "CMSIS-DAP") != NULL)
+      {
+          pinfo.usbinfo.flags |= PINFO_FL_USEHID;
+          /* The JTAGICE3 running the CMSIS-DAP firmware doesn't
+           * use a separate endpoint for event reception. */
+          fd->usb.eep = 0;
+      }
+
+      if(strstr(product, "mEDBG") != NULL)
+      {
+          /* The AVR Xplained Mini uses different endpoints. */
+          fd->usb.rep = 0x81;
+          fd->usb.wep = 0x02;
+      }
+
+      avrdude_message(MSG_NOTICE, "%s: usbdev_open(): Found %s, serno: %s\n",
+                      progname, product, string);
+      if (serno != NULL)
+        {
+          /*
+           * See if the serial number requested by the user matches
+           * what we found, matching right-to-left.
+           */
+          x = strlen(string) - strlen(serno);
+          if (strcasecmp(string + x, serno) != 0)
+            {
+              avrdude_message(MSG_DEBUG, "%s: usbdev_open(): serial number doesn't match\n",
+                              progname);
+              usblib_close(udev);
+              continue;
+            }
+        }
+
+      if (usblib_get_config(devlist[j], &config) < 0)
+        {
+          avrdude_message(MSG_INFO, "%s: usbdev_open(): USB device has no configuration\n",
+                          progname);
+          usblib_close(udev);
+          continue;
+        }
+
+      if ((rv = usblib_set_config(udev, config->bConfigurationValue)) < 0)
+        {
+          avrdude_message(MSG_INFO, "%s: usbdev_open(): WARNING: failed to set configuration %d: %s\n",
+                          progname, config->bConfigurationValue,
+                          usblib_strerror(rv));
+          /* let's hope it has already been configured */
+        }
+
+      alt = NULL;
+      for (iface = 0; iface < config->bNumInterfaces; iface++)
+        {
+          alt = &config->interface[iface].altsetting[0];
+          usb_interface = alt->bInterfaceNumber;
+          /*
+           * Many Linux systems attach the usbhid driver by default to
+           * any HID-class device.  On those, the driver needs to be
+           * detached before we can claim the interface.
+           */
+          usblib_detach_driver(udev, usb_interface);
+          if ((rv = usblib_claim(udev, usb_interface)) < 0)
+            {
+              avrdude_message(MSG_INFO, "%s: usbdev_open(): error claiming interface %d: %s\n",
+                              progname, usb_interface, usblib_strerror(rv));
+            }
+          else
+            {
+              if (pinfo.usbinfo.flags & PINFO_FL_USEHID)
+                {
+                  /* only consider an interface that is of class HID */
+                  if (alt->bInterfaceClass != USBLIB_CLASS_HID)
+                    continue;
+                  fd->usb.use_interrupt_xfer = 1;
+                }
+              break;
+            }
+        }
+      if (iface == config->bNumInterfaces)
+        {
+          avrdude_message(MSG_INFO, "%s: usbdev_open(): no usable interface found\n",
+                          progname);
+          usblib_free_config(config);
+          usblib_close(udev);
+          continue;
+        }
+
+      if (fd->usb.rep == 0)
+        {
+          /* Try finding out what our read endpoint is. */
+          for (i = 0; i < alt->bNumEndpoints; i++)
+            {
+              int possible_ep = alt->endpoint[i].bEndpointAddress;
+
+              if ((possible_ep & USBLIB_ENDPOINT_DIR_MASK) != 0)
+                {
+                  avrdude_message(MSG_NOTICE2, "%s: usbdev_open(): using read endpoint 0x%02x\n",
+                                  progname, possible_ep);
+                  fd->usb.rep = possible_ep;
+                  break;
+                }
+            }
+          if (fd->usb.rep == 0)
+            {
+              avrdude_message(MSG_INFO, "%s: usbdev_open(): cannot find a read endpoint, using 0x%02x\n",
+                              progname, USBDEV_BULK_EP_READ_MKII);
+              fd->usb.rep = USBDEV_BULK_EP_READ_MKII;
+            }
+        }
+      for (i = 0; i < alt->bNumEndpoints; i++)
+        {
+          if ((alt->endpoint[i].bEndpointAddress == fd->usb.rep ||
+               alt->endpoint[i].bEndpointAddress == fd->usb.wep) &&
+              alt->endpoint[i].wMaxPacketSize < fd->usb.max_xfer)
+            {
+              avrdude_message(MSG_NOTICE, "%s: max packet size expected %d, but found %d due to EP 0x%02x's wMaxPacketSize\n",
+                              progname,
+                              fd->usb.max_xfer,
+                              alt->endpoint[i].wMaxPacketSize,
+                              alt->endpoint[i].bEndpointAddress);
+              fd->usb.max_xfer = alt->endpoint[i].wMaxPacketSize;
+            }
+        }
+      usblib_free_config(config);
+
+      if (pinfo.usbinfo.flags & PINFO_FL_USEHID)
+        {
+          if (usblib_set_idle(udev) < 0)
+            avrdude_message(MSG_INFO, "%s: usbdev_open(): SET_IDLE failed\n", progname);
+        }
+
+      ud->udev = udev;
+      ud->interface = usb_interface;
+      if (usb_alloc_xfers(ud) < 0)
+        {
+          usblib_release(udev, usb_interface);
+          usblib_close(udev);
+          goto fail;
+        }
+
+      usblib_free_devices(devlist);
+      fd->usb.handle = ud;
+      return 0;
     }
 
   if ((pinfo.usbinfo.flags & PINFO_FL_SILENT) == 0)
       avrdude_message(MSG_NOTICE, "%s: usbdev_open(): did not find any%s USB device \"%s\" (0x%04x:0x%04x)\n",
 	      progname, serno? " (matching)": "", port,
 	      (unsigned)pinfo.usbinfo.vid, (unsigned)pinfo.usbinfo.pid);
+
+  fail:
+  usblib_free_devices(devlist);
+  usblib_exit(ud);
+  free(ud);
   return -1;
 }
 
 static void usbdev_close(union filedescriptor *fd)
 {
-  usb_dev_handle *udev = (usb_dev_handle *)fd->usb.handle;
+  struct usbdev *ud = (struct usbdev *)fd->usb.handle;
 
-  if (udev == NULL)
+  if (ud == NULL)
     return;
 
-  (void)usb_release_interface(udev, usb_interface);
+  usb_free_xfers(ud);
+  usblib_release(ud->udev, ud->interface);
 
 #if defined(__linux__)
   /*
@@ -320,22 +883,25 @@ static void usbdev_close(union filedescriptor *fd)
    * time we try to connect to it.  This is not necessary on
    * FreeBSD.
    */
-  usb_reset(udev);
+  usblib_reset(ud->udev);
 #endif
 
-  usb_close(udev);
+  usblib_close(ud->udev);
+  usblib_exit(ud);
+  free(ud);
+  fd->usb.handle = NULL;
 }
 
 
 static int usbdev_send(const union filedescriptor *fd, const unsigned char *bp, size_t mlen)
 {
-  usb_dev_handle *udev = (usb_dev_handle *)fd->usb.handle;
+  struct usbdev *ud = (struct usbdev *)fd->usb.handle;
   int rv;
   int i = mlen;
   const unsigned char * p = bp;
   int tx_size;
 
-  if (udev == NULL)
+  if (ud == NULL)
     return -1;
 
   /*
@@ -347,14 +913,11 @@ static int usbdev_send(const union filedescriptor *fd, const unsigned char *bp,
    */
   do {
     tx_size = (mlen < fd->usb.max_xfer)? mlen: fd->usb.max_xfer;
-    if (fd->usb.use_interrupt_xfer)
-      rv = usb_interrupt_write(udev, fd->usb.wep, (char *)bp, tx_size, 10000);
-    else
-      rv = usb_bulk_write(udev, fd->usb.wep, (char *)bp, tx_size, 10000);
+    rv = usblib_write(ud->udev, fd->usb.wep, bp, tx_size, fd->usb.use_interrupt_xfer);
     if (rv != tx_size)
     {
         avrdude_message(MSG_INFO, "%s: usbdev_send(): wrote %d out of %d bytes, err = %s\n",
-                progname, rv, tx_size, usb_strerror());
+                progname, rv, tx_size, usblib_strerror(rv));
         return -1;
     }
     bp += tx_size;
@@ -383,56 +946,25 @@ static int usbdev_send(const union filedescriptor *fd, const unsigned char *bp,
   return 0;
 }
 
-/*
- * As calls to usb_bulk_read() result in exactly one USB request, we
- * have to buffer the read results ourselves, so the single-char read
- * requests performed by the upper layers will be handled.  In order
- * to do this, we maintain a private buffer of what we've got so far,
- * and transparently issue another USB read request if the buffer is
- * empty and more data are requested.
- */
-static int
-usb_fill_buf(usb_dev_handle *udev, int maxsize, int ep, int use_interrupt_xfer)
-{
-  int rv;
-
-  if (use_interrupt_xfer)
-    rv = usb_interrupt_read(udev, ep, usbbuf, maxsize, 10000);
-  else
-    rv = usb_bulk_read(udev, ep, usbbuf, maxsize, 10000);
-  if (rv < 0)
-    {
-      avrdude_message(MSG_NOTICE2, "%s: usb_fill_buf(): usb_%s_read() error %s\n",
-		progname, (use_interrupt_xfer? "interrupt": "bulk"),
-		usb_strerror());
-      return -1;
-    }
-
-  buflen = rv;
-  bufptr = 0;
-
-  return 0;
-}
-
 static int usbdev_recv(const union filedescriptor *fd, unsigned char *buf, size_t nbytes)
 {
-  usb_dev_handle *udev = (usb_dev_handle *)fd->usb.handle;
+  struct usbdev *ud = (struct usbdev *)fd->usb.handle;
   int i, amnt;
   unsigned char * p = buf;
 
-  if (udev == NULL)
+  if (ud == NULL)
     return -1;
 
   for (i = 0; nbytes > 0;)
     {
-      if (buflen <= bufptr)
+      if (ud->buflen <= ud->bufptr)
 	{
-	  if (usb_fill_buf(udev, fd->usb.max_xfer, fd->usb.rep, fd->usb.use_interrupt_xfer) < 0)
+	  if (usb_fill_buf(ud, fd, "usbdev_recv") < 0)
 	    return -1;
 	}
-      amnt = buflen - bufptr > nbytes? nbytes: buflen - bufptr;
-      memcpy(buf + i, usbbuf + bufptr, amnt);
-      bufptr += amnt;
+      amnt = ud->buflen - ud->bufptr > nbytes? nbytes: ud->buflen - ud->bufptr;
+      memcpy(buf + i, ud->buf + ud->bufptr, amnt);
+      ud->bufptr += amnt;
       nbytes -= amnt;
       i += amnt;
     }
@@ -471,22 +1003,25 @@ static int usbdev_recv(const union filedescriptor *fd, unsigned char *buf, size_
  */
 static int usbdev_recv_frame(const union filedescriptor *fd, unsigned char *buf, size_t nbytes)
 {
-  usb_dev_handle *udev = (usb_dev_handle *)fd->usb.handle;
+  struct usbdev *ud = (struct usbdev *)fd->usb.handle;
   int rv, n;
   int i;
   unsigned char * p = buf;
 
-  if (udev == NULL)
+  if (ud == NULL)
     return -1;
 
   /* If there's an event EP, and it has data pending, return it first. */
   if (fd->usb.eep != 0)
   {
-      rv = usb_bulk_read(udev, fd->usb.eep, usbbuf,
-                         fd->usb.max_xfer, 1);
+      unsigned char evbuf[USBDEV_MAX_XFER_3];
+
+      rv = usblib_read(ud->udev, fd->usb.eep, evbuf, fd->usb.max_xfer, 0, 1);
       if (rv > 4)
       {
-	  memcpy(buf, usbbuf, rv);
+	  if (rv > nbytes)
+	    return -1; // buffer overflow
+	  memcpy(buf, evbuf, rv);
 	  n = rv;
 	  n |= USB_RECV_FLAG_EVENT;
 	  goto printout;
@@ -501,26 +1036,17 @@ static int usbdev_recv_frame(const union filedescriptor *fd, unsigned char *buf,
   n = 0;
   do
     {
-      if (fd->usb.use_interrupt_xfer)
-	rv = usb_interrupt_read(udev, fd->usb.rep, usbbuf,
-				fd->usb.max_xfer, 10000);
-      else
-	rv = usb_bulk_read(udev, fd->usb.rep, usbbuf,
-			   fd->usb.max_xfer, 10000);
-      if (rv < 0)
-	{
-          avrdude_message(MSG_NOTICE2, "%s: usbdev_recv_frame(): usb_%s_read(): %s\n",
-		    progname, (fd->usb.use_interrupt_xfer? "interrupt": "bulk"),
-		    usb_strerror());
-	  return -1;
-	}
+      if (ud->buflen <= ud->bufptr && usb_fill_buf(ud, fd, "usbdev_recv_frame") < 0)
+	return -1;
 
+      rv = ud->buflen - ud->bufptr;
       if (rv <= nbytes)
 	{
-	  memcpy (buf, usbbuf, rv);
+	  memcpy (buf, ud->buf + ud->bufptr, rv);
 	  buf += rv;
 	}
-      else
+      ud->bufptr = ud->buflen;
+      if (rv > nbytes)
         {
             return -1; // buffer overflow
         }
@@ -569,22 +1095,6 @@ static int usbdev_recv_frame(const union filedescriptor *fd, unsigned char *buf,
   return n;
 }
 
-static int usbdev_drain(const union filedescriptor *fd, int display)
-{
-  /*
-   * There is not much point in trying to flush any data
-   * on an USB endpoint, as the endpoint is supposed to
-   * start afresh after being configured from the host.
-   *
-   * As trying to flush the data here caused strange effects
-   * in some situations (see
-   * https://savannah.nongnu.org/bugs/index.php?43268 )
-   * better avoid it.
-   */
-
-  return 0;
-}
-
 /*
  * Device descriptor for the JTAG ICE mkII.
  */
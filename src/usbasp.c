@@ -64,8 +64,6 @@
 
 #ifdef USE_LIBUSB_1_0
 
-static libusb_context *ctx = NULL;
-
 static const char *errstr(int result)
 {
 	static char msg[30];
@@ -134,6 +132,7 @@ static const char *errstr(int result)
 struct pdata
 {
 #ifdef USE_LIBUSB_1_0
+  libusb_context *ctx;
   libusb_device_handle *usbhandle;
 #else
   usb_dev_handle *usbhandle;
@@ -143,6 +142,11 @@ struct pdata
   int use_tpi;
   int section_e;
   int sck_3mhz;
+  int blocksize;                // Block size requested with -x blocksize, 0: default
+  int addr_valid;               // Firmware address counter is known to be addr_next
+  unsigned int addr_next;
+  unsigned long ntransfers;     // USB control transfers issued
+  unsigned long naddrskip;      // SETLONGADDRESS transfers saved
 };
 
 #define PDATA(pgm) ((struct pdata *)(pgm->cookie))
@@ -160,9 +164,9 @@ static int usbasp_transmit(const PROGRAMMER *pgm, unsigned char receive,
 			   unsigned char functionid, const unsigned char *send,
 			   unsigned char *buffer, int buffersize);
 #ifdef USE_LIBUSB_1_0
-static int usbOpenDevice(libusb_device_handle **device, int vendor, const char *vendorName, int product, const char *productName);
+static int usbOpenDevice(const PROGRAMMER *pgm, libusb_device_handle **device, int vendor, const char *vendorName, int product, const char *productName);
 #else
-static int usbOpenDevice(usb_dev_handle **device, int vendor, const char *vendorName, int product, const char *productName);
+static int usbOpenDevice(const PROGRAMMER *pgm, usb_dev_handle **device, int vendor, const char *vendorName, int product, const char *productName);
 #endif
 // interface - prog.
 static int usbasp_open(PROGRAMMER *pgm, const char *port);
@@ -290,6 +294,20 @@ static int usbasp_parseextparms(const PROGRAMMER *pgm, const LISTID extparms) {
       continue;
     }
 
+    if (strncmp(extended_param, "blocksize=", strlen("blocksize=")) == 0) {
+      int bs;
+      if (sscanf(extended_param, "blocksize=%i", &bs) != 1 || bs < 1 || bs > USBASP_MAXBLOCKSIZE) {
+        avrdude_message(MSG_INFO, "%s: usbasp_parseextparms(): invalid blocksize '%s', must be 1..%d\n",
+                        progname, extended_param, USBASP_MAXBLOCKSIZE);
+        rv = -1;
+        continue;
+      }
+      avrdude_message(MSG_NOTICE2, "%s: usbasp_parseextparms(): set block size to %d\n",
+                      progname, bs);
+      PDATA(pgm)->blocksize = bs;
+      continue;
+    }
+
     avrdude_message(MSG_INFO, "%s: usbasp_parseextparms(): invalid extended parameter '%s'\n",
                     progname, extended_param);
     rv = -1;
@@ -335,6 +353,23 @@ static int usbasp_transmit(const PROGRAMMER *pgm,
 {
   int nbytes;
 
+  /*
+   * The firmware advances its address counter on every block read or
+   * write; anything else (CONNECT resets the long address mode) makes
+   * the tracked address unreliable
+   */
+  switch (functionid) {
+  case USBASP_FUNC_READFLASH:
+  case USBASP_FUNC_READEEPROM:
+  case USBASP_FUNC_WRITEFLASH:
+  case USBASP_FUNC_WRITEEEPROM:
+  case USBASP_FUNC_SETLONGADDRESS:
+    break;
+  default:
+    PDATA(pgm)->addr_valid = 0;
+  }
+  PDATA(pgm)->ntransfers++;
+
   if (verbose > 3) {
     avrdude_message(MSG_TRACE, "%s: usbasp_transmit(\"%s\", 0x%02x, 0x%02x, 0x%02x, 0x%02x)\n",
                     progname,
@@ -358,6 +393,7 @@ static int usbasp_transmit(const PROGRAMMER *pgm,
 				   buffersize & 0xffff,
 				   5000);
   if(nbytes < 0){
+    PDATA(pgm)->addr_valid = 0;
     avrdude_message(MSG_INFO, "%s: error: usbasp_transmit: %s\n", progname, errstr(nbytes));
     return -1;
   }
@@ -370,6 +406,7 @@ static int usbasp_transmit(const PROGRAMMER *pgm,
 			   (char *)buffer, buffersize,
 			   5000);
   if(nbytes < 0){
+    PDATA(pgm)->addr_valid = 0;
     avrdude_message(MSG_INFO, "%s: error: usbasp_transmit: %s\n", progname, usb_strerror());
     return -1;
   }
@@ -394,22 +431,20 @@ static int usbasp_transmit(const PROGRAMMER *pgm,
  * shared VID/PID
  */
 #ifdef USE_LIBUSB_1_0
-static int usbOpenDevice(libusb_device_handle **device, int vendor,
+static int usbOpenDevice(const PROGRAMMER *pgm, libusb_device_handle **device, int vendor,
 			 const char *vendorName, int product, const char *productName)
 {
     libusb_device_handle *handle = NULL;
     int                  errorCode = USB_ERROR_NOTFOUND;
-    static int           didUsbInit = 0;
     int j;
     int r;
 
-    if(!didUsbInit){
-        didUsbInit = 1;
-        libusb_init(&ctx);
-    }
+    // Each programmer has its own context, so several can be open at once
+    if(!PDATA(pgm)->ctx)
+        libusb_init(&PDATA(pgm)->ctx);
     
     libusb_device **dev_list;
-    int dev_list_len = libusb_get_device_list(ctx, &dev_list);
+    int dev_list_len = libusb_get_device_list(PDATA(pgm)->ctx, &dev_list);
 
     for (j=0; j<dev_list_len; ++j) {
         libusb_device *dev = dev_list[j];
@@ -469,7 +504,7 @@ static int usbOpenDevice(libusb_device_handle **device, int vendor,
     return errorCode;
 }
 #else
-static int usbOpenDevice(usb_dev_handle **device, int vendor,
+static int usbOpenDevice(const PROGRAMMER *pgm, usb_dev_handle **device, int vendor,
 			 const char *vendorName, int product, const char *productName)
 {
 struct usb_bus       *bus;
@@ -565,7 +600,7 @@ static int usbasp_open(PROGRAMMER *pgm, const char *port) {
     pid = USBASP_SHARED_PID;
   }
   vid = pgm->usbvid? pgm->usbvid: USBASP_SHARED_VID;
-  if (usbOpenDevice(&PDATA(pgm)->usbhandle, vid, pgm->usbvendor, pid, pgm->usbproduct) != 0) {
+  if (usbOpenDevice(pgm, &PDATA(pgm)->usbhandle, vid, pgm->usbvendor, pid, pgm->usbproduct) != 0) {
     /* try alternatives */
     if(strcasecmp(ldata(lfirst(pgm->id)), "usbasp") == 0) {
     /* for id usbasp autodetect some variants */
@@ -573,7 +608,7 @@ static int usbasp_open(PROGRAMMER *pgm, const char *port) {
         avrdude_message(MSG_INFO, "%s: warning: Using \"-C usbasp -P nibobee\" is deprecated,"
 	        "use \"-C nibobee\" instead.\n",
 	        progname);
-        if (usbOpenDevice(&PDATA(pgm)->usbhandle, USBASP_NIBOBEE_VID, "www.nicai-systems.com",
+        if (usbOpenDevice(pgm, &PDATA(pgm)->usbhandle, USBASP_NIBOBEE_VID, "www.nicai-systems.com",
 		        USBASP_NIBOBEE_PID, "NIBObee") != 0) {
           avrdude_message(MSG_INFO, "%s: error: could not find USB device "
                           "\"NIBObee\" with vid=0x%x pid=0x%x\n",
@@ -583,7 +618,7 @@ static int usbasp_open(PROGRAMMER *pgm, const char *port) {
         return 0;
       }
       /* check if device with old VID/PID is available */
-      if (usbOpenDevice(&PDATA(pgm)->usbhandle, USBASP_OLD_VID, "www.fischl.de",
+      if (usbOpenDevice(pgm, &PDATA(pgm)->usbhandle, USBASP_OLD_VID, "www.fischl.de",
 		             USBASP_OLD_PID, "USBasp") == 0) {
         /* found USBasp with old IDs */
         avrdude_message(MSG_INFO, "%s: Warning: Found USB device \"USBasp\" with "
@@ -624,6 +659,9 @@ static void usbasp_close(PROGRAMMER * pgm)
         usbasp_transmit(pgm, 1, USBASP_FUNC_DISCONNECT, temp, temp, sizeof(temp));
     }
 
+    avrdude_message(MSG_NOTICE2, "%s: usbasp_close(): %lu USB control transfers, %lu address transfers saved\n",
+                    progname, PDATA(pgm)->ntransfers, PDATA(pgm)->naddrskip);
+
 #ifdef USE_LIBUSB_1_0
     libusb_close(PDATA(pgm)->usbhandle);
 #else
@@ -631,7 +669,10 @@ static void usbasp_close(PROGRAMMER * pgm)
 #endif
   }
 #ifdef USE_LIBUSB_1_0
-  libusb_exit(ctx);
+  if (PDATA(pgm)->ctx) {
+    libusb_exit(PDATA(pgm)->ctx);
+    PDATA(pgm)->ctx = NULL;
+  }
 #else
   /* nothing for usb 0.1 ? */
 #endif
@@ -780,6 +821,30 @@ static int usbasp_spi_chip_erase(const PROGRAMMER *pgm, const AVRPART *p) {
   return 0;
 }
 
+/*
+ * Point the firmware's block address counter at addr; the firmware
+ * advances it by the number of bytes of each block read or write, so
+ * the transfer is only needed when the access is not sequential
+ */
+static void usbasp_set_address(const PROGRAMMER *pgm, unsigned int addr) {
+  unsigned char cmd[4];
+  unsigned char temp[4];
+  IMPORT_PDATA(pgm);
+
+  if (pdata->addr_valid && pdata->addr_next == addr) {
+    pdata->naddrskip++;
+    return;
+  }
+
+  memset(temp, 0, sizeof(temp));
+  cmd[0] = addr & 0xFF;
+  cmd[1] = addr >> 8;
+  cmd[2] = addr >> 16;
+  cmd[3] = addr >> 24;
+  pdata->addr_valid = usbasp_transmit(pgm, 1, USBASP_FUNC_SETLONGADDRESS, cmd, temp, sizeof(temp)) >= 0;
+  pdata->addr_next = addr;
+}
+
 static int usbasp_spi_paged_load(const PROGRAMMER *pgm, const AVRPART *p, const AVRMEM *m,
   unsigned int page_size, unsigned int address, unsigned int n_bytes) {
 
@@ -804,6 +869,8 @@ static int usbasp_spi_paged_load(const PROGRAMMER *pgm, const AVRPART *p, const
   /* set blocksize depending on sck frequency */  
   if ((PDATA(pgm)->sckfreq_hz > 0) && (PDATA(pgm)->sckfreq_hz < 10000)) {
      blocksize = USBASP_READBLOCKSIZE / 10;
+  } else if (PDATA(pgm)->blocksize) {
+     blocksize = PDATA(pgm)->blocksize;
   } else {
      blocksize = USBASP_READBLOCKSIZE;
   }
@@ -814,14 +881,9 @@ static int usbasp_spi_paged_load(const PROGRAMMER *pgm, const AVRPART *p, const
     }
     wbytes -= blocksize;
 
-    /* set address (new mode) - if firmware on usbasp support newmode, then they use address from this command */
-    unsigned char temp[4];
-    memset(temp, 0, sizeof(temp));
-    cmd[0] = address & 0xFF;
-    cmd[1] = address >> 8;
-    cmd[2] = address >> 16;
-    cmd[3] = address >> 24;
-    usbasp_transmit(pgm, 1, USBASP_FUNC_SETLONGADDRESS, cmd, temp, sizeof(temp));
+    /* set address (new mode) - if firmware on usbasp support newmode, then they use address from this command;
+      skipped when the previous block left the firmware's address counter here */
+    usbasp_set_address(pgm, address);
 
     /* send command with address (compatibility mode) - if firmware on
 	  usbasp doesn't support newmode, then they use address from this */
@@ -834,6 +896,7 @@ static int usbasp_spi_paged_load(const PROGRAMMER *pgm, const AVRPART *p, const
     n = usbasp_transmit(pgm, 1, function, cmd, buffer, blocksize);
 
     if (n != blocksize) {
+      PDATA(pgm)->addr_valid = 0;
       avrdude_message(MSG_INFO, "%s: error: wrong reading bytes %x\n",
 	      progname, n);
       return -3;
@@ -841,6 +904,7 @@ static int usbasp_spi_paged_load(const PROGRAMMER *pgm, const AVRPART *p, const
 
     buffer += blocksize;
     address += blocksize;
+    PDATA(pgm)->addr_next = address;
   }
 
   return n_bytes;
@@ -871,6 +935,8 @@ static int usbasp_spi_paged_write(const PROGRAMMER *pgm, const AVRPART *p, const
   /* set blocksize depending on sck frequency */  
   if ((PDATA(pgm)->sckfreq_hz > 0) && (PDATA(pgm)->sckfreq_hz < 10000)) {
      blocksize = USBASP_WRITEBLOCKSIZE / 10;
+  } else if (PDATA(pgm)->blocksize) {
+     blocksize = PDATA(pgm)->blocksize;
   } else {
      blocksize = USBASP_WRITEBLOCKSIZE;
   }
@@ -884,14 +950,8 @@ static int usbasp_spi_paged_write(const PROGRAMMER *pgm, const AVRPART *p, const
 
 
     /* set address (new mode) - if firmware on usbasp support newmode, then
-      they use address from this command */
-    unsigned char temp[4];
-    memset(temp, 0, sizeof(temp));
-    cmd[0] = address & 0xFF;
-    cmd[1] = address >> 8;
-    cmd[2] = address >> 16;
-    cmd[3] = address >> 24;
-    usbasp_transmit(pgm, 1, USBASP_FUNC_SETLONGADDRESS, cmd, temp, sizeof(temp));
+      they use address from this command; skipped when sequential */
+    usbasp_set_address(pgm, address);
 
     /* normal command - firmware what support newmode - use address from previous command,
       firmware what doesn't support newmode - ignore previous command and use address from this command */
@@ -905,6 +965,7 @@ static int usbasp_spi_paged_write(const PROGRAMMER *pgm, const AVRPART *p, const
     n = usbasp_transmit(pgm, 0, function, cmd, buffer, blocksize);
 
     if (n != blocksize) {
+      PDATA(pgm)->addr_valid = 0;
       avrdude_message(MSG_INFO, "%s: error: wrong count at writing %x\n",
 	      progname, n);
       return -3;        
@@ -913,6 +974,7 @@ static int usbasp_spi_paged_write(const PROGRAMMER *pgm, const AVRPART *p, const
 
     buffer += blocksize;
     address += blocksize;
+    PDATA(pgm)->addr_next = address;
   }
 
   return n_bytes;
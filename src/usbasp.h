@@ -51,6 +51,7 @@
 /* Block mode data size */
 #define USBASP_READBLOCKSIZE   200
 #define USBASP_WRITEBLOCKSIZE  200
+#define USBASP_MAXBLOCKSIZE    254 /* longest transfer without V-USB long transfers */
 
 /* ISP SCK speed identifiers */
 #define USBASP_ISP_SCK_AUTO   0
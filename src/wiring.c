@@ -150,7 +150,7 @@ static int wiring_open(PROGRAMMER *pgm, const char *port) {
   strcpy(pgm->port, port);
   pinfo.serialinfo.baud = pgm->baudrate ? pgm->baudrate: 115200;
   pinfo.serialinfo.cflags = SERIAL_8N1;
-  serial_open(port, pinfo, &pgm->fd);
+  serial_open(pgm, port, pinfo, &pgm->fd);
 
   /* If we have a snoozetime, then we wait and do NOT toggle DTR/RTS */
 
@@ -172,7 +172,7 @@ static int wiring_open(PROGRAMMER *pgm, const char *port) {
     avrdude_message(MSG_NOTICE2, "%s: wiring_open(): releasing DTR/RTS\n",
                     progname);
 
-    serial_set_dtr_rts(&pgm->fd, 0);
+    serial_set_dtr_rts(pgm, &pgm->fd, 0);
     usleep(50*1000);
 
     /* After releasing for 50 milliseconds, DTR and RTS */
@@ -181,7 +181,7 @@ static int wiring_open(PROGRAMMER *pgm, const char *port) {
     avrdude_message(MSG_NOTICE2, "%s: wiring_open(): asserting DTR/RTS\n",
                     progname);
 
-    serial_set_dtr_rts(&pgm->fd, 1);
+    serial_set_dtr_rts(pgm, &pgm->fd, 1);
     usleep(50*1000);
   }
 
@@ -196,8 +196,8 @@ static int wiring_open(PROGRAMMER *pgm, const char *port) {
 
 static void wiring_close(PROGRAMMER * pgm)
 {
-  serial_set_dtr_rts(&pgm->fd, 0);
-  serial_close(&pgm->fd);
+  serial_set_dtr_rts(pgm, &pgm->fd, 0);
+  serial_close(pgm, &pgm->fd);
   pgm->fd.ifd = -1;
 }
 
@@ -118,9 +118,9 @@ static int xbee_read_sig_bytes(const PROGRAMMER *pgm, const AVRPART *p, const AV
   buf[0] = Cmnd_STK_READ_SIGN;
   buf[1] = Sync_CRC_EOP;
 
-  serial_send(&pgm->fd, buf, 2);
+  serial_send(pgm, &pgm->fd, buf, 2);
 
-  if (serial_recv(&pgm->fd, buf, 5) < 0)
+  if (serial_recv(pgm, &pgm->fd, buf, 5) < 0)
     return -1;
   if (buf[0] == Resp_STK_NOSYNC) {
     avrdude_message(MSG_INFO, "%s: stk500_cmd(): programmer is out of sync\n",
@@ -1576,7 +1576,7 @@ static int xbee_getsync(const PROGRAMMER *pgm) {
   buf[0] = Cmnd_STK_GET_SYNC;
   buf[1] = Sync_CRC_EOP;
 
-  int sendRc = serial_send(&pgm->fd, buf, 2);
+  int sendRc = serial_send(pgm, &pgm->fd, buf, 2);
   if (sendRc < 0) {
     avrdude_message(MSG_INFO,
                     "%s: xbee_getsync(): failed to deliver STK_GET_SYNC "
@@ -1589,7 +1589,7 @@ static int xbee_getsync(const PROGRAMMER *pgm) {
    * The same is true of the receive - it will retry on timeouts until
    * the response buffer is full.
    */
-  int recvRc = serial_recv(&pgm->fd, resp, 2);
+  int recvRc = serial_recv(pgm, &pgm->fd, resp, 2);
   if (recvRc < 0) {
     avrdude_message(MSG_INFO,
                     "%s: xbee_getsync(): no response to STK_GET_SYNC "
@@ -1623,20 +1623,20 @@ static int xbee_open(PROGRAMMER *pgm, const char *port) {
   /* Wireless is lossier than normal serial */
   serial_recv_timeout = 1000;
 
-  serdev = &xbee_serdev_frame;
+  pgm->serdev = &xbee_serdev_frame;
 
-  if (serial_open(port, pinfo, &pgm->fd) == -1) {
+  if (serial_open(pgm, port, pinfo, &pgm->fd) == -1) {
     return -1;
   }
 
   xbeedev_setresetpin(&pgm->fd, PDATA(pgm)->xbeeResetPin);
 
   /* Clear DTR and RTS */
-  serial_set_dtr_rts(&pgm->fd, 0);
+  serial_set_dtr_rts(pgm, &pgm->fd, 0);
   usleep(250*1000);
 
   /* Set DTR and RTS back to high */
-  serial_set_dtr_rts(&pgm->fd, 1);
+  serial_set_dtr_rts(pgm, &pgm->fd, 1);
   usleep(50*1000);
 
   /*
@@ -1660,7 +1660,7 @@ static void xbee_close(PROGRAMMER *pgm)
    * NB: This request is for the target device, not the locally
    * connected serial device.
    */
-  serial_set_dtr_rts(&pgm->fd, 0);
+  serial_set_dtr_rts(pgm, &pgm->fd, 0);
 
   /*
    * We have tweaked a few settings on the XBee, including the RTS